@@ -0,0 +1,247 @@
+/**
+ * Compares the old busy-polling main loop against the event-driven one, and against decoding in
+ * the completions of asynchronous serial reads.
+ *
+ * A pseudo-terminal stands in for the uINS: a writer thread emits DID_DUAL_IMU packets at a fixed
+ * rate with the write time (CLOCK_MONOTONIC) stored in dual_imu_t::time.  The SDK decodes them on
+ * the main thread (or the async read completion thread), and for each loop style we report the CPU
+ * used by the decode thread and the packet-write to callback latency.  The async case ends by
+ * closing the port from inside a completion, and fails if that doesn't cancel the other read.
+ *
+ * usage: bench_event_loop [seconds_per_case]
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "InertialSense.h"
+#include "serialPortExt.h"
+
+static double monotonic_now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double thread_cpu_now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int open_pty(std::string& slave_name)
+{
+  int master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0)
+    return -1;
+  struct termios tty;
+  tcgetattr(master, &tty);
+  cfmakeraw(&tty);
+  tcsetattr(master, TCSANOW, &tty);
+  slave_name = ptsname(master);
+  return master;
+}
+
+static void imu_writer(int master, int rate_hz, std::atomic<bool>* running)
+{
+  is_comm_instance_t comm;
+  uint8_t comm_buffer[2048];
+  is_comm_init(&comm, comm_buffer, sizeof(comm_buffer));
+
+  dual_imu_t imu;
+  memset(&imu, 0, sizeof(imu));
+  imu.I[0].acc[2] = -9.81f;
+  imu.I[1].acc[2] = -9.81f;
+
+  const double period = 1.0 / rate_hz;
+  double next = monotonic_now();
+  uint8_t discard[256];
+  while (*running)
+  {
+    // swallow the stream requests the SDK writes to the device
+    while (read(master, discard, sizeof(discard)) > 0) {}
+
+    imu.time = monotonic_now();
+    int n = is_comm_data(&comm, DID_DUAL_IMU, 0, sizeof(dual_imu_t), &imu);
+    if (n > 0 && write(master, comm.buf.start, n) != n)
+      fprintf(stderr, "short write to pty\n");
+
+    next += period;
+    double sleep_s = next - monotonic_now();
+    if (sleep_s > 0)
+      usleep((useconds_t)(sleep_s * 1e6));
+  }
+}
+
+static std::vector<double>* s_latency;
+static void imu_handler(InertialSense* i, p_data_t* data, int pHandle)
+{
+  (void)i; (void)pHandle;
+  const dual_imu_t* imu = reinterpret_cast<const dual_imu_t*>(data->buf);
+  s_latency->push_back(monotonic_now() - imu->time);
+}
+
+// async case: the completions decode, and re-queue their buffer until asked to close the port
+static is_comm_instance_t s_async_comm;
+static uint8_t s_async_comm_buffer[2048];
+static std::atomic<bool> s_async_close;
+static std::atomic<int> s_async_closed, s_async_cancelled, s_async_errors;
+static std::atomic<double> s_async_cpu_start, s_async_cpu;
+
+static void async_read_done(serial_port_t* port, unsigned char* buf, int len, int errorCode)
+{
+  if (errorCode == ECANCELED)
+  {
+    s_async_cancelled++;
+    return;
+  }
+  if (errorCode != 0)
+  {
+    s_async_errors++;
+    return;
+  }
+  double cpu = thread_cpu_now();
+  if (s_async_cpu_start == 0.0)
+    s_async_cpu_start = cpu;
+  s_async_cpu = cpu;
+  for (int i = 0; i < len; i++)
+  {
+    if (is_comm_parse_byte(&s_async_comm, buf[i]) == _PTYPE_INERTIAL_SENSE_DATA &&
+        s_async_comm.dataHdr.id == DID_DUAL_IMU && s_async_comm.dataHdr.offset == 0 &&
+        s_async_comm.dataHdr.size == sizeof(dual_imu_t))
+    {
+      const dual_imu_t* imu = reinterpret_cast<const dual_imu_t*>(s_async_comm.dataPtr);
+      s_latency->push_back(monotonic_now() - imu->time);
+    }
+  }
+  if (s_async_close)
+  {
+    // from the completion thread itself, which the close must not try to join
+    serialPortClose(port);
+    s_async_closed++;
+    return;
+  }
+  if (!serialPortReadTimeoutAsync(port, buf, 512, async_read_done))
+    s_async_errors++;
+}
+
+static void run_case(const char* mode, int rate_hz, double seconds)
+{
+  std::string slave;
+  int master = open_pty(slave);
+  if (master < 0)
+  {
+    fprintf(stderr, "unable to create pty\n");
+    exit(1);
+  }
+  fcntl(master, F_SETFL, O_NONBLOCK);
+
+  std::vector<double> latency;
+  latency.reserve((size_t)(rate_hz * seconds * 1.2));
+  s_latency = &latency;
+
+  InertialSense is;
+  if (!is.Open(slave.c_str(), 921600) || !serialPortPlatformAdopt(is.GetSerialPort(), 921600))
+  {
+    fprintf(stderr, "unable to open %s\n", slave.c_str());
+    exit(1);
+  }
+  bool async = (strcmp(mode, "async") == 0);
+  if (!async)
+    is.BroadcastBinaryData(DID_DUAL_IMU, 1, imu_handler);
+
+  std::atomic<bool> running(true);
+  std::thread writer(imu_writer, master, rate_hz, &running);
+
+  bool event_driven = (strcmp(mode, "event") == 0);
+  struct pollfd pfd;
+  pfd.events = POLLIN;
+
+  double cpu, wall;
+  if (async)
+  {
+    // two reads outstanding, so one is still queued when the other closes the port
+    static unsigned char buffers[2][512];
+    is_comm_init(&s_async_comm, s_async_comm_buffer, sizeof(s_async_comm_buffer));
+    s_async_close = false;
+    s_async_closed = s_async_cancelled = s_async_errors = 0;
+    s_async_cpu_start = s_async_cpu = 0.0;
+    double wall_start = monotonic_now();
+    for (int b = 0; b < 2; b++)
+    {
+      if (!serialPortReadTimeoutAsync(is.GetSerialPort(), buffers[b], sizeof(buffers[b]), async_read_done))
+      {
+        fprintf(stderr, "unable to start async reads on %s\n", slave.c_str());
+        exit(1);
+      }
+    }
+    usleep((useconds_t)(seconds * 1e6));
+    s_async_close = true;
+    while ((s_async_closed == 0 || s_async_cancelled == 0) && monotonic_now() - wall_start < seconds + 2.0)
+      usleep(1000);
+    wall = monotonic_now() - wall_start;
+    cpu = s_async_cpu - s_async_cpu_start;
+    if (s_async_closed != 1 || s_async_cancelled != 1 || s_async_errors != 0)
+    {
+      fprintf(stderr, "async: closing from a completion: %d close(s), %d read(s) cancelled, %d error(s)\n",
+              (int)s_async_closed, (int)s_async_cancelled, (int)s_async_errors);
+      exit(1);
+    }
+  }
+  else
+  {
+    double cpu_start = thread_cpu_now();
+    double wall_start = monotonic_now();
+    while (monotonic_now() - wall_start < seconds)
+    {
+      if (event_driven)
+      {
+        pfd.fd = serialPortGetFileDescriptor(is.GetSerialPort());
+        pfd.revents = 0;
+        poll(&pfd, 1, 100);
+      }
+      is.Update();
+    }
+    cpu = thread_cpu_now() - cpu_start;
+    wall = monotonic_now() - wall_start;
+  }
+
+  running = false;
+  writer.join();
+  is.Close();
+  close(master);
+
+  std::sort(latency.begin(), latency.end());
+  size_t n = latency.size();
+  double p50 = n ? latency[n / 2] * 1e6 : 0;
+  double p99 = n ? latency[std::min(n - 1, (size_t)(n * 0.99))] * 1e6 : 0;
+  double max = n ? latency[n - 1] * 1e6 : 0;
+  printf("%-6s %5d Hz  msgs %7zu  cpu %6.2f%%  latency p50 %7.1f us  p99 %7.1f us  max %8.1f us\n",
+         mode, rate_hz, n, 100.0 * cpu / wall, p50, p99, max);
+}
+
+int main(int argc, char** argv)
+{
+  double seconds = (argc > 1) ? atof(argv[1]) : 5.0;
+  const int rates[] = { 100, 1000 };
+  for (int rate : rates)
+  {
+    run_case("busy", rate, seconds);
+    run_case("event", rate, seconds);
+    run_case("async", rate, seconds);
+  }
+  return 0;
+}
@@ -0,0 +1,370 @@
+/**
+ * Time to pull a window out of a raw log through its index, against reading the log from the
+ * start up to the window (all a log without an index allows).
+ *
+ * Raw logs of increasing length are generated as LogWriter lays them out (64 MB segments of
+ * framed packets, split wherever the size falls) with what a logging uINS sends: DID_DUAL_IMU at
+ * 500 Hz, DID_INS_2 at 100 Hz, DID_BAROMETER and DID_MAGNETOMETER_1 at 20 Hz, DID_GPS1_POS and
+ * DID_GPS1_VEL at 5 Hz.  For each log the index is built after the fact (time, size), then a
+ * `window` second window in the middle of the log is extracted
+ *   scan  - parsing from the start of the log until past the window
+ *   index - IndexedLog::seek(), every DID
+ *   gps   - IndexedLog::seek(), DID_GPS1_POS only (the scan reads the same bytes for it)
+ * with the log dropped from the page cache before every run, so the time includes reading it from
+ * disk; the memory-mapped reader only faults in the pages it parses.  Doesn't need a roscore.
+ * Every log is also read whole (it must return every data set written, the packets split across
+ * two segments included) and through a 0.1 s window around the first segment boundary.
+ *
+ * usage: bench_log_index [--minutes 15,60,240] [--window 30] [--dir /tmp] [--keep]
+ * exits with status 1 if an indexed window doesn't return the same data sets as the scan, or the
+ * whole log is short of data sets
+ */
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "ISComm.h"
+#include "log_index.h"
+
+static const uint64_t SEGMENT_SIZE = 64ull << 20;
+static const double TOW0 = 345600.0;     // log starts at noon on a Wednesday, GPS time
+static const double BOOT0 = 50.0;        // uINS up for 50 s by then
+
+static uint64_t monotonic_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+typedef struct
+{
+  uint64_t count;
+  double tow_sum;   // to compare what two reads returned
+} window_t;
+
+class SegmentOutput
+{
+public:
+  SegmentOutput(const std::string& directory) : directory_(directory), file_(NULL), index_(0), fill_(0) {}
+  ~SegmentOutput() { if (file_) fclose(file_); }
+
+  void write(const uint8_t* data, size_t len)
+  {
+    while (len > 0)
+    {
+      if (file_ == NULL || fill_ == SEGMENT_SIZE)
+        next();
+      size_t n = (size_t)std::min<uint64_t>(len, SEGMENT_SIZE - fill_);
+      fwrite(data, 1, n, file_);
+      fill_ += n;
+      data += n;
+      len -= n;
+    }
+  }
+
+  std::vector<std::string> paths;
+
+private:
+  void next()
+  {
+    if (file_)
+      fclose(file_);
+    char name[32];
+    snprintf(name, sizeof(name), "/LOG_SN1_%04u.raw", index_++);
+    paths.push_back(directory_ + name);
+    file_ = fopen(paths.back().c_str(), "wb");
+    fill_ = 0;
+  }
+
+  std::string directory_;
+  FILE* file_;
+  unsigned index_;
+  uint64_t fill_;
+};
+
+typedef struct
+{
+  std::vector<std::string> paths;
+  uint64_t count;                 // data sets written
+  std::vector<double> boundaries; // time of the data set each segment after the first starts in
+} log_t;
+
+static log_t generate(const std::string& directory, double minutes)
+{
+  log_t log;
+  log.count = 0;
+  SegmentOutput out(directory);
+  is_comm_instance_t comm;
+  static uint8_t buffer[4096];
+  is_comm_init(&comm, buffer, sizeof(buffer));
+
+  dual_imu_t imu;
+  ins_2_t ins;
+  barometer_t baro;
+  magnetometer_t mag;
+  gps_pos_t pos;
+  gps_vel_t vel;
+  memset(&imu, 0, sizeof(imu));
+  memset(&ins, 0, sizeof(ins));
+  memset(&baro, 0, sizeof(baro));
+  memset(&mag, 0, sizeof(mag));
+  memset(&pos, 0, sizeof(pos));
+  memset(&vel, 0, sizeof(vel));
+  pos.towOffset = TOW0 - BOOT0;
+
+  uint64_t ms_total = (uint64_t)(minutes * 60000.0);
+  for (uint64_t ms = 0; ms < ms_total; ms++)
+  {
+    double boot = BOOT0 + ms * 1e-3, tow = TOW0 + ms * 1e-3;
+    size_t segments = out.paths.size();
+    int n;
+    if (ms % 2 == 0)
+    {
+      imu.time = boot;
+      imu.I[0].acc[2] = -9.8f + (ms % 7) * 1e-3f;
+      n = is_comm_data(&comm, DID_DUAL_IMU, 0, sizeof(imu), &imu);
+      out.write(comm.buf.start, n);
+      log.count++;
+    }
+    if (ms % 10 == 0)
+    {
+      ins.timeOfWeek = tow;
+      ins.uvw[0] = (float)(ms % 1000) * 1e-3f;
+      n = is_comm_data(&comm, DID_INS_2, 0, sizeof(ins), &ins);
+      out.write(comm.buf.start, n);
+      log.count++;
+    }
+    if (ms % 50 == 0)
+    {
+      baro.time = mag.time = boot;
+      n = is_comm_data(&comm, DID_BAROMETER, 0, sizeof(baro), &baro);
+      out.write(comm.buf.start, n);
+      log.count++;
+      n = is_comm_data(&comm, DID_MAGNETOMETER_1, 0, sizeof(mag), &mag);
+      out.write(comm.buf.start, n);
+      log.count++;
+    }
+    if (ms % 200 == 0)
+    {
+      // GPS data sets are sent ~100 ms after their time of validity
+      pos.timeOfWeekMs = vel.timeOfWeekMs = (uint32_t)((tow - 0.1) * 1e3 + 0.5);
+      n = is_comm_data(&comm, DID_GPS1_POS, 0, sizeof(pos), &pos);
+      out.write(comm.buf.start, n);
+      log.count++;
+      n = is_comm_data(&comm, DID_GPS1_VEL, 0, sizeof(vel), &vel);
+      out.write(comm.buf.start, n);
+      log.count++;
+    }
+    if (segments > 0 && out.paths.size() != segments)
+      log.boundaries.push_back(tow);
+  }
+  log.paths = out.paths;
+  return log;
+}
+
+static void drop_cache(const std::vector<std::string>& paths)
+{
+  for (size_t i = 0; i < paths.size(); i++)
+  {
+    int fd = open(paths[i].c_str(), O_RDONLY);
+    if (fd < 0)
+      continue;
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+  }
+}
+
+// read front to back, stopping a second (of log time) past the window
+static window_t scan(const std::vector<std::string>& paths, double start, double end, uint32_t did,
+                     uint64_t& scanned)
+{
+  IndexedLog log;
+  for (size_t i = 0; i < paths.size(); i++)
+    log.add_segment(paths[i]);
+  window_t w = { 0, 0.0 };
+  double tow;
+  for (const p_data_t* data = log.next(tow); data != NULL; data = log.next(tow))
+  {
+    if (tow > end + 1.0)
+      break;
+    if (tow >= start && tow <= end && (did == 0 || data->hdr.id == did))
+    {
+      w.count++;
+      w.tow_sum += tow - TOW0;
+    }
+  }
+  scanned = log.bytes_scanned();
+  return w;
+}
+
+static window_t indexed(const std::vector<std::string>& paths, double start, double end, uint32_t did,
+                        uint64_t& scanned)
+{
+  IndexedLog log;
+  for (size_t i = 0; i < paths.size(); i++)
+    log.add_segment(paths[i]);
+  std::vector<uint32_t> dids;
+  if (did != 0)
+    dids.push_back(did);
+  log.seek(start, end, dids);
+  window_t w = { 0, 0.0 };
+  double tow;
+  for (const p_data_t* data = log.next(tow); data != NULL; data = log.next(tow))
+  {
+    w.count++;
+    w.tow_sum += tow - TOW0;
+  }
+  scanned = log.bytes_scanned();
+  return w;
+}
+
+static uint64_t read_all(const std::vector<std::string>& paths)
+{
+  IndexedLog log;
+  for (size_t i = 0; i < paths.size(); i++)
+    log.add_segment(paths[i]);
+  uint64_t count = 0;
+  double tow;
+  for (const p_data_t* data = log.next(tow); data != NULL; data = log.next(tow))
+    count++;
+  return count;
+}
+
+static uint64_t file_size(const std::string& path)
+{
+  struct stat st;
+  return stat(path.c_str(), &st) == 0 ? (uint64_t)st.st_size : 0;
+}
+
+int main(int argc, char** argv)
+{
+  std::vector<double> minutes;
+  double window = 30.0;
+  std::string directory = "/tmp";
+  bool keep = false;
+  for (int i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "--minutes") && i + 1 < argc)
+    {
+      for (char* p = strtok(argv[++i], ","); p != NULL; p = strtok(NULL, ","))
+        minutes.push_back(atof(p));
+    }
+    else if (!strcmp(argv[i], "--window") && i + 1 < argc)
+      window = atof(argv[++i]);
+    else if (!strcmp(argv[i], "--dir") && i + 1 < argc)
+      directory = argv[++i];
+    else if (!strcmp(argv[i], "--keep"))
+      keep = true;
+  }
+  if (minutes.empty())
+    minutes = { 15.0, 60.0, 240.0 };
+
+  printf("%8s %8s %9s %9s %10s | %10s %9s | %10s %9s | %10s %9s | %8s\n", "log min", "log MB", "index KB",
+         "build ms", "build MB/s", "scan ms", "read MB", "index ms", "read MB", "gps ms", "read MB", "speedup");
+  bool failed = false;
+  for (size_t m = 0; m < minutes.size(); m++)
+  {
+    char name[64];
+    snprintf(name, sizeof(name), "/bench_log_index_%d_%.0f", (int)getpid(), minutes[m]);
+    std::string dir = directory + name;
+    mkdir(dir.c_str(), 0755);
+    log_t generated = generate(dir, minutes[m]);
+    const std::vector<std::string>& paths = generated.paths;
+
+    // the index after the fact, as for a log written without one
+    drop_cache(paths);
+    uint64_t t0 = monotonic_ns();
+    uint64_t log_size = 0, index_size = 0;
+    {
+      IndexedLog log;
+      for (size_t i = 0; i < paths.size(); i++)
+        log.add_segment(paths[i]);
+      log_size = log.size();
+    }
+    double build_ms = (monotonic_ns() - t0) * 1e-6;
+    for (size_t i = 0; i < paths.size(); i++)
+      index_size += file_size(log_index_path(paths[i]));
+
+    double start = TOW0 + minutes[m] * 30.0 - window / 2, end = start + window;
+    double ms[3], read_mb[3];
+    window_t expected[2], got[2];
+    uint64_t scanned;
+
+    drop_cache(paths);
+    t0 = monotonic_ns();
+    expected[0] = scan(paths, start, end, 0, scanned);
+    ms[0] = (monotonic_ns() - t0) * 1e-6;
+    read_mb[0] = scanned / 1e6;
+    expected[1] = scan(paths, start, end, DID_GPS1_POS, scanned);
+
+    drop_cache(paths);
+    t0 = monotonic_ns();
+    got[0] = indexed(paths, start, end, 0, scanned);
+    ms[1] = (monotonic_ns() - t0) * 1e-6;
+    read_mb[1] = scanned / 1e6;
+
+    drop_cache(paths);
+    t0 = monotonic_ns();
+    got[1] = indexed(paths, start, end, DID_GPS1_POS, scanned);
+    ms[2] = (monotonic_ns() - t0) * 1e-6;
+    read_mb[2] = scanned / 1e6;
+
+    printf("%8.0f %8.1f %9.1f %9.1f %10.1f | %10.1f %9.2f | %10.2f %9.2f | %10.2f %9.3f | %7.0fx\n", minutes[m],
+           log_size / 1e6, index_size / 1e3, build_ms, build_ms > 0.0 ? log_size / 1e3 / build_ms : 0.0, ms[0],
+           read_mb[0], ms[1], read_mb[1], ms[2], read_mb[2], ms[1] > 0.0 ? ms[0] / ms[1] : 0.0);
+    for (int k = 0; k < 2; k++)
+    {
+      if (got[k].count != expected[k].count || got[k].tow_sum != expected[k].tow_sum || expected[k].count == 0)
+      {
+        printf("  MISMATCH (%s): index returned %lu data sets, scan %lu\n", k == 0 ? "every DID" : "gps",
+               (unsigned long)got[k].count, (unsigned long)expected[k].count);
+        failed = true;
+      }
+    }
+
+    // packets split across two segments
+    uint64_t count = read_all(paths);
+    if (count != generated.count)
+    {
+      printf("  MISMATCH (whole log): read %lu data sets of %lu\n", (unsigned long)count,
+             (unsigned long)generated.count);
+      failed = true;
+    }
+    if (!generated.boundaries.empty())
+    {
+      double b = generated.boundaries[0];
+      window_t e = scan(paths, b - 0.05, b + 0.05, 0, scanned), g = indexed(paths, b - 0.05, b + 0.05, 0, scanned);
+      if (g.count != e.count || g.tow_sum != e.tow_sum || e.count == 0)
+      {
+        printf("  MISMATCH (segment boundary): index returned %lu data sets, scan %lu\n", (unsigned long)g.count,
+               (unsigned long)e.count);
+        failed = true;
+      }
+    }
+
+    if (!keep)
+    {
+      for (size_t i = 0; i < paths.size(); i++)
+      {
+        unlink(paths[i].c_str());
+        unlink(log_index_path(paths[i]).c_str());
+      }
+      rmdir(dir.c_str());
+    }
+  }
+
+  printf("\n%g s window in the middle of the log; page cache dropped before each build / extraction\n", window);
+  if (failed)
+    printf("FAILED: an indexed window differs from the scan, or the log is short of data sets\n");
+  return failed ? 1 : 0;
+}
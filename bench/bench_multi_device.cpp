@@ -0,0 +1,169 @@
+/**
+ * CPU scaling of the multi-device hub with the number of attached uINS.
+ *
+ * For 1 .. max_devices simulated uINS (see uins_simulator.h), an InertialSenseHub is run in this
+ * process against their pseudo-terminals and, after a warm-up, the benchmark reports the IMU
+ * data sets each device delivered per second (from the driver's DID statistics, so nothing is
+ * subscribed and serialization isn't measured), the hub thread's CPU and the driver's total CPU
+ * (process CPU minus the simulator threads) - and how that total compares with N times the
+ * single device cost.
+ *
+ * Needs a running roscore.  Parameters (private):
+ *   max_devices (4), duration (5 s), warmup (2 s), imu_rate (500), ins_rate (100), gps_rate (5)
+ *   max_scaling (0.8) - exit with status 1 if, for any N > 1, driver CPU exceeds max_scaling * N
+ *       times the single device CPU (one decode pass serves every port, so the hub should do better
+ *       than running N drivers), or a device delivered less than 95% of its IMU rate (off if < 0)
+ *   hub/... - passed to the hub, hub/uins<i>/... to each device
+ */
+#include <pthread.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "inertial_sense_hub.h"
+#include "uins_simulator.h"
+
+static double clock_seconds(clockid_t clock)
+{
+  struct timespec ts;
+  clock_gettime(clock, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+typedef struct
+{
+  double window;
+  double hub_cpu;
+  double driver_cpu;
+  double min_imu_rate;
+  double max_imu_rate;
+} result_t;
+
+static bool run(int device_count, const UinsSimulator::config_t& config, double warmup, double duration, result_t& result)
+{
+  std::vector<std::unique_ptr<UinsSimulator>> sims;
+  std::vector<std::string> ports;
+  ros::NodeHandle hub_private("~hub");
+  for (int i = 0; i < device_count; i++)
+  {
+    sims.emplace_back(new UinsSimulator(config));
+    if (!sims.back()->open())
+      return false;
+    sims.back()->start();
+    ports.push_back(sims.back()->port());
+
+    ros::NodeHandle device_private(hub_private, "uins" + std::to_string(i));
+    device_private.setParam("stream_INS", true);
+    device_private.setParam("stream_IMU", true);
+    device_private.setParam("stream_GPS", true);
+    device_private.setParam("publishTf", false);
+  }
+  hub_private.setParam("ports", ports);
+
+  std::unique_ptr<InertialSenseHub> hub(new InertialSenseHub(ros::NodeHandle(), hub_private));
+  std::thread hub_thread(&InertialSenseHub::spin, hub.get());
+  clockid_t hub_clock;
+  pthread_getcpuclockid(hub_thread.native_handle(), &hub_clock);
+
+  ros::WallDuration(warmup).sleep();
+  std::vector<uint64_t> imu_start(device_count, 0);
+  for (int i = 0; i < device_count; i++)
+  {
+    const DidStats* stats = hub->device(i) ? hub->device(i)->did_stats_[DID_DUAL_IMU].get() : NULL;
+    imu_start[i] = stats ? stats->count : 0;
+  }
+  double sim_cpu_start = 0.0;
+  for (int i = 0; i < device_count; i++)
+    sim_cpu_start += sims[i]->cpu_seconds();
+  double wall_start = clock_seconds(CLOCK_MONOTONIC);
+  double hub_cpu_start = clock_seconds(hub_clock);
+  double process_cpu_start = clock_seconds(CLOCK_PROCESS_CPUTIME_ID);
+
+  ros::WallDuration(duration).sleep();
+  double process_cpu = clock_seconds(CLOCK_PROCESS_CPUTIME_ID) - process_cpu_start;
+  result.hub_cpu = clock_seconds(hub_clock) - hub_cpu_start;
+  result.window = clock_seconds(CLOCK_MONOTONIC) - wall_start;
+  double sim_cpu = -sim_cpu_start;
+  for (int i = 0; i < device_count; i++)
+    sim_cpu += sims[i]->cpu_seconds();
+  result.driver_cpu = process_cpu - sim_cpu;
+
+  result.min_imu_rate = 1e12;
+  result.max_imu_rate = 0.0;
+  for (int i = 0; i < device_count; i++)
+  {
+    const DidStats* stats = hub->device(i) ? hub->device(i)->did_stats_[DID_DUAL_IMU].get() : NULL;
+    double rate = stats ? (stats->count - imu_start[i]) / result.window : 0.0;
+    result.min_imu_rate = std::min(result.min_imu_rate, rate);
+    result.max_imu_rate = std::max(result.max_imu_rate, rate);
+  }
+
+  for (int i = 0; i < device_count; i++)
+    sims[i]->stop();
+  hub->shutdown();
+  hub_thread.join();
+  hub.reset();
+  return true;
+}
+
+int main(int argc, char** argv)
+{
+  ros::init(argc, argv, "bench_multi_device");
+  ros::NodeHandle nh_private("~");
+
+  int max_devices;
+  double duration, warmup, max_scaling;
+  nh_private.param<int>("max_devices", max_devices, 4);
+  nh_private.param<double>("duration", duration, 5.0);
+  nh_private.param<double>("warmup", warmup, 2.0);
+  nh_private.param<double>("max_scaling", max_scaling, 0.8);
+
+  UinsSimulator::config_t config = UinsSimulator::default_config();
+  double rate;
+  nh_private.param<double>("imu_rate", config.rate[UinsSimulator::SIM_DUAL_IMU], config.rate[UinsSimulator::SIM_DUAL_IMU]);
+  nh_private.param<double>("ins_rate", rate, config.rate[UinsSimulator::SIM_INS_2]);
+  config.rate[UinsSimulator::SIM_INS_1] = config.rate[UinsSimulator::SIM_INS_2] = rate;
+  nh_private.param<double>("gps_rate", rate, config.rate[UinsSimulator::SIM_GPS1_POS]);
+  config.rate[UinsSimulator::SIM_GPS1_POS] = config.rate[UinsSimulator::SIM_GPS1_VEL] = rate;
+  config.rate[UinsSimulator::SIM_GPS1_OBS] = config.rate[UinsSimulator::SIM_GPS1_EPH] = 0.0;
+
+  bool failed = false;
+  double single_cpu = 0.0, worst_scaling = 0.0;
+  int worst_n = 0;
+  printf("\n%8s %14s %14s %12s %14s %14s %10s\n",
+         "devices", "imu Hz (min)", "imu Hz (max)", "hub cpu", "driver cpu", "per device", "vs N x 1");
+  for (int n = 1; n <= max_devices; n++)
+  {
+    result_t result;
+    if (!run(n, config, warmup, duration, result))
+    {
+      ROS_FATAL("unable to create pty");
+      return 1;
+    }
+    double driver_cpu = 100.0 * result.driver_cpu / result.window;
+    if (n == 1)
+      single_cpu = driver_cpu;
+    double scaling = single_cpu > 0.0 ? driver_cpu / (n * single_cpu) : 0.0;
+    printf("%8d %14.1f %14.1f %11.2f%% %13.2f%% %13.2f%% %10.2f\n", n, result.min_imu_rate, result.max_imu_rate,
+           100.0 * result.hub_cpu / result.window, driver_cpu, driver_cpu / n, scaling);
+
+    if (n > 1 && scaling > worst_scaling)
+    {
+      worst_scaling = scaling;
+      worst_n = n;
+    }
+    if (max_scaling >= 0.0 && (result.min_imu_rate < 0.95 * config.rate[UinsSimulator::SIM_DUAL_IMU] ||
+                               (n > 1 && scaling > max_scaling)))
+      failed = true;
+  }
+
+  if (worst_n > 0)
+    printf("driver CPU vs N x single device: %.2f at worst (%d devices), limit %.2f\n", worst_scaling, worst_n, max_scaling);
+  if (failed)
+    printf("FAILED: a device fell behind, or CPU grew faster than max_scaling x the device count\n");
+  return failed ? 1 : 0;
+}
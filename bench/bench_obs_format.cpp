@@ -0,0 +1,108 @@
+/**
+ * Size and conversion cost of one GNSS observation epoch in the GNSSObsVec (gps/obs) and
+ * compact GNSSObsEpoch (gps/obs_epoch) formats.
+ *
+ * For each satellite count, a synthetic epoch is converted from obsd_t the way the driver does
+ * it, then serialized as it would be for a remote subscriber.  Reports serialized bytes per
+ * epoch, and conversion and serialization time per epoch.  Doesn't need a roscore.
+ *
+ * usage: bench_obs_format [iterations]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <vector>
+
+#include <ros/serialization.h>
+#include "gnss_obs_conversion.h"
+#include "inertial_sense/GNSSObsVec.h"
+
+static double monotonic_now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+template <typename M>
+static double serialize(const M& msg, std::vector<uint8_t>& buffer)
+{
+  uint32_t len = ros::serialization::serializationLength(msg);
+  if (buffer.size() < len)
+    buffer.resize(len);
+  ros::serialization::OStream stream(buffer.data(), len);
+  ros::serialization::serialize(stream, msg);
+  return len;
+}
+
+static void run(int sats, int iterations)
+{
+  std::vector<obsd_t> obs(sats);
+  memset(obs.data(), 0, sats * sizeof(obsd_t));
+  for (int i = 0; i < sats; i++)
+  {
+    obs[i].time.time = 1500000000;
+    obs[i].time.sec = 0.2;
+    obs[i].sat = (uint8_t)(i + 1);
+    obs[i].rcv = 1;
+    obs[i].SNR[0] = 180;
+    obs[i].P[0] = 2.0e7 + 1000.0 * i;
+    obs[i].L[0] = 1.05e8 + 5000.0 * i;
+    obs[i].D[0] = -100.0f + i;
+  }
+  ros::Time stamp(obs[0].time.time, (uint32_t)(obs[0].time.sec * 1e9));
+  std::vector<uint8_t> buffer;
+
+  // GNSSObsVec, with the storage reuse the driver does
+  inertial_sense::GNSSObsVec vec;
+  vec.obs.reserve(sats);
+  double vec_bytes = 0, vec_convert = 0, vec_serialize = 0;
+  for (int it = 0; it < iterations; it++)
+  {
+    double t0 = monotonic_now();
+    vec.obs.clear();
+    for (int i = 0; i < sats; i++)
+    {
+      vec.obs.emplace_back();
+      gnss_obs_to_msg(obs[i], stamp, vec.obs.back());
+    }
+    vec.header.stamp = stamp;
+    double t1 = monotonic_now();
+    vec_bytes = serialize(vec, buffer);
+    double t2 = monotonic_now();
+    vec_convert += t1 - t0;
+    vec_serialize += t2 - t1;
+  }
+
+  inertial_sense::GNSSObsEpoch epoch;
+  gnss_obs_epoch_reserve(epoch, sats);
+  double epoch_bytes = 0, epoch_convert = 0, epoch_serialize = 0;
+  for (int it = 0; it < iterations; it++)
+  {
+    double t0 = monotonic_now();
+    gnss_obs_epoch_clear(epoch);
+    for (int i = 0; i < sats; i++)
+      gnss_obs_epoch_append(obs[i], epoch);
+    epoch.header.stamp = stamp;
+    double t1 = monotonic_now();
+    epoch_bytes = serialize(epoch, buffer);
+    double t2 = monotonic_now();
+    epoch_convert += t1 - t0;
+    epoch_serialize += t2 - t1;
+  }
+
+  printf("%4d sats  GNSSObsVec %6.0f bytes  convert %7.2f us  serialize %7.2f us  |  GNSSObsEpoch %6.0f bytes  convert %7.2f us  serialize %7.2f us\n",
+         sats, vec_bytes, 1e6 * vec_convert / iterations, 1e6 * vec_serialize / iterations,
+         epoch_bytes, 1e6 * epoch_convert / iterations, 1e6 * epoch_serialize / iterations);
+}
+
+int main(int argc, char** argv)
+{
+  int iterations = (argc > 1) ? atoi(argv[1]) : 20000;
+  const int sats[] = { 12, 24, 40, 64 };
+  for (int n : sats)
+    run(n, iterations);
+  return 0;
+}
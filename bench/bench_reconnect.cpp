@@ -0,0 +1,179 @@
+/**
+ * Recovery time of the driver's reconnect against the uINS simulator.
+ *
+ * The driver runs in this process on a symlink to the simulator's pseudo-terminal, and every cycle
+ * takes the link away in one of two ways before bringing it back:
+ *   unplug - the pty is closed (the driver's port hangs up) and a new one created behind the link
+ *            after down_time, as a USB-serial adapter dropping off the bus and coming back
+ *   stall  - the simulator goes silent for down_time with the port open, as a hung uINS
+ * Recovery is the time from the device being back to the first imu message published after it,
+ * outage the time from the link going away to that message.  Both are reported per scenario with
+ * the driver's reconnect count and time sync resets (0 expected: its state is kept).
+ *
+ * Needs a running roscore.  Parameters (private):
+ *   cycles (5), down_time (1 s), power_cycled (true: the device forgets its streams on unplug)
+ *   max_recovery_ms - exit with status 1 if any recovery takes longer (off if < 0)
+ *   driver/... - passed to the driver (e.g. _driver/stall_timeout:=0.5 _driver/pipeline_mode:=true)
+ */
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "inertial_sense.h"
+#include "uins_simulator.h"
+
+static uint64_t monotonic_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static std::atomic<uint64_t> s_last_imu_ns(0);
+
+// wait for an imu message received after since_ns, returns its receive time or 0 on timeout
+static uint64_t wait_for_imu(uint64_t since_ns, double timeout_s)
+{
+  uint64_t deadline = monotonic_ns() + (uint64_t)(timeout_s * 1e9);
+  while (monotonic_ns() < deadline)
+  {
+    uint64_t last = s_last_imu_ns;
+    if (last > since_ns)
+      return last;
+    usleep(500);
+  }
+  return 0;
+}
+
+typedef struct
+{
+  const char* name;
+  std::vector<double> recovery_ms;
+  std::vector<double> outage_ms;
+  int failures;
+} scenario_t;
+
+static void report(scenario_t& s)
+{
+  if (s.recovery_ms.empty())
+  {
+    printf("%-8s %6d recovered, %d failed\n", s.name, 0, s.failures);
+    return;
+  }
+  std::sort(s.recovery_ms.begin(), s.recovery_ms.end());
+  std::sort(s.outage_ms.begin(), s.outage_ms.end());
+  printf("%-8s %6lu %8d %10.1f %10.1f %10.1f %10.1f %10.1f\n", s.name, (unsigned long)s.recovery_ms.size(), s.failures,
+         s.recovery_ms.front(), s.recovery_ms[s.recovery_ms.size() / 2], s.recovery_ms.back(),
+         s.outage_ms[s.outage_ms.size() / 2], s.outage_ms.back());
+}
+
+int main(int argc, char** argv)
+{
+  ros::init(argc, argv, "bench_reconnect");
+  ros::NodeHandle nh;
+  ros::NodeHandle nh_private("~");
+
+  int cycles;
+  double down_time, max_recovery_ms;
+  bool power_cycled;
+  nh_private.param<int>("cycles", cycles, 5);
+  nh_private.param<double>("down_time", down_time, 1.0);
+  nh_private.param<bool>("power_cycled", power_cycled, true);
+  nh_private.param<double>("max_recovery_ms", max_recovery_ms, -1.0);
+
+  UinsSimulator sim(UinsSimulator::default_config());
+  std::string link = "/tmp/bench_reconnect_" + std::to_string(getpid());
+  if (!sim.open(link))
+  {
+    ROS_FATAL("unable to create pty");
+    return 1;
+  }
+  sim.start();
+
+  ros::NodeHandle driver_private("~driver");
+  driver_private.setParam("port", link);
+  driver_private.setParam("stream_INS", true);
+  driver_private.setParam("stream_IMU", true);
+  driver_private.setParam("publishTf", false);
+  driver_private.setParam("lazy_streams", false);
+  if (!driver_private.hasParam("stall_timeout"))
+    driver_private.setParam("stall_timeout", 0.5);
+
+  ros::Subscriber sub = nh.subscribe<sensor_msgs::Imu>("imu", 1000, [](const sensor_msgs::Imu::ConstPtr& m)
+    { (void)m; s_last_imu_ns = monotonic_ns(); });
+  ros::AsyncSpinner spinner(1);
+  spinner.start();
+
+  InertialSenseROS driver(nh, driver_private);
+  std::thread driver_thread(&InertialSenseROS::spin, &driver);
+
+  scenario_t scenarios[] = { { "unplug", {}, {}, 0 }, { "stall", {}, {}, 0 } };
+  if (!wait_for_imu(0, 10.0))
+  {
+    ROS_FATAL("no imu data from the driver");
+    return 1;
+  }
+
+  for (int c = 0; c < cycles; c++)
+  {
+    for (int s = 0; s < 2; s++)
+    {
+      // streaming again before each cycle
+      if (!wait_for_imu(monotonic_ns(), 5.0))
+      {
+        ROS_ERROR("not streaming before cycle %d (%s)", c, scenarios[s].name);
+        scenarios[s].failures++;
+        continue;
+      }
+
+      uint64_t lost = monotonic_ns();
+      if (s == 0)
+        sim.unplug();
+      else
+        sim.stop();
+      ros::WallDuration(down_time).sleep();
+      uint64_t back = monotonic_ns();
+      if (s == 0)
+        sim.replug(power_cycled);
+      else
+        sim.start();
+
+      uint64_t first = wait_for_imu(back, 30.0);
+      if (!first)
+      {
+        scenarios[s].failures++;
+        continue;
+      }
+      scenarios[s].recovery_ms.push_back((first - back) * 1e-6);
+      scenarios[s].outage_ms.push_back((first - lost) * 1e-6);
+    }
+  }
+
+  sim.stop();
+  driver.shutdown();
+  driver_thread.join();
+  spinner.stop();
+
+  printf("\n%-8s %6s %8s %10s %10s %10s %10s %10s\n",
+         "cycle", "count", "failed", "min ms", "p50 ms", "max ms", "outage p50", "outage max");
+  bool failed = false;
+  for (int s = 0; s < 2; s++)
+  {
+    report(scenarios[s]);
+    failed |= scenarios[s].failures > 0;
+    if (max_recovery_ms >= 0.0 && !scenarios[s].recovery_ms.empty() && scenarios[s].recovery_ms.back() > max_recovery_ms)
+      failed = true;
+  }
+  printf("\ndriver reconnects %u  time sync resets %u  (down time %.2f s, stall timeout %.2f s)\n",
+         driver.reconnects_, driver.boot_clock_.resets() + driver.tow_clock_.resets(), down_time, driver.stall_timeout_);
+
+  if (failed)
+    printf("FAILED: a cycle didn't recover, or took longer than max_recovery_ms\n");
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,139 @@
+/**
+ * Checks the arrival time SerialPipeline hands the decoder (last_arrival_ns(), which stamps
+ * messages when there's no GPS time) and reports how long the reader thread takes to move bytes
+ * from the port into its ring.
+ *
+ * A pseudo-terminal stands in for the uINS.  Two chunks are written some milliseconds apart and
+ * left to reach the ring, then the decoder side reads
+ *   exactly the first chunk          - must carry the first chunk's time, not the second's
+ *   half of the second chunk         - the second chunk's time
+ *   the rest of the second chunk     - the second chunk's time
+ * and a read spanning both chunks must carry the second chunk's time.
+ *
+ * usage: bench_serial_pipeline [rounds]
+ * exits with status 1 if a read carries the wrong chunk's time
+ */
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "InertialSense.h"
+#include "serialPortExt.h"
+#include "serial_pipeline.h"
+
+static const int CHUNK = 100;
+
+static uint64_t monotonic_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static int open_pty(std::string& slave_name)
+{
+  int master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0)
+    return -1;
+  struct termios tty;
+  tcgetattr(master, &tty);
+  cfmakeraw(&tty);
+  tcsetattr(master, TCSANOW, &tty);
+  slave_name = ptsname(master);
+  return master;
+}
+
+// write a chunk and wait for the reader thread to put it in the ring, returns the write time
+static uint64_t send_chunk(int master, const SerialPipeline& pipeline, uint64_t fill, std::vector<double>& ring_us)
+{
+  static const uint8_t bytes[CHUNK] = { 0 };
+  uint64_t written = monotonic_ns();
+  if (write(master, bytes, CHUNK) != CHUNK)
+    fprintf(stderr, "short write to pty\n");
+  while (pipeline.stats().fill < fill + CHUNK && monotonic_ns() - written < 1000000000ull)
+    usleep(100);
+  ring_us.push_back((monotonic_ns() - written) * 1e-3);
+  return written;
+}
+
+// stamp must be between the write of the chunk it belongs to and the write of the next one
+static bool check(const char* read, uint64_t stamp, uint64_t round, uint64_t from, uint64_t to)
+{
+  if (stamp >= from && stamp < to)
+    return true;
+  printf("  WRONG STAMP reading %s: %.3f ms into the round, expected %.3f to %.3f ms\n", read,
+         ((int64_t)stamp - (int64_t)round) * 1e-6, (from - round) * 1e-6, (to - round) * 1e-6);
+  return false;
+}
+
+int main(int argc, char** argv)
+{
+  int rounds = argc > 1 ? atoi(argv[1]) : 100;
+
+  std::string slave;
+  int master = open_pty(slave);
+  InertialSense is;
+  if (master < 0 || !is.Open(slave.c_str(), 921600) || !serialPortPlatformAdopt(is.GetSerialPort(), 921600))
+  {
+    fprintf(stderr, "unable to open %s\n", slave.c_str());
+    return 1;
+  }
+  fcntl(master, F_SETFL, O_NONBLOCK);
+  serial_port_t* port = is.GetSerialPort();
+  // the SDK's requests from Open
+  uint8_t discard[256];
+  usleep(10000);
+  while (read(master, discard, sizeof(discard)) > 0) {}
+  serialPortFlush(port);
+
+  SerialPipeline pipeline(1 << 16);
+  if (!pipeline.start(port, 0))
+  {
+    fprintf(stderr, "unable to start the pipeline\n");
+    return 1;
+  }
+
+  std::vector<double> ring_us;
+  uint8_t buf[2 * CHUNK];
+  bool failed = false;
+  for (int r = 0; r < rounds && !failed; r++)
+  {
+    uint64_t first = send_chunk(master, pipeline, 0, ring_us);
+    usleep(2000);
+    uint64_t second = send_chunk(master, pipeline, CHUNK, ring_us);
+    uint64_t end = monotonic_ns();
+
+    // the read ends on the chunk boundary
+    failed |= port->pfnRead(port, buf, CHUNK, 0) != CHUNK ||
+              !check("exactly the first chunk", pipeline.last_arrival_ns(), first, first, second);
+    failed |= port->pfnRead(port, buf, CHUNK / 2, 0) != CHUNK / 2 ||
+              !check("half of the second chunk", pipeline.last_arrival_ns(), first, second, end);
+    failed |= port->pfnRead(port, buf, CHUNK - CHUNK / 2, 0) != CHUNK - CHUNK / 2 ||
+              !check("the rest of the second chunk", pipeline.last_arrival_ns(), first, second, end);
+
+    first = send_chunk(master, pipeline, 0, ring_us);
+    usleep(2000);
+    second = send_chunk(master, pipeline, CHUNK, ring_us);
+    end = monotonic_ns();
+    failed |= port->pfnRead(port, buf, 2 * CHUNK, 0) != 2 * CHUNK ||
+              !check("both chunks", pipeline.last_arrival_ns(), first, second, end);
+  }
+  pipeline.stop();
+  close(master);
+
+  std::sort(ring_us.begin(), ring_us.end());
+  printf("%zu chunks: write to ring (100 us polling) p50 %.1f us, p99 %.1f us, max %.1f us\n", ring_us.size(),
+         ring_us[ring_us.size() / 2], ring_us[std::min(ring_us.size() - 1, ring_us.size() * 99 / 100)],
+         ring_us.back());
+  if (failed)
+    printf("FAILED: a read carried another chunk's arrival time\n");
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,250 @@
+/**
+ * End-to-end throughput / latency benchmark of the driver against the uINS simulator.
+ *
+ * The simulator's pseudo-terminal is handed to an InertialSenseROS instance running in this
+ * process (so its spin thread's CPU time can be measured on its own), and the published topics
+ * are subscribed here.  Every tagged packet is matched to its message by sequence number (see
+ * uins_simulator.h), and after a warm-up the benchmark reports per topic over the measurement
+ * window: packets sent, messages received, achieved rate, drops, and packet-write to subscriber
+ * latency percentiles; plus driver thread and process CPU usage.
+ *
+ * Needs a running roscore.  Parameters (private):
+ *   duration (10 s), warmup (2 s), imu_rate (500), ins_rate (100), gps_rate (5), obs_rate (5),
+ *   sats (12), eph_rate (1) - simulator rates in Hz before the driver's period multiples; more
+ *     sats than fit in one DID_GPS1_RAW packet send each epoch as several packets
+ *   max_drop_fraction, max_p99_latency_ms - exit with status 1 if any topic exceeds them (off if < 0)
+ * Also exits with status 1 if an epoch that reached gps/obs is short of observations.
+ *   driver/... - passed to the driver (e.g. _driver/pipeline_mode:=true)
+ */
+#include <pthread.h>
+#include <stdio.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <map>
+#include <thread>
+#include <vector>
+
+#include "inertial_sense.h"
+#include "uins_simulator.h"
+
+static uint64_t monotonic_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static double clock_seconds(clockid_t clock)
+{
+  struct timespec ts;
+  clock_gettime(clock, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+typedef struct
+{
+  uint32_t seq;
+  uint64_t recv_ns;
+} receipt_t;
+
+typedef struct
+{
+  const char* topic;
+  int stream;
+  std::vector<receipt_t> receipts;
+} probe_t;
+
+static void record(probe_t* probe, double tag)
+{
+  if (tag < 0.0)
+    return;
+  receipt_t r = { (uint32_t)(tag + 0.5), monotonic_ns() };
+  probe->receipts.push_back(r);
+}
+
+static double percentile(const std::vector<double>& sorted, double p)
+{
+  if (sorted.empty())
+    return 0.0;
+  size_t i = std::min(sorted.size() - 1, (size_t)(p * sorted.size()));
+  return sorted[i];
+}
+
+int main(int argc, char** argv)
+{
+  ros::init(argc, argv, "bench_throughput");
+  ros::NodeHandle nh;
+  ros::NodeHandle nh_private("~");
+
+  double duration, warmup, max_drop_fraction, max_p99_latency_ms;
+  nh_private.param<double>("duration", duration, 10.0);
+  nh_private.param<double>("warmup", warmup, 2.0);
+  nh_private.param<double>("max_drop_fraction", max_drop_fraction, -1.0);
+  nh_private.param<double>("max_p99_latency_ms", max_p99_latency_ms, -1.0);
+
+  UinsSimulator::config_t config = UinsSimulator::default_config();
+  double rate;
+  nh_private.param<double>("imu_rate", config.rate[UinsSimulator::SIM_DUAL_IMU], config.rate[UinsSimulator::SIM_DUAL_IMU]);
+  nh_private.param<double>("ins_rate", rate, config.rate[UinsSimulator::SIM_INS_2]);
+  config.rate[UinsSimulator::SIM_INS_1] = config.rate[UinsSimulator::SIM_INS_2] = rate;
+  nh_private.param<double>("gps_rate", rate, config.rate[UinsSimulator::SIM_GPS1_POS]);
+  config.rate[UinsSimulator::SIM_GPS1_POS] = config.rate[UinsSimulator::SIM_GPS1_VEL] = rate;
+  nh_private.param<double>("obs_rate", config.rate[UinsSimulator::SIM_GPS1_OBS], config.rate[UinsSimulator::SIM_GPS1_OBS]);
+  nh_private.param<double>("eph_rate", config.rate[UinsSimulator::SIM_GPS1_EPH], config.rate[UinsSimulator::SIM_GPS1_EPH]);
+  nh_private.param<int>("sats", config.obs_per_epoch, config.obs_per_epoch);
+
+  UinsSimulator sim(config);
+  if (!sim.open())
+  {
+    ROS_FATAL("unable to create pty");
+    return 1;
+  }
+  sim.start();
+
+  ros::NodeHandle driver_private("~driver");
+  driver_private.setParam("port", sim.port());
+  driver_private.setParam("stream_INS", true);
+  driver_private.setParam("stream_IMU", true);
+  driver_private.setParam("stream_GPS", true);
+  driver_private.setParam("stream_GPS_raw", true);
+  driver_private.setParam("publishTf", false);
+
+  probe_t probes[] = {
+    { "imu", UinsSimulator::SIM_DUAL_IMU },
+    { "ins", UinsSimulator::SIM_INS_2 },
+    { "gps", UinsSimulator::SIM_GPS1_POS },
+    { "gps/obs", UinsSimulator::SIM_GPS1_OBS },
+    { "gps/eph+geph", UinsSimulator::SIM_GPS1_EPH },
+  };
+  const int probe_count = sizeof(probes) / sizeof(probes[0]);
+  for (int i = 0; i < probe_count; i++)
+    probes[i].receipts.reserve((size_t)(config.rate[probes[i].stream] * (duration + warmup + 5.0)) + 16);
+
+  probe_t* p = probes;
+  std::map<uint32_t, size_t> obs_counts;  // observations received per epoch, over all its messages
+  std::map<uint32_t, size_t>* oc = &obs_counts;
+  ros::Subscriber subs[] = {
+    nh.subscribe<sensor_msgs::Imu>("imu", 1000, [p](const sensor_msgs::Imu::ConstPtr& m)
+      { record(&p[0], m->linear_acceleration.x); }),
+    nh.subscribe<nav_msgs::Odometry>("ins", 1000, [p](const nav_msgs::Odometry::ConstPtr& m)
+      { record(&p[1], m->twist.twist.linear.x); }),
+    nh.subscribe<inertial_sense::GPS>("gps", 1000, [p](const inertial_sense::GPS::ConstPtr& m)
+      { record(&p[2], m->hAcc); }),
+    nh.subscribe<inertial_sense::GNSSObsVec>("gps/obs", 1000, [p, oc](const inertial_sense::GNSSObsVec::ConstPtr& m)
+      {
+        if (m->obs.empty())
+          return;
+        double tag = (double)(m->obs[0].time.time - UinsSimulator::SIM_GTIME_BASE);
+        record(&p[3], tag);
+        if (tag >= 0.0)
+          (*oc)[(uint32_t)(tag + 0.5)] += m->obs.size();
+      }),
+    nh.subscribe<inertial_sense::GNSSEphemeris>("gps/eph", 1000, [p](const inertial_sense::GNSSEphemeris::ConstPtr& m)
+      { record(&p[4], (double)(m->toe.time - UinsSimulator::SIM_GTIME_BASE)); }),
+    nh.subscribe<inertial_sense::GlonassEphemeris>("gps/geph", 1000, [p](const inertial_sense::GlonassEphemeris::ConstPtr& m)
+      { record(&p[4], (double)(m->toe.time - UinsSimulator::SIM_GTIME_BASE)); }),
+  };
+  (void)subs;
+  // one spinner thread, so the probes need no locking
+  ros::AsyncSpinner spinner(1);
+  spinner.start();
+
+  InertialSenseROS driver(nh, driver_private);
+  std::thread driver_thread(&InertialSenseROS::spin, &driver);
+  clockid_t driver_clock;
+  pthread_getcpuclockid(driver_thread.native_handle(), &driver_clock);
+
+  ros::WallDuration(warmup).sleep();
+  uint64_t window_start = monotonic_ns();
+  double driver_cpu_start = clock_seconds(driver_clock);
+  double process_cpu_start = clock_seconds(CLOCK_PROCESS_CPUTIME_ID);
+
+  ros::WallDuration(duration).sleep();
+  uint64_t window_end = monotonic_ns();
+  double driver_cpu = clock_seconds(driver_clock) - driver_cpu_start;
+  double process_cpu = clock_seconds(CLOCK_PROCESS_CPUTIME_ID) - process_cpu_start;
+  double window = (window_end - window_start) * 1e-9;
+
+  // let in-flight messages (and the obs bundling timer) drain before stopping everything
+  ros::WallDuration(0.2).sleep();
+  sim.stop();
+  ros::WallDuration(0.1).sleep();
+  driver.shutdown();
+  driver_thread.join();
+  spinner.stop();
+
+  bool failed = false;
+  printf("\n%-13s %8s %8s %9s %7s %9s %10s %10s %10s %10s %10s\n",
+         "topic", "sent", "recv", "rate Hz", "drops", "overruns", "p50 us", "p90 us", "p99 us", "p99.9 us", "max us");
+  for (int i = 0; i < probe_count; i++)
+  {
+    const std::vector<uint64_t>& sent = sim.sent(probes[i].stream);
+
+    // every sequence written in the window, and the first receipt of each
+    std::vector<uint64_t> first_recv(sent.size(), 0);
+    for (size_t r = 0; r < probes[i].receipts.size(); r++)
+    {
+      const receipt_t& receipt = probes[i].receipts[r];
+      if (receipt.seq < first_recv.size() && first_recv[receipt.seq] == 0)
+        first_recv[receipt.seq] = receipt.recv_ns;
+    }
+
+    uint64_t sent_count = 0, recv_count = 0, overruns = 0;
+    std::vector<double> latency;
+    latency.reserve(sent.size());
+    for (size_t s = 0; s < sent.size(); s++)
+    {
+      if (sent[s] == 0)
+      {
+        overruns++; // dropped on the simulator side because the pty was full (not timed)
+        continue;
+      }
+      if (sent[s] < window_start || sent[s] >= window_end)
+        continue;
+      sent_count++;
+      if (first_recv[s] != 0)
+      {
+        recv_count++;
+        latency.push_back((first_recv[s] - sent[s]) * 1e-3);
+      }
+    }
+    std::sort(latency.begin(), latency.end());
+
+    uint64_t drops = sent_count - recv_count;
+    printf("%-13s %8lu %8lu %9.1f %7lu %9lu %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+           probes[i].topic, (unsigned long)sent_count, (unsigned long)recv_count, recv_count / window,
+           (unsigned long)drops, (unsigned long)overruns,
+           percentile(latency, 0.5), percentile(latency, 0.9), percentile(latency, 0.99),
+           percentile(latency, 0.999), latency.empty() ? 0.0 : latency.back());
+
+    if (max_drop_fraction >= 0.0 && sent_count > 0 && (double)drops / sent_count > max_drop_fraction)
+      failed = true;
+    if (max_p99_latency_ms >= 0.0 && percentile(latency, 0.99) > max_p99_latency_ms * 1e3)
+      failed = true;
+  }
+  // epochs written in the window that got through, with every observation
+  const std::vector<uint64_t>& obs_sent = sim.sent(UinsSimulator::SIM_GPS1_OBS);
+  uint64_t epochs = 0, short_epochs = 0;
+  for (auto it = obs_counts.begin(); it != obs_counts.end(); ++it)
+  {
+    if (it->first >= obs_sent.size() || obs_sent[it->first] < window_start || obs_sent[it->first] >= window_end)
+      continue;
+    epochs++;
+    if (it->second != (size_t)sim.config().obs_per_epoch)
+      short_epochs++;
+  }
+  printf("\ngps/obs epochs of %d observations (%d per packet): %lu received, %lu short of observations\n",
+         sim.config().obs_per_epoch, (int)MAX_OBSERVATION_COUNT_IN_RTK_MESSAGE, (unsigned long)epochs,
+         (unsigned long)short_epochs);
+  if (short_epochs)
+    failed = true;
+
+  printf("\ndriver thread cpu %.2f%%  process cpu %.2f%%  (over %.1f s)  host requests answered %lu\n",
+         100.0 * driver_cpu / window, 100.0 * process_cpu / window, window, (unsigned long)sim.requests());
+
+  if (failed)
+    printf("FAILED: drop fraction or p99 latency over the configured limit, or observations lost\n");
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,194 @@
+/**
+ * Accuracy of uINS to host time sync without GPS (ClockSkewEstimator) against the previous
+ * fixed 0.005 low-pass of the host - uINS offset.
+ *
+ * uINS time stamps come from the DID_DUAL_IMU data sets of a log (first device), or are
+ * generated at 500 Hz.  Their arrival on the host is simulated with a host clock running
+ * `skew_ppm` fast, a fixed transport latency floor plus exponential jitter, random latency spikes,
+ * and periodic seconds-long congestion.  Both estimators are fed every arrival, and their error
+ * against the true host time of each sample (latency floor included, it can't be observed) is
+ * reported after `settle` seconds.  Then:
+ *   - the estimator is restarted cold and seeded from the persisted state, and the error over the
+ *     first seconds after the restart compared
+ *   - GPS time (host clock - 3 ms) takes over half way through, and the largest step that causes
+ *     in the stamps is reported
+ * Doesn't need a roscore.
+ *
+ * usage: bench_time_sync [LOG_DIR] [--skew-ppm 40] [--settle 20] [--max-p99-us 300]
+ * exits with status 1 if the p99 error above the latency floor exceeds max-p99-us, or the
+ * handover steps the stamps by more than 1 ms
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "ISLogger.h"
+#include "clock_sync.h"
+
+static const double LATENCY_FLOOR_S = 0.0008;
+
+typedef struct
+{
+  double p50, p99, max, mean;
+} error_stats_t;
+
+static error_stats_t stats(std::vector<double> errors)
+{
+  error_stats_t s = { 0.0, 0.0, 0.0, 0.0 };
+  if (errors.empty())
+    return s;
+  for (size_t i = 0; i < errors.size(); i++)
+  {
+    s.mean += errors[i];
+    errors[i] = fabs(errors[i]);
+  }
+  s.mean /= errors.size();
+  std::sort(errors.begin(), errors.end());
+  s.p50 = errors[errors.size() / 2];
+  s.p99 = errors[std::min(errors.size() - 1, (size_t)(0.99 * errors.size()))];
+  s.max = errors.back();
+  return s;
+}
+
+static void print(const char* name, const error_stats_t& s)
+{
+  printf("%-28s |error| p50 %8.1f us  p99 %8.1f us  max %8.1f us   mean error %+8.1f us\n",
+         name, s.p50 * 1e6, s.p99 * 1e6, s.max * 1e6, s.mean * 1e6);
+}
+
+static bool load_log(const std::string& directory, std::vector<double>& device_times)
+{
+  cISLogger logger;
+  if (!logger.LoadFromDirectory(directory, cISLogger::LOGTYPE_DAT) || logger.GetDeviceCount() == 0)
+    return false;
+  for (p_data_t* data = logger.ReadData(0); data != NULL; data = logger.ReadData(0))
+  {
+    if (data->hdr.id == DID_DUAL_IMU && data->hdr.offset == 0 && data->hdr.size >= sizeof(double))
+      device_times.push_back(reinterpret_cast<const dual_imu_t*>(data->buf)->time);
+  }
+  return device_times.size() > 2;
+}
+
+int main(int argc, char** argv)
+{
+  std::string log_directory;
+  double skew_ppm = 40.0, settle = 20.0, max_p99_us = 300.0;
+  for (int i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "--skew-ppm") && i + 1 < argc)
+      skew_ppm = atof(argv[++i]);
+    else if (!strcmp(argv[i], "--settle") && i + 1 < argc)
+      settle = atof(argv[++i]);
+    else if (!strcmp(argv[i], "--max-p99-us") && i + 1 < argc)
+      max_p99_us = atof(argv[++i]);
+    else
+      log_directory = argv[i];
+  }
+
+  std::vector<double> device_times;
+  if (!log_directory.empty())
+  {
+    if (!load_log(log_directory, device_times))
+    {
+      fprintf(stderr, "no DID_DUAL_IMU time stamps in %s\n", log_directory.c_str());
+      return 1;
+    }
+  }
+  else
+  {
+    for (int i = 0; i < 500 * 600; i++)
+      device_times.push_back(1234.5 + i * 0.002);
+  }
+  printf("%lu uINS time stamps over %.1f s, host clock %+.1f ppm\n\n", (unsigned long)device_times.size(),
+         device_times.back() - device_times.front(), skew_ppm);
+
+  // arrivals
+  std::mt19937 rng(1);
+  std::exponential_distribution<double> jitter(1.0 / 0.0002);
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  const double host0 = 1.6e9, t0 = device_times.front(), skew = skew_ppm * 1e-6;
+  std::vector<double> host_true(device_times.size()), arrival(device_times.size());
+  for (size_t i = 0; i < device_times.size(); i++)
+  {
+    double t = device_times[i] - t0;
+    host_true[i] = host0 + (1.0 + skew) * t;
+    double latency = LATENCY_FLOOR_S + jitter(rng);
+    if (uniform(rng) < 0.02)
+      latency += 0.005 + 0.045 * uniform(rng);   // spikes
+    if (fmod(t, 30.0) < 2.0 && t > 1.0)
+      latency += 0.02;                            // congestion
+    arrival[i] = host_true[i] + latency;
+  }
+
+  // old low-pass and new estimator, errors above the latency floor after settling
+  std::vector<double> old_errors, new_errors;
+  ClockSkewEstimator estimator;
+  double lowpass = 0.0;
+  for (size_t i = 0; i < device_times.size(); i++)
+  {
+    double y = arrival[i] - device_times[i];
+    lowpass = (i == 0) ? y : 0.005 * y + 0.995 * lowpass;
+    double estimate = estimator.update(device_times[i], arrival[i]);
+    if (device_times[i] - t0 < settle)
+      continue;
+    double truth = host_true[i] + LATENCY_FLOOR_S;
+    old_errors.push_back(lowpass + device_times[i] - truth);
+    new_errors.push_back(estimate - truth);
+  }
+  error_stats_t old_stats = stats(old_errors), new_stats = stats(new_errors);
+  print("low-pass 0.005", old_stats);
+  print("lower-envelope regression", new_stats);
+  printf("%-28s skew %+.2f ppm (true %+.2f), latency above envelope %.1f us mean, %.1f us jitter\n\n", "",
+         estimator.skew() * 1e6, skew_ppm, estimator.residual_mean() * 1e6, estimator.residual_stddev() * 1e6);
+
+  // restart half way through, cold vs seeded from the state persisted at that point
+  size_t restart = device_times.size() / 2;
+  ClockSkewEstimator before, cold, seeded;
+  for (size_t i = 0; i < restart; i++)
+    before.update(device_times[i], arrival[i]);
+  clock_sync_state_t state = { before.skew(), device_times[restart - 1], before.to_host(device_times[restart - 1]) };
+  seeded.seed(state.device_s, state.host_s, state.skew);
+  std::vector<double> cold_errors, seeded_errors;
+  for (size_t i = restart; i < device_times.size() && device_times[i] - device_times[restart] < 10.0; i++)
+  {
+    double truth = host_true[i] + LATENCY_FLOOR_S;
+    cold_errors.push_back(cold.update(device_times[i], arrival[i]) - truth);
+    seeded_errors.push_back(seeded.update(device_times[i], arrival[i]) - truth);
+  }
+  print("first 10 s after restart", stats(cold_errors));
+  print("  ... seeded", stats(seeded_errors));
+
+  // GPS (host clock 3 ms behind it) takes over half way through
+  ClockSkewEstimator clock;
+  TimeHandover handover;
+  double last_out = 0.0, last_gps = 0.0, max_step = 0.0;
+  for (size_t i = 0; i < device_times.size(); i++)
+  {
+    double estimate = clock.update(device_times[i], arrival[i]);
+    double out = estimate, gps = 0.0;
+    if (i >= restart)
+    {
+      gps = host_true[i] - 0.003;
+      out = gps + handover.correction(gps, estimate);
+      if (i > restart)
+        max_step = std::max(max_step, fabs((out - last_out) - (gps - last_gps)));
+      else
+        max_step = std::max(max_step, fabs((out - last_out) - (device_times[i] - device_times[i - 1])));
+    }
+    last_out = out;
+    last_gps = gps;
+  }
+  printf("\nGPS handover: largest step in stamps %.1f us, correction left at the end %.1f us\n",
+         max_step * 1e6, handover.current() * 1e6);
+
+  bool failed = new_stats.p99 > max_p99_us * 1e-6 || max_step > 0.001;
+  if (failed)
+    printf("FAILED: p99 error over %.0f us or handover step over 1 ms\n", max_p99_us);
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,117 @@
+/**
+ * Benchmark subscriber for the imu and ins topics.
+ *
+ * Load it in the same nodelet manager as inertial_sense/InertialSenseNodelet to measure
+ * zero-copy intra-process delivery, or next to a standalone inertial_sense_node to measure the
+ * serialized path (see launch/bench_intra_process.launch).  Every report_period seconds it logs,
+ * per topic, the message rate and the header.stamp -> callback latency percentiles, plus the
+ * number of CPU cores busy system-wide (so driver and subscriber are both counted in either setup).
+ */
+#include <stdio.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+#include <ros/ros.h>
+#include <nav_msgs/Odometry.h>
+#include <sensor_msgs/Imu.h>
+
+namespace inertial_sense_bench
+{
+
+class LatencyProbe : public nodelet::Nodelet
+{
+private:
+  typedef struct
+  {
+    std::string name;
+    std::vector<double> latency;
+  } topic_stats_t;
+
+  virtual void onInit()
+  {
+    ros::NodeHandle& nh = getNodeHandle();
+    double report_period;
+    getPrivateNodeHandle().param<double>("report_period", report_period, 5.0);
+
+    imu_.name = "imu";
+    ins_.name = "ins";
+    imu_.latency.reserve(20000);
+    ins_.latency.reserve(20000);
+    imu_sub_ = nh.subscribe("imu", 100, &LatencyProbe::imu_callback, this);
+    ins_sub_ = nh.subscribe("ins", 100, &LatencyProbe::ins_callback, this);
+
+    read_cpu(last_busy_, last_total_);
+    last_report_ = ros::WallTime::now();
+    report_timer_ = nh.createWallTimer(ros::WallDuration(report_period), &LatencyProbe::report, this);
+  }
+
+  void imu_callback(const sensor_msgs::Imu::ConstPtr& msg)
+  {
+    imu_.latency.push_back((ros::Time::now() - msg->header.stamp).toSec());
+  }
+
+  void ins_callback(const nav_msgs::Odometry::ConstPtr& msg)
+  {
+    ins_.latency.push_back((ros::Time::now() - msg->header.stamp).toSec());
+  }
+
+  static void read_cpu(unsigned long long& busy, unsigned long long& total)
+  {
+    unsigned long long user = 0, nice = 0, system = 0, idle = 0, iowait = 0, irq = 0, softirq = 0;
+    FILE* f = fopen("/proc/stat", "r");
+    if (f)
+    {
+      if (fscanf(f, "cpu %llu %llu %llu %llu %llu %llu %llu", &user, &nice, &system, &idle, &iowait, &irq, &softirq) != 7)
+        user = nice = system = idle = iowait = irq = softirq = 0;
+      fclose(f);
+    }
+    busy = user + nice + system + irq + softirq;
+    total = busy + idle + iowait;
+  }
+
+  void report_topic(topic_stats_t& t, double dt)
+  {
+    std::vector<double>& v = t.latency;
+    if (v.empty())
+    {
+      NODELET_INFO("%-4s no messages", t.name.c_str());
+      return;
+    }
+    std::sort(v.begin(), v.end());
+    size_t n = v.size();
+    NODELET_INFO("%-4s %8.1f Hz  latency p50 %8.1f us  p99 %8.1f us  max %8.1f us", t.name.c_str(), n / dt,
+                 v[n / 2] * 1e6, v[std::min(n - 1, (size_t)(n * 0.99))] * 1e6, v[n - 1] * 1e6);
+    v.clear();
+  }
+
+  void report(const ros::WallTimerEvent&)
+  {
+    ros::WallTime now = ros::WallTime::now();
+    double dt = (now - last_report_).toSec();
+    last_report_ = now;
+
+    unsigned long long busy, total;
+    read_cpu(busy, total);
+    double cores = (total > last_total_) ? (double)(busy - last_busy_) / (total - last_total_) * sysconf(_SC_NPROCESSORS_ONLN) : 0.0;
+    last_busy_ = busy;
+    last_total_ = total;
+
+    report_topic(imu_, dt);
+    report_topic(ins_, dt);
+    NODELET_INFO("cpu  %.3f cores busy (system wide)", cores);
+  }
+
+  topic_stats_t imu_, ins_;
+  ros::Subscriber imu_sub_, ins_sub_;
+  ros::WallTimer report_timer_;
+  ros::WallTime last_report_;
+  unsigned long long last_busy_, last_total_;
+};
+
+} // namespace inertial_sense_bench
+
+PLUGINLIB_EXPORT_CLASS(inertial_sense_bench::LatencyProbe, nodelet::Nodelet)
@@ -0,0 +1,479 @@
+#include "uins_simulator.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+static const double SIM_TOW_START = 300000.0; // GPS time of week at simulator start (s)
+static const uint32_t SIM_WEEK = 2100;
+
+static uint64_t monotonic_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static int stream_of_did(uint32_t did, int* second)
+{
+  *second = -1;
+  switch (did)
+  {
+  case DID_DUAL_IMU: return UinsSimulator::SIM_DUAL_IMU;
+  case DID_INS_1:    return UinsSimulator::SIM_INS_1;
+  case DID_INS_2:    return UinsSimulator::SIM_INS_2;
+  case DID_GPS1_POS: return UinsSimulator::SIM_GPS1_POS;
+  case DID_GPS1_VEL: return UinsSimulator::SIM_GPS1_VEL;
+  case DID_GPS1_RAW: *second = UinsSimulator::SIM_GPS1_EPH; return UinsSimulator::SIM_GPS1_OBS;
+  default:           return -1;
+  }
+}
+
+UinsSimulator::config_t UinsSimulator::default_config()
+{
+  config_t config;
+  config.rate[SIM_DUAL_IMU] = 500.0;
+  config.rate[SIM_INS_1] = 100.0;
+  config.rate[SIM_INS_2] = 100.0;
+  config.rate[SIM_GPS1_POS] = 5.0;
+  config.rate[SIM_GPS1_VEL] = 5.0;
+  config.rate[SIM_GPS1_OBS] = 5.0;
+  config.rate[SIM_GPS1_EPH] = 1.0;
+  config.obs_per_epoch = 12;
+  config.always_stream = false;
+  return config;
+}
+
+UinsSimulator::UinsSimulator(const config_t& config) :
+  config_(config), master_(-1), running_(false), start_ns_(0), requests_(0), write_drops_(0)
+{
+  // satellite numbers are a byte
+  config_.obs_per_epoch = std::max(1, std::min(config_.obs_per_epoch, 255));
+
+  for (int i = 0; i < SIM_COUNT; i++)
+  {
+    multiple_[i] = config_.always_stream ? 1 : 0;
+    next_ns_[i] = 0;
+  }
+
+  memset(&dev_info_, 0, sizeof(dev_info_));
+  dev_info_.serialNumber = 99999;
+  dev_info_.hardwareVer[0] = 3;
+  dev_info_.firmwareVer[0] = 1;
+  dev_info_.firmwareVer[1] = 8;
+  strncpy(dev_info_.manufacturer, "Inertial Sense INC (simulated)", sizeof(dev_info_.manufacturer) - 1);
+
+  memset(&flash_, 0, sizeof(flash_));
+  flash_.size = sizeof(nvm_flash_cfg_t);
+  flash_.startupNavDtMs = 4;
+  flash_.startupImuDtMs = 1;
+  flash_.ser0BaudRate = 921600;
+  flash_.ser1BaudRate = 921600;
+
+  memset(&sys_params_, 0, sizeof(sys_params_));
+  sys_params_.imuPeriodMs = flash_.startupImuDtMs;
+  sys_params_.navPeriodMs = flash_.startupNavDtMs;
+
+  is_comm_init(&tx_, tx_buffer_, sizeof(tx_buffer_));
+  is_comm_init(&rx_, rx_buffer_, sizeof(rx_buffer_));
+}
+
+UinsSimulator::~UinsSimulator()
+{
+  stop();
+  if (master_ >= 0)
+    close(master_);
+  if (!link_.empty())
+    unlink(link_.c_str());
+}
+
+bool UinsSimulator::open(const std::string& link)
+{
+  master_ = posix_openpt(O_RDWR | O_NOCTTY);
+  if (master_ < 0 || grantpt(master_) != 0 || unlockpt(master_) != 0)
+    return false;
+  struct termios tty;
+  tcgetattr(master_, &tty);
+  cfmakeraw(&tty);
+  tcsetattr(master_, TCSANOW, &tty);
+  fcntl(master_, F_SETFL, O_NONBLOCK);
+  port_ = ptsname(master_);
+
+  if (!link.empty())
+  {
+    unlink(link.c_str());
+    if (symlink(port_.c_str(), link.c_str()) != 0)
+    {
+      fprintf(stderr, "uins_simulator: unable to link %s -> %s (%s)\n", link.c_str(), port_.c_str(), strerror(errno));
+      return false;
+    }
+    link_ = link;
+  }
+  return true;
+}
+
+void UinsSimulator::start()
+{
+  if (running_ || master_ < 0)
+    return;
+
+  // enough room for a few minutes at the configured rates, so recording never allocates while streaming
+  for (int i = 0; i < SIM_COUNT; i++)
+    sent_[i].reserve((size_t)(config_.rate[i] * 600.0) + 16);
+
+  if (start_ns_ == 0)
+    start_ns_ = monotonic_ns();
+  running_ = true;
+  thread_ = std::thread(&UinsSimulator::run, this);
+  pthread_getcpuclockid(thread_.native_handle(), &cpu_clock_);
+}
+
+void UinsSimulator::stop()
+{
+  running_ = false;
+  if (thread_.joinable())
+    thread_.join();
+}
+
+void UinsSimulator::unplug()
+{
+  stop();
+  if (master_ >= 0)
+    close(master_);
+  master_ = -1;
+  if (!link_.empty())
+    unlink(link_.c_str());
+}
+
+bool UinsSimulator::replug(bool power_cycled)
+{
+  if (link_.empty())
+    return false;
+  if (master_ < 0 && !open(link_))
+    return false;
+  is_comm_init(&rx_, rx_buffer_, sizeof(rx_buffer_));
+  if (power_cycled && !config_.always_stream)
+    for (int s = 0; s < SIM_COUNT; s++)
+      multiple_[s] = 0;
+  start();
+  return true;
+}
+
+double UinsSimulator::cpu_seconds() const
+{
+  if (!running_)
+    return 0.0;
+  struct timespec ts;
+  if (clock_gettime(cpu_clock_, &ts) != 0)
+    return 0.0;
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void UinsSimulator::run()
+{
+  struct pollfd pfd;
+  pfd.fd = master_;
+  pfd.events = POLLIN;
+
+  while (running_)
+  {
+    uint64_t now = monotonic_ns();
+    uint64_t wake = now + 10000000ull;
+    for (int i = 0; i < SIM_COUNT; i++)
+    {
+      if (multiple_[i] == 0 || config_.rate[i] <= 0.0)
+        continue;
+      uint64_t period = (uint64_t)(1e9 * multiple_[i] / config_.rate[i]);
+      if (next_ns_[i] == 0)
+        next_ns_[i] = now;
+      if (next_ns_[i] <= now)
+      {
+        emit(i, now);
+        // stay on the original schedule, but don't try to catch up after a stall
+        next_ns_[i] += period;
+        if (next_ns_[i] < now)
+          next_ns_[i] = now + period;
+      }
+      if (next_ns_[i] < wake)
+        wake = next_ns_[i];
+    }
+
+    now = monotonic_ns();
+    uint64_t wait = wake > now ? wake - now : 0;
+    struct timespec timeout = { (time_t)(wait / 1000000000ull), (long)(wait % 1000000000ull) };
+    pfd.revents = 0;
+    if (ppoll(&pfd, 1, &timeout, NULL) > 0 && (pfd.revents & POLLIN))
+      handle_host_input();
+  }
+}
+
+void UinsSimulator::handle_host_input()
+{
+  uint8_t buf[512];
+  int n;
+  while ((n = read(master_, buf, sizeof(buf))) > 0)
+  {
+    for (int i = 0; i < n; i++)
+    {
+      switch (is_comm_parse_byte(&rx_, buf[i]))
+      {
+      case _PTYPE_INERTIAL_SENSE_DATA:
+        requests_++;
+        if (rx_.pkt.hdr.pid == PID_SET_DATA && rx_.dataHdr.id == DID_FLASH_CONFIG &&
+            rx_.dataHdr.offset + rx_.dataHdr.size <= sizeof(nvm_flash_cfg_t))
+        {
+          // apply and echo, so the host's copy of the flash config follows
+          memcpy(reinterpret_cast<uint8_t*>(&flash_) + rx_.dataHdr.offset, rx_.dataPtr, rx_.dataHdr.size);
+          send(DID_FLASH_CONFIG, &flash_, sizeof(flash_));
+        }
+        else if (rx_.pkt.hdr.pid == PID_SET_DATA && rx_.dataHdr.id == DID_SYS_CMD && rx_.dataHdr.offset == 0 &&
+                 rx_.dataHdr.size >= sizeof(system_command_t) &&
+                 reinterpret_cast<const system_command_t*>(rx_.dataPtr)->command == 99)
+        {
+          // reset: forget the broadcasts and run at the rates in flash
+          if (!config_.always_stream)
+            for (int s = 0; s < SIM_COUNT; s++)
+              multiple_[s] = 0;
+          sys_params_.imuPeriodMs = flash_.startupImuDtMs;
+          sys_params_.navPeriodMs = flash_.startupNavDtMs;
+        }
+        break;
+
+      case _PTYPE_INERTIAL_SENSE_CMD:
+        requests_++;
+        if (rx_.pkt.hdr.pid == PID_GET_DATA && rx_.pkt.body.size >= sizeof(p_get_data_t))
+        {
+          const p_get_data_t* req = reinterpret_cast<const p_get_data_t*>(rx_.pkt.body.ptr);
+          int second;
+          int stream = stream_of_did(req->id, &second);
+          if (req->id == DID_DEV_INFO)
+            send(DID_DEV_INFO, &dev_info_, sizeof(dev_info_));
+          else if (req->id == DID_FLASH_CONFIG)
+            send(DID_FLASH_CONFIG, &flash_, sizeof(flash_));
+          else if (req->id == DID_SYS_PARAMS)
+            send(DID_SYS_PARAMS, &sys_params_, sizeof(sys_params_));
+          else if (stream >= 0)
+          {
+            multiple_[stream] = req->bc_period_multiple;
+            next_ns_[stream] = 0;
+            if (second >= 0)
+            {
+              multiple_[second] = req->bc_period_multiple;
+              next_ns_[second] = 0;
+            }
+          }
+        }
+        else if (rx_.pkt.hdr.pid == PID_STOP_DID_BROADCAST && rx_.pkt.body.size >= sizeof(uint32_t))
+        {
+          int second;
+          int stream = stream_of_did(*reinterpret_cast<const uint32_t*>(rx_.pkt.body.ptr), &second);
+          if (stream >= 0)
+            multiple_[stream] = 0;
+          if (second >= 0)
+            multiple_[second] = 0;
+        }
+        else if (rx_.pkt.hdr.pid == PID_STOP_BROADCASTS_ALL_PORTS || rx_.pkt.hdr.pid == PID_STOP_BROADCASTS_CURRENT_PORT)
+        {
+          if (!config_.always_stream)
+            for (int s = 0; s < SIM_COUNT; s++)
+              multiple_[s] = 0;
+        }
+        break;
+
+      default:
+        break;
+      }
+    }
+  }
+}
+
+void UinsSimulator::emit(int stream, uint64_t now_ns)
+{
+  uint32_t seq = (uint32_t)sent_[stream].size();
+  double t = (now_ns - start_ns_) * 1e-9;  // time since "boot"
+  double tow = SIM_TOW_START + t;
+  bool ok = false;
+
+  switch (stream)
+  {
+  case SIM_DUAL_IMU:
+  {
+    dual_imu_t imu;
+    memset(&imu, 0, sizeof(imu));
+    imu.time = t;
+    imu.I[0].acc[0] = (float)seq;
+    imu.I[0].acc[2] = imu.I[1].acc[2] = -9.81f;
+    imu.I[0].pqr[2] = imu.I[1].pqr[2] = 0.01f;
+    ok = send(DID_DUAL_IMU, &imu, sizeof(imu));
+    break;
+  }
+
+  case SIM_INS_1:
+  {
+    ins_1_t ins;
+    memset(&ins, 0, sizeof(ins));
+    ins.week = SIM_WEEK;
+    ins.timeOfWeek = tow;
+    ins.hdwStatus = HDW_STATUS_GPS_TIME_OF_WEEK_VALID;
+    ins.lla[0] = 40.25;
+    ins.lla[1] = -111.67;
+    ins.lla[2] = 1556.59;
+    ok = send(DID_INS_1, &ins, sizeof(ins));
+    break;
+  }
+
+  case SIM_INS_2:
+  {
+    ins_2_t ins;
+    memset(&ins, 0, sizeof(ins));
+    ins.week = SIM_WEEK;
+    ins.timeOfWeek = tow;
+    ins.hdwStatus = HDW_STATUS_GPS_TIME_OF_WEEK_VALID;
+    ins.qn2b[0] = 1.0f;
+    ins.uvw[0] = (float)seq;
+    ins.lla[0] = 40.25;
+    ins.lla[1] = -111.67;
+    ins.lla[2] = 1556.59;
+    ok = send(DID_INS_2, &ins, sizeof(ins));
+    break;
+  }
+
+  case SIM_GPS1_POS:
+  {
+    gps_pos_t pos;
+    memset(&pos, 0, sizeof(pos));
+    pos.week = SIM_WEEK;
+    pos.timeOfWeekMs = (uint32_t)(tow * 1000.0);
+    pos.status = GPS_STATUS_FIX_3D | GPS_STATUS_FLAGS_FIX_OK | 12;
+    pos.lla[0] = 40.25;
+    pos.lla[1] = -111.67;
+    pos.lla[2] = 1556.59;
+    pos.hMSL = 1570.0f;
+    pos.hAcc = (float)seq;
+    pos.vAcc = 1.0f;
+    pos.pDop = 1.2f;
+    pos.cnoMean = 45.0f;
+    pos.towOffset = SIM_TOW_START;
+    ok = send(DID_GPS1_POS, &pos, sizeof(pos));
+    break;
+  }
+
+  case SIM_GPS1_VEL:
+  {
+    gps_vel_t vel;
+    memset(&vel, 0, sizeof(vel));
+    vel.timeOfWeekMs = (uint32_t)(tow * 1000.0);
+    ok = send(DID_GPS1_VEL, &vel, sizeof(vel));
+    break;
+  }
+
+  case SIM_GPS1_OBS:
+  {
+    // like the uINS, an epoch goes out as full packets followed by a partial one
+    gps_raw_t raw;
+    memset(&raw, 0, sizeof(raw));
+    raw.receiverIndex = 1;
+    raw.dataType = raw_data_type_observation;
+    ok = true;
+    for (int first = 0; ok && first < config_.obs_per_epoch; first += MAX_OBSERVATION_COUNT_IN_RTK_MESSAGE)
+    {
+      int count = std::min(config_.obs_per_epoch - first, (int)MAX_OBSERVATION_COUNT_IN_RTK_MESSAGE);
+      raw.obsCount = (uint8_t)count;
+      for (int j = 0; j < count; j++)
+      {
+        int i = first + j;
+        obsd_t& obs = raw.data.obs[j];
+        obs.time.time = SIM_GTIME_BASE + seq;
+        obs.time.sec = 0.0;
+        obs.sat = (uint8_t)(i + 1);
+        obs.rcv = 1;
+        obs.SNR[0] = 180;
+        obs.code[0] = 1;
+        obs.P[0] = 2.0e7 + 1000.0 * i;
+        obs.L[0] = 1.05e8 + 5000.0 * i;
+        obs.D[0] = -100.0f + i;
+      }
+      uint32_t size = offsetof(gps_raw_t, data) + count * sizeof(obsd_t);
+      ok = send(DID_GPS1_RAW, &raw, size);
+    }
+    break;
+  }
+
+  case SIM_GPS1_EPH:
+  {
+    gps_raw_t raw;
+    memset(&raw, 0, sizeof(raw));
+    raw.receiverIndex = 1;
+    uint32_t size;
+    if (seq % 2 == 0)
+    {
+      raw.dataType = raw_data_type_ephemeris;
+      raw.data.eph.sat = (int)(seq / 2 % 32) + 1;
+      raw.data.eph.week = SIM_WEEK;
+      raw.data.eph.toe.time = SIM_GTIME_BASE + seq;
+      raw.data.eph.A = 26560000.0;
+      raw.data.eph.e = 0.01;
+      size = offsetof(gps_raw_t, data) + sizeof(eph_t);
+    }
+    else
+    {
+      raw.dataType = raw_data_type_glonass_ephemeris;
+      raw.data.gloEph.sat = 65 + (int)(seq / 2 % 24);
+      raw.data.gloEph.toe.time = SIM_GTIME_BASE + seq;
+      raw.data.gloEph.pos[0] = 1.9e7;
+      size = offsetof(gps_raw_t, data) + sizeof(geph_t);
+    }
+    ok = send(DID_GPS1_RAW, &raw, size);
+    break;
+  }
+  }
+
+  // the sequence advances even if the host was too slow, so the subscriber sees the gap
+  sent_[stream].push_back(ok ? now_ns : 0);
+}
+
+bool UinsSimulator::send(uint32_t did, const void* data, uint32_t size)
+{
+  int n = is_comm_data(&tx_, did, 0, size, const_cast<void*>(data));
+  if (n <= 0)
+    return false;
+
+  // a partial packet would corrupt the stream, so wait (briefly) for room for all of it
+  const uint8_t* p = tx_.buf.start;
+  int remaining = n;
+  while (remaining > 0)
+  {
+    ssize_t w = write(master_, p, remaining);
+    if (w > 0)
+    {
+      p += w;
+      remaining -= (int)w;
+      continue;
+    }
+    if (w < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+      break;
+    struct pollfd pfd;
+    pfd.fd = master_;
+    pfd.events = POLLOUT;
+    pfd.revents = 0;
+    if (poll(&pfd, 1, remaining == n ? 0 : 100) <= 0)
+      break;
+  }
+
+  if (remaining == n)
+  {
+    write_drops_++;
+    return false;
+  }
+  return remaining == 0;
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "InertialSense.h"
+
+/**
+ * @brief Pseudo-terminal stand-in for a uINS
+ * Emits framed Inertial Sense binary packets (DID_DUAL_IMU, DID_INS_1/2, DID_GPS1_POS/VEL and
+ * DID_GPS1_RAW observations and GPS/GLONASS ephemerides) at configurable rates, and answers
+ * what the driver sends while it starts: DID_DEV_INFO / DID_FLASH_CONFIG requests, flash config
+ * writes, and broadcast start / stop requests.
+ *
+ * Each tagged packet carries its sequence number in a field that passes unchanged into the
+ * published message, so a subscriber can match a message to the time its packet was written:
+ *   DID_DUAL_IMU   I[0].acc[0]   -> imu.linear_acceleration.x
+ *   DID_INS_2      uvw[0]        -> ins.twist.twist.linear.x
+ *   DID_GPS1_POS   hAcc          -> gps.hAcc
+ *   DID_GPS1_RAW   time.time / toe.time - SIM_GTIME_BASE  -> gps/obs time.time, gps/eph, gps/geph toe.time
+ */
+class UinsSimulator
+{
+public:
+  enum
+  {
+    SIM_DUAL_IMU,
+    SIM_INS_1,
+    SIM_INS_2,
+    SIM_GPS1_POS,
+    SIM_GPS1_VEL,
+    SIM_GPS1_OBS,
+    SIM_GPS1_EPH,   // alternates GPS and GLONASS ephemerides
+    SIM_COUNT
+  };
+
+  static const int64_t SIM_GTIME_BASE = 1500000000;
+
+  typedef struct
+  {
+    double rate[SIM_COUNT];  // Hz, before the host's period multiple is applied.  0 disables
+    int obs_per_epoch;       // observations per DID_GPS1_RAW epoch, in as many packets as they take
+    bool always_stream;      // stream everything without waiting for the host to request it
+  } config_t;
+
+  static config_t default_config();
+
+  explicit UinsSimulator(const config_t& config);
+  ~UinsSimulator();
+
+  /**
+   * @brief create the pseudo-terminal
+   * @param link optional path of a symlink to the slave side (e.g. /tmp/ttyUINS)
+   */
+  bool open(const std::string& link = "");
+  const std::string& port() const { return port_; }
+  /// the configuration in effect (obs_per_epoch limited to what satellite numbers allow)
+  const config_t& config() const { return config_; }
+
+  /// start / resume streaming and answering the host.  Device time continues across stop() / start()
+  void start();
+  /// go silent with the port still open, like a hung uINS
+  void stop();
+
+  /**
+   * @brief pull the plug: stop and close the pty, so the host's port hangs up and its name is gone
+   * replug() creates a new pty behind the same link (open() must have been given one) and starts
+   * again.  power_cycled forgets the broadcasts the host requested, as a uINS losing power would.
+   */
+  void unplug();
+  bool replug(bool power_cycled);
+
+  /// CLOCK_MONOTONIC write time (ns) of each packet of a stream, indexed by sequence. Read after stop()
+  const std::vector<uint64_t>& sent(int stream) const { return sent_[stream]; }
+
+  uint64_t requests() const { return requests_; }      // commands / writes received from the host
+  uint64_t write_drops() const { return write_drops_; } // packets the host was too slow to take
+
+  /// CPU time (s) used by the simulator thread so far, so benchmarks can leave it out.  0 when stopped
+  double cpu_seconds() const;
+
+private:
+  void run();
+  void handle_host_input();
+  void emit(int stream, uint64_t now_ns);
+  bool send(uint32_t did, const void* data, uint32_t size);
+
+  config_t config_;
+  std::string port_;
+  std::string link_;
+  int master_;
+  std::thread thread_;
+  clockid_t cpu_clock_;
+  std::atomic<bool> running_;
+
+  uint32_t multiple_[SIM_COUNT];  // host requested period multiple, 0 while not requested
+  uint64_t next_ns_[SIM_COUNT];
+  std::vector<uint64_t> sent_[SIM_COUNT];
+  uint64_t start_ns_;
+
+  dev_info_t dev_info_;
+  nvm_flash_cfg_t flash_;
+  sys_params_t sys_params_;   // navPeriodMs takes the flash startupNavDtMs on a reset
+
+  is_comm_instance_t tx_;
+  is_comm_instance_t rx_;
+  uint8_t tx_buffer_[4096];
+  uint8_t rx_buffer_[4096];
+
+  std::atomic<uint64_t> requests_;
+  std::atomic<uint64_t> write_drops_;
+};
@@ -0,0 +1,80 @@
+/**
+ * Standalone uINS simulator: creates a pseudo-terminal that behaves like a uINS, for running
+ * inertial_sense_node (or anything else) without hardware.
+ *
+ * usage: uins_simulator [--link PATH] [--imu HZ] [--ins HZ] [--gps HZ] [--obs HZ] [--sats N] [--eph HZ] [--always]
+ *   e.g. uins_simulator --link /tmp/ttyUINS --imu 1000 &
+ *        rosrun inertial_sense inertial_sense_node _port:=/tmp/ttyUINS
+ */
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "uins_simulator.h"
+
+static volatile sig_atomic_t s_stop = 0;
+static void on_signal(int) { s_stop = 1; }
+
+int main(int argc, char** argv)
+{
+  UinsSimulator::config_t config = UinsSimulator::default_config();
+  std::string link;
+
+  for (int i = 1; i < argc; i++)
+  {
+    const char* arg = argv[i];
+    const char* value = (i + 1 < argc) ? argv[i + 1] : NULL;
+    if (strcmp(arg, "--always") == 0)
+    {
+      config.always_stream = true;
+      continue;
+    }
+    if (value == NULL)
+    {
+      fprintf(stderr, "missing value for %s\n", arg);
+      return 1;
+    }
+    i++;
+    if (strcmp(arg, "--link") == 0)
+      link = value;
+    else if (strcmp(arg, "--imu") == 0)
+      config.rate[UinsSimulator::SIM_DUAL_IMU] = atof(value);
+    else if (strcmp(arg, "--ins") == 0)
+      config.rate[UinsSimulator::SIM_INS_1] = config.rate[UinsSimulator::SIM_INS_2] = atof(value);
+    else if (strcmp(arg, "--gps") == 0)
+      config.rate[UinsSimulator::SIM_GPS1_POS] = config.rate[UinsSimulator::SIM_GPS1_VEL] = atof(value);
+    else if (strcmp(arg, "--obs") == 0)
+      config.rate[UinsSimulator::SIM_GPS1_OBS] = atof(value);
+    else if (strcmp(arg, "--sats") == 0)
+      config.obs_per_epoch = atoi(value);
+    else if (strcmp(arg, "--eph") == 0)
+      config.rate[UinsSimulator::SIM_GPS1_EPH] = atof(value);
+    else
+    {
+      fprintf(stderr, "unknown option %s\n", arg);
+      return 1;
+    }
+  }
+
+  UinsSimulator sim(config);
+  if (!sim.open(link))
+  {
+    fprintf(stderr, "unable to create pty\n");
+    return 1;
+  }
+  printf("uINS simulator on %s%s%s\n", sim.port().c_str(), link.empty() ? "" : " -> ", link.c_str());
+  fflush(stdout);
+
+  signal(SIGINT, on_signal);
+  signal(SIGTERM, on_signal);
+  sim.start();
+  while (!s_stop)
+    pause();
+  sim.stop();
+
+  printf("host requests: %lu, packets dropped by a slow host: %lu\n",
+         (unsigned long)sim.requests(), (unsigned long)sim.write_drops());
+  return 0;
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+/**
+ * @brief Maps a device clock to host time from the times its data arrives
+ * Arrival time = device time (scaled by the clock skew) + offset + transport latency, and the
+ * latency is never negative.  So instead of averaging (which latency spikes bias), the minimum
+ * host - device difference is kept for every bin_s of device time, and a line is fit through the
+ * lower half of those minima (the lower envelope): its slope is the skew, its intercept the
+ * offset.  Until there are enough bins to fit a skew, the running minimum is used with the
+ * seeded skew (0 if not seeded).
+ * A sample arriving earlier than the envelope allows, or device time going backwards (reboot),
+ * means the relation changed and the estimator starts over.
+ * update() is O(1); refitting runs once per bin over at most `bins` points and never allocates.
+ */
+class ClockSkewEstimator
+{
+public:
+  explicit ClockSkewEstimator(double bin_s = 1.0, int bins = 64);
+
+  /// forget everything except the seeded skew
+  void reset();
+
+  /**
+   * @brief add a sample
+   * @param device_s device time stamp of the data (s)
+   * @param host_s host time it arrived (s)
+   * @return host time of device_s
+   */
+  double update(double device_s, double host_s);
+
+  bool valid() const { return valid_; }
+  /// host time of device time device_s, valid() must be true
+  double to_host(double device_s) const;
+  /// host seconds per device second - 1
+  double skew() const { return skew_; }
+  /// latest device time seen, valid() must be true
+  double last_device_time() const { return x0_ + last_x_; }
+  int bins_used() const { return (int)count_; }
+  uint32_t resets() const { return resets_; }
+
+  /**
+   * @brief start from a previous estimate (e.g. from before a restart)
+   * The skew is kept until there is enough data to fit; the line (device_s -> host_s) only if the
+   * first sample agrees with it, i.e. the device hasn't rebooted in between.
+   */
+  void seed(double device_s, double host_s, double skew);
+
+  // How far samples arrive above the envelope since reset_residuals(): mean (latency bias) and
+  // standard deviation (jitter), in seconds
+  double residual_mean() const { return residual_count_ ? residual_mean_ : 0.0; }
+  double residual_stddev() const;
+  uint64_t residual_count() const { return residual_count_; }
+  void reset_residuals();
+
+  /// samples this much earlier than the envelope mean the clocks were stepped
+  static constexpr double CAUSALITY_TOLERANCE_S = 0.05;
+  /// a seeded line is only trusted if the first sample arrives within this of it
+  static constexpr double SEED_TOLERANCE_S = 0.5;
+
+private:
+  typedef struct
+  {
+    double x;  // device time, relative to x0_
+    double y;  // minimum host - device, relative to y0_
+  } point_t;
+
+  void close_bin();
+  void fit();
+
+  double bin_s_;
+  std::vector<point_t> bins_;     // ring of completed bin minima
+  std::vector<double> fit_x_, fit_y_, fit_r_, fit_sorted_;  // fit workspace
+  size_t head_;
+  size_t count_;
+
+  bool valid_;
+  double x0_, y0_;                // origin of the relative coordinates
+  double last_x_;
+  int64_t bin_index_;
+  point_t bin_min_;               // minimum of the bin being filled
+
+  // host - device = y0_ + a_ + skew_ * (device - x0_ - xm_)
+  double a_, xm_, skew_;
+  double seed_skew_;
+  bool seeded_line_;
+  double seed_x_, seed_y_;        // absolute device time / host - device of the seeded line
+
+  uint32_t resets_;
+  uint64_t residual_count_;
+  double residual_mean_, residual_m2_;
+};
+
+/**
+ * @brief Hands time stamps over from a clock estimate to GPS time without a jump
+ * The difference between the two at the first GPS time stamp is carried as a correction that
+ * shrinks by slew_rate seconds per second of GPS time, so stamps stay monotonic.  Differences
+ * over max_slew_s aren't worth slewing away and are stepped instead.
+ */
+class TimeHandover
+{
+public:
+  explicit TimeHandover(double slew_rate = 0.01, double max_slew_s = 1.0);
+
+  /**
+   * @param gps_s GPS derived time of a sample
+   * @param estimate_s the clock estimate's time for the same sample
+   * @return correction (s) to add to gps_s
+   */
+  double correction(double gps_s, double estimate_s);
+  double current() const { return correction_; }
+  bool started() const { return started_; }
+
+private:
+  double slew_rate_;
+  double max_slew_s_;
+  bool started_;
+  double correction_;
+  double last_gps_s_;
+};
+
+// Persisted estimate of a device's clock: its skew, and host time of one boot time stamp
+typedef struct
+{
+  double skew;
+  double device_s;
+  double host_s;
+} clock_sync_state_t;
+
+bool clock_sync_load(const std::string& path, clock_sync_state_t& state);
+bool clock_sync_save(const std::string& path, const clock_sync_state_t& state);
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <chrono>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "ISComm.h"
+
+/**
+ * @brief Asynchronous commands to a uINS, completed by the data set it answers with
+ * Any thread can submit() a command and wait on the returned future.  The thread that owns the
+ * connection (the one calling IS_.Update()) runs the command's write in service(), feeds every
+ * data set it receives through on_data(), and the command completes when one of them matches,
+ * e.g. the flash configuration echoed back after a write.  Unanswered commands are written again
+ * every retry_s and fail after timeout_s, so a service waiting on one never stalls the stream.
+ */
+class CommandEngine
+{
+public:
+  typedef std::function<void()> write_t;
+  typedef std::function<bool(const p_data_t*)> match_t;
+
+  typedef struct
+  {
+    write_t write;      // runs on the connection's thread, may be called again to retry
+    uint32_t did;       // data set that answers it, ignored without match
+    match_t match;      // NULL: done once written
+    double timeout_s;
+    double retry_s;     // 0: write once
+  } command_t;
+
+  typedef struct
+  {
+    bool success;
+    int attempts;                 // times the command was written
+    double elapsed_s;             // from submit() to completion
+    p_data_hdr_t hdr;             // header and payload of the matching data set
+    std::vector<uint8_t> data;
+  } result_t;
+
+  /// @param wake called by submit() so the connection's thread runs service() soon
+  explicit CommandEngine(std::function<void()> wake = std::function<void()>());
+
+  /// thread safe
+  std::future<result_t> submit(const command_t& command);
+
+  /// connection thread: write new commands, retry and expire pending ones
+  void service();
+  /// connection thread: complete the pending commands data answers
+  void on_data(const p_data_t* data);
+  /// connection thread: whether on_data() has anything to match data sets of did against
+  bool waiting_for(uint32_t did) const { return did < waiting_.size() && waiting_[did] > 0; }
+  /// ms until service() has to run again, -1 if nothing is pending
+  int next_timeout_ms() const;
+  /// fail everything pending, e.g. when the port closes
+  void cancel_all();
+
+private:
+  typedef std::chrono::steady_clock steady_t;
+
+  typedef struct
+  {
+    command_t command;
+    std::promise<result_t> promise;
+    steady_t::time_point submitted;
+    steady_t::time_point deadline;
+    steady_t::time_point next_write;
+    int attempts;
+  } pending_t;
+
+  void take_submitted();
+  void complete(pending_t& pending, const p_data_t* data, bool success);
+
+  std::function<void()> wake_;
+  mutable std::mutex mutex_;
+  std::list<std::unique_ptr<pending_t>> submitted_;  // guarded by mutex_, not written yet
+  std::list<std::unique_ptr<pending_t>> pending_;    // connection thread only
+  std::vector<int> waiting_;                         // pending commands per DID
+};
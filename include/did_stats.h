@@ -0,0 +1,153 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+/**
+ * @brief Fixed-bucket log-linear histogram of durations in nanoseconds
+ * Four buckets per power of two (<= 19% bucket width) from 64 ns up to ~17 s; values outside
+ * that land in the first / last bucket.  add() is a handful of integer operations and never
+ * allocates, so it can sit on the decode path at any rate.
+ */
+class DurationHistogram
+{
+public:
+  enum
+  {
+    SUB_BUCKET_BITS = 2,
+    MIN_SHIFT = 6,   // first bucket starts at 2^6 ns
+    OCTAVES = 28,
+    BUCKETS = OCTAVES << SUB_BUCKET_BITS
+  };
+
+  DurationHistogram() { reset(); }
+
+  void reset()
+  {
+    memset(buckets, 0, sizeof(buckets));
+    count = 0;
+    sum_ns = 0;
+    max_ns = 0;
+  }
+
+  void add(uint64_t ns)
+  {
+    buckets[bucket(ns)]++;
+    count++;
+    sum_ns += ns;
+    if (ns > max_ns)
+      max_ns = ns;
+  }
+
+  static int bucket(uint64_t ns)
+  {
+    if (ns < (1ull << MIN_SHIFT))
+      return 0;
+    int msb = 63 - __builtin_clzll(ns);
+    int sub = (int)(ns >> (msb - SUB_BUCKET_BITS)) & ((1 << SUB_BUCKET_BITS) - 1);
+    int index = ((msb - MIN_SHIFT) << SUB_BUCKET_BITS) + sub;
+    return index < BUCKETS ? index : BUCKETS - 1;
+  }
+
+  static uint64_t bucket_lower_bound(int index)
+  {
+    int octave = index >> SUB_BUCKET_BITS;
+    uint64_t sub = index & ((1 << SUB_BUCKET_BITS) - 1);
+    return ((1ull << SUB_BUCKET_BITS) + sub) << (octave + MIN_SHIFT - SUB_BUCKET_BITS);
+  }
+
+  /// upper bound (ns) of the bucket holding the p-th quantile, 0 if empty
+  uint64_t percentile(double p) const
+  {
+    if (count == 0)
+      return 0;
+    uint64_t target = (uint64_t)ceil(p * count);
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKETS; i++)
+    {
+      seen += buckets[i];
+      if (seen >= target && buckets[i] > 0)
+        return i + 1 < BUCKETS ? bucket_lower_bound(i + 1) : max_ns;
+    }
+    return max_ns;
+  }
+
+  double mean_ns() const { return count ? (double)sum_ns / count : 0.0; }
+
+  uint32_t buckets[BUCKETS];
+  uint64_t count;
+  uint64_t sum_ns;
+  uint64_t max_ns;
+};
+
+/**
+ * @brief Hot-path statistics for one DID: arrival rate and jitter, and time spent converting
+ * the data set and publishing the result
+ */
+class DidStats
+{
+public:
+  DidStats() { reset(); }
+
+  void reset()
+  {
+    interval.reset();
+    convert.reset();
+    publish.reset();
+    count = 0;
+    first_arrival_ns = last_arrival_ns = 0;
+    interval_mean_s = interval_m2 = 0.0;
+  }
+
+  void record(uint64_t arrival_ns, uint64_t convert_ns, uint64_t publish_ns)
+  {
+    record_arrival(arrival_ns);
+    convert.add(convert_ns);
+    if (publish_ns)
+      publish.add(publish_ns);
+  }
+
+  /// a data set that arrived but wasn't converted (e.g. dropped by host-side decimation)
+  void record_arrival(uint64_t arrival_ns)
+  {
+    if (count == 0)
+      first_arrival_ns = arrival_ns;
+    else if (arrival_ns >= last_arrival_ns)
+    {
+      // Welford running variance of the inter-arrival time - its standard deviation is the jitter
+      uint64_t dt_ns = arrival_ns - last_arrival_ns;
+      interval.add(dt_ns);
+      double dt = dt_ns * 1e-9;
+      double delta = dt - interval_mean_s;
+      interval_mean_s += delta / interval.count;
+      interval_m2 += delta * (dt - interval_mean_s);
+    }
+    last_arrival_ns = arrival_ns;
+    count++;
+  }
+
+  double rate_hz() const
+  {
+    return (count > 1 && last_arrival_ns > first_arrival_ns) ? (count - 1) / ((last_arrival_ns - first_arrival_ns) * 1e-9) : 0.0;
+  }
+
+  double jitter_s() const { return interval.count > 1 ? sqrt(interval_m2 / (interval.count - 1)) : 0.0; }
+
+  DurationHistogram interval;  // time between consecutive arrivals
+  DurationHistogram convert;   // callback time excluding publish()
+  DurationHistogram publish;   // time inside publish(), only for data sets that published something
+  uint64_t count;
+  uint64_t first_arrival_ns;
+  uint64_t last_arrival_ns;
+  double interval_mean_s;
+  double interval_m2;
+};
+
+inline uint64_t did_stats_now_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
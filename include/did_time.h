@@ -0,0 +1,129 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "data_sets.h"
+#include "ISComm.h"
+
+/**
+ * @brief did_time_of_week
+ * Time of a uINS data set on the GPS time-of-week axis, in seconds.
+ * @param data - data set as received from the uINS or read from a log
+ * @param tow_offset - offset from uINS boot time to GPS time of week (gps_pos_t::towOffset),
+ *                     used for data sets stamped with time since boot.  0 if not known yet.
+ * @param tow - result
+ * @return false if the data set carries no usable time (unknown DID, partial data set, or a
+ *         boot-time stamp while tow_offset is unknown)
+ */
+inline bool did_time_of_week(const p_data_t* data, double tow_offset, double& tow)
+{
+#define DID_TIME_FIELD_PRESENT(__type, __field) \
+  (data->hdr.offset == 0 && data->hdr.size >= offsetof(__type, __field) + sizeof(((__type*)0)->__field))
+#define DID_TIME_AS(__type) (reinterpret_cast<const __type*>(data->buf))
+
+  switch (data->hdr.id)
+  {
+  case DID_INS_1:
+    if (!DID_TIME_FIELD_PRESENT(ins_1_t, timeOfWeek)) return false;
+    tow = DID_TIME_AS(ins_1_t)->timeOfWeek;
+    return true;
+  case DID_INS_2:
+    if (!DID_TIME_FIELD_PRESENT(ins_2_t, timeOfWeek)) return false;
+    tow = DID_TIME_AS(ins_2_t)->timeOfWeek;
+    return true;
+  case DID_INL2_STATES:
+    if (!DID_TIME_FIELD_PRESENT(inl2_states_t, timeOfWeek)) return false;
+    tow = DID_TIME_AS(inl2_states_t)->timeOfWeek;
+    return true;
+
+  case DID_GPS1_POS:
+  case DID_GPS2_POS:
+    if (!DID_TIME_FIELD_PRESENT(gps_pos_t, timeOfWeekMs)) return false;
+    tow = DID_TIME_AS(gps_pos_t)->timeOfWeekMs * 1e-3;
+    return true;
+  case DID_GPS1_VEL:
+  case DID_GPS2_VEL:
+    if (!DID_TIME_FIELD_PRESENT(gps_vel_t, timeOfWeekMs)) return false;
+    tow = DID_TIME_AS(gps_vel_t)->timeOfWeekMs * 1e-3;
+    return true;
+  case DID_GPS1_SAT:
+    if (!DID_TIME_FIELD_PRESENT(gps_sat_t, timeOfWeekMs)) return false;
+    tow = DID_TIME_AS(gps_sat_t)->timeOfWeekMs * 1e-3;
+    return true;
+  case DID_GPS1_RTK_POS_MISC:
+  case DID_GPS2_RTK_CMP_MISC:
+    if (!DID_TIME_FIELD_PRESENT(gps_rtk_misc_t, timeOfWeekMs)) return false;
+    tow = DID_TIME_AS(gps_rtk_misc_t)->timeOfWeekMs * 1e-3;
+    return true;
+  case DID_GPS1_RTK_POS_REL:
+  case DID_GPS2_RTK_CMP_REL:
+    if (!DID_TIME_FIELD_PRESENT(gps_rtk_rel_t, timeOfWeekMs)) return false;
+    tow = DID_TIME_AS(gps_rtk_rel_t)->timeOfWeekMs * 1e-3;
+    return true;
+  case DID_STROBE_IN_TIME:
+    if (!DID_TIME_FIELD_PRESENT(strobe_in_time_t, timeOfWeekMs)) return false;
+    tow = DID_TIME_AS(strobe_in_time_t)->timeOfWeekMs * 1e-3;
+    return true;
+
+  // stamped with time since boot
+  case DID_DUAL_IMU:
+    if (tow_offset == 0.0 || !DID_TIME_FIELD_PRESENT(dual_imu_t, time)) return false;
+    tow = DID_TIME_AS(dual_imu_t)->time + tow_offset;
+    return true;
+  case DID_PREINTEGRATED_IMU:
+    if (tow_offset == 0.0 || !DID_TIME_FIELD_PRESENT(preintegrated_imu_t, time)) return false;
+    tow = DID_TIME_AS(preintegrated_imu_t)->time + tow_offset;
+    return true;
+  case DID_MAGNETOMETER_1:
+    if (tow_offset == 0.0 || !DID_TIME_FIELD_PRESENT(magnetometer_t, time)) return false;
+    tow = DID_TIME_AS(magnetometer_t)->time + tow_offset;
+    return true;
+  case DID_BAROMETER:
+    if (tow_offset == 0.0 || !DID_TIME_FIELD_PRESENT(barometer_t, time)) return false;
+    tow = DID_TIME_AS(barometer_t)->time + tow_offset;
+    return true;
+
+  default:
+    return false;
+  }
+
+#undef DID_TIME_FIELD_PRESENT
+#undef DID_TIME_AS
+}
+
+/**
+ * @brief Keeps a stream of data sets on a monotonic time-of-week axis
+ * Learns the boot-to-GPS offset from DID_GPS1_POS, and data sets without a usable time inherit
+ * the time of the data set before them, so the stream never goes backwards because of them.
+ */
+class DidTimeTracker
+{
+public:
+  DidTimeTracker() : tow_offset_(0.0), last_tow_(-1.0) {}
+
+  /// time of week for data (seconds), or -1 if nothing timed has been seen yet
+  double update(const p_data_t* data)
+  {
+    if (data->hdr.id == DID_GPS1_POS && data->hdr.offset == 0 && data->hdr.size >= sizeof(gps_pos_t))
+      tow_offset_ = reinterpret_cast<const gps_pos_t*>(data->buf)->towOffset;
+
+    double tow;
+    if (did_time_of_week(data, tow_offset_, tow))
+      last_tow_ = tow;
+    return last_tow_;
+  }
+
+  double tow_offset() const { return tow_offset_; }
+  double last_tow() const { return last_tow_; }
+
+  /// pick up from a known point, e.g. when reading a log from the middle
+  void seed(double tow_offset, double tow)
+  {
+    tow_offset_ = tow_offset;
+    last_tow_ = tow;
+  }
+
+private:
+  double tow_offset_;
+  double last_tow_;
+};
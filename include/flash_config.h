@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "data_sets.h"
+
+// The uINS flash configuration fields the node sets from ROS parameters, and the diff that
+// lets it write only what changed
+
+/**
+ * @brief a field of nvm_flash_cfg_t set from the ROS parameter `param`
+ * count elements of element_size bytes at offset.  Parameters are doubles (or lists of them for
+ * count > 1), store() converts one to the field's element type.
+ */
+typedef struct
+{
+  const char* param;
+  uint32_t offset;
+  uint32_t count;
+  uint32_t element_size;
+  void (*store)(double value, uint8_t* dst);
+  double default_value;  // used for every element when the parameter isn't set
+} flash_field_t;
+
+extern const flash_field_t FLASH_FIELDS[];
+extern const size_t FLASH_FIELD_COUNT;
+
+typedef struct
+{
+  uint32_t offset;
+  uint32_t size;
+} flash_write_t;
+
+/**
+ * @brief byte ranges in which target differs from current
+ * Ranges less than max_gap equal bytes apart are joined: rewriting a few unchanged bytes costs
+ * less than the packet overhead of another write.  Ranges are widened to whole 32-bit words.
+ */
+std::vector<flash_write_t> flash_config_diff(const void* current, const void* target, size_t size, uint32_t max_gap);
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "data_sets.h"
+#include "inertial_sense/GNSSObservation.h"
+#include "inertial_sense/GNSSObsEpoch.h"
+
+// Conversions from uINS raw observations to the gps/obs (GNSSObsVec) and gps/obs_epoch
+// (GNSSObsEpoch) messages, shared by the driver and bench_obs_format
+
+inline void gnss_obs_to_msg(const obsd_t& in, const ros::Time& stamp, inertial_sense::GNSSObservation& out)
+{
+  out.header.stamp = stamp;
+  out.time.time = in.time.time;
+  out.time.sec = in.time.sec;
+  out.sat = in.sat;
+  out.rcv = in.rcv;
+  out.SNR = in.SNR[0];
+  out.LLI = in.LLI[0];
+  out.code = in.code[0];
+  out.qualL = in.qualL[0];
+  out.qualP = in.qualP[0];
+  out.L = in.L[0];
+  out.P = in.P[0];
+  out.D = in.D[0];
+}
+
+inline void gnss_obs_epoch_reserve(inertial_sense::GNSSObsEpoch& epoch, size_t n)
+{
+  epoch.sat.reserve(n);
+  epoch.rcv.reserve(n);
+  epoch.SNR.reserve(n);
+  epoch.LLI.reserve(n);
+  epoch.code.reserve(n);
+  epoch.qualL.reserve(n);
+  epoch.qualP.reserve(n);
+  epoch.L.reserve(n);
+  epoch.P.reserve(n);
+  epoch.D.reserve(n);
+}
+
+/// clear the arrays, keeping their storage
+inline void gnss_obs_epoch_clear(inertial_sense::GNSSObsEpoch& epoch)
+{
+  epoch.sat.clear();
+  epoch.rcv.clear();
+  epoch.SNR.clear();
+  epoch.LLI.clear();
+  epoch.code.clear();
+  epoch.qualL.clear();
+  epoch.qualP.clear();
+  epoch.L.clear();
+  epoch.P.clear();
+  epoch.D.clear();
+}
+
+inline void gnss_obs_epoch_append(const obsd_t& in, inertial_sense::GNSSObsEpoch& epoch)
+{
+  epoch.sat.push_back(in.sat);
+  epoch.rcv.push_back(in.rcv);
+  epoch.SNR.push_back(in.SNR[0]);
+  epoch.LLI.push_back(in.LLI[0]);
+  epoch.code.push_back(in.code[0]);
+  epoch.qualL.push_back(in.qualL[0]);
+  epoch.qualP.push_back(in.qualP[0]);
+  epoch.L.push_back(in.L[0]);
+  epoch.P.push_back(in.P[0]);
+  epoch.D.push_back(in.D[0]);
+}
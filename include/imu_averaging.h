@@ -0,0 +1,85 @@
+#pragma once
+
+#include <string.h>
+
+#include "data_sets.h"
+
+/**
+ * @brief Host-side boxcar average of dual_imu_t
+ * Every `factor` samples are averaged into one, stamped with the mean sample time (the middle
+ * of the window), so a stream sampled at 1 kHz can be published at e.g. 200 Hz without the
+ * aliasing plain decimation would add.  Fields other than time and I[] come from the last sample.
+ */
+class DualImuAverager
+{
+public:
+  DualImuAverager() : factor_(1) { reset(); }
+
+  void set_factor(int factor)
+  {
+    factor_ = factor > 1 ? factor : 1;
+    reset();
+  }
+
+  int factor() const { return factor_; }
+
+  void reset()
+  {
+    count_ = 0;
+    time_sum_ = 0.0;
+    memset(sum_, 0, sizeof(sum_));
+  }
+
+  /// @return the averaged sample once every factor() calls, NULL otherwise (valid until the next call)
+  const dual_imu_t* add(const dual_imu_t& sample)
+  {
+    time_sum_ += sample.time;
+    for (int i = 0; i < IMU_COUNT; i++)
+    {
+      for (int j = 0; j < 3; j++)
+      {
+        sum_[i][j] += sample.I[i].pqr[j];
+        sum_[i][3 + j] += sample.I[i].acc[j];
+      }
+    }
+    if (++count_ < factor_)
+      return NULL;
+
+    average_ = sample;
+    average_.time = time_sum_ / count_;
+    for (int i = 0; i < IMU_COUNT; i++)
+    {
+      for (int j = 0; j < 3; j++)
+      {
+        average_.I[i].pqr[j] = (float)(sum_[i][j] / count_);
+        average_.I[i].acc[j] = (float)(sum_[i][3 + j] / count_);
+      }
+    }
+    reset();
+    return &average_;
+  }
+
+private:
+  enum { IMU_COUNT = sizeof(((dual_imu_t*)0)->I) / sizeof(((dual_imu_t*)0)->I[0]) };
+
+  int factor_;
+  int count_;
+  double time_sum_;
+  double sum_[IMU_COUNT][6];  // pqr, acc
+  dual_imu_t average_;
+};
+
+/**
+ * @brief Weighted blend of the two IMUs of a dual_imu_t: out = w * I[0] + (1 - w) * I[1]
+ * (w = 0.5 is the plain average).  Fixed trip-count loops, so this compiles to a few
+ * straight-line vector multiply-adds.
+ */
+inline void dual_imu_blend(const dual_imu_t& in, float w, imus_t& out)
+{
+  const float w2 = 1.0f - w;
+  for (int j = 0; j < 3; j++)
+  {
+    out.pqr[j] = w * in.I[0].pqr[j] + w2 * in.I[1].pqr[j];
+    out.acc[j] = w * in.I[0].acc[j] + w2 * in.I[1].acc[j];
+  }
+}
@@ -5,8 +5,15 @@
 #include <algorithm>
 #include <string>
 #include <cstdlib>
+#include <memory>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <vector>
 
 #include "InertialSense.h"
+#include "serialPortExt.h"
+#include "ISDataMappings.h"
 
 #include "ros/ros.h"
 #include "ros/timer.h"
@@ -25,14 +32,29 @@
 #include "inertial_sense/GlonassEphemeris.h"
 #include "inertial_sense/GNSSObservation.h"
 #include "inertial_sense/GNSSObsVec.h"
+#include "inertial_sense/GNSSObsEpoch.h"
 #include "inertial_sense/INL2States.h"
+#include "inertial_sense/ImuBatch.h"
+#include "inertial_sense/DumpDidStats.h"
 #include "nav_msgs/Odometry.h"
 #include "std_srvs/Trigger.h"
 #include "std_msgs/Header.h"
 #include "geometry_msgs/Vector3Stamped.h"
 #include "geometry_msgs/PoseWithCovarianceStamped.h"
+#include "geometry_msgs/TransformStamped.h"
+#include "tf2_msgs/TFMessage.h"
 #include "diagnostic_msgs/DiagnosticArray.h"
-#include <tf/transform_broadcaster.h>
+#include <tf2_ros/transform_broadcaster.h>
+#include <tf2_ros/static_transform_broadcaster.h>
+#include "wakeable_callback_queue.h"
+#include "serial_pipeline.h"
+#include "did_stats.h"
+#include "gnss_obs_conversion.h"
+#include "imu_averaging.h"
+#include "clock_sync.h"
+#include "command_engine.h"
+#include "flash_config.h"
+#include "log_writer.h"
 //#include "geometry/xform.h"
 
 # define GPS_UNIX_OFFSET 315964800 // GPS time started on 6/1/1980 while UNIX time started 1/1/1970 this is the difference between those in seconds
@@ -40,12 +62,12 @@
 # define UNIX_TO_GPS_OFFSET (GPS_UNIX_OFFSET - LEAP_SECONDS)
 
 #define SET_CALLBACK(DID, __type, __cb_fun, __periodmultiple) \
-    IS_.BroadcastBinaryData(DID, __periodmultiple, \
-    [this](InertialSense*i, p_data_t* data, int pHandle)\
+    set_callback(DID, \
+    [this](const p_data_t* data)\
     { \
        /* ROS_INFO("Got message %d", DID);*/\
-       this->__cb_fun(reinterpret_cast<__type*>(data->buf));\
-    })
+       this->__cb_fun(reinterpret_cast<const __type*>(data->buf));\
+    }, __periodmultiple)
 
 
 class InertialSenseROS //: SerialListener
@@ -61,11 +83,256 @@ public:
     NMEA_SER1 = 0x02
   } NMEA_message_config_t;
       
-  InertialSenseROS();
+  /**
+   * @param connect_to_device false to only set up the ROS side (publishers, conversion) and feed
+   *        data in through dispatch(), e.g. when replaying logs
+   */
+  InertialSenseROS(const ros::NodeHandle& nh = ros::NodeHandle(), const ros::NodeHandle& nh_private = ros::NodeHandle("~"),
+                   bool connect_to_device = true);
+
+  // asks the owner of a shared connection to stream a DID from one device (period_multiple <= 0: stop it)
+  typedef std::function<void(uint32_t did, int period_multiple, int device)> broadcast_request_t;
+
+  /**
+   * @brief one of several uINS on a connection opened and updated by someone else (see InertialSenseHub)
+   * @param shared connection with all the ports open - the SDK supports one InertialSense per process
+   * @param device index (pHandle) of this uINS on the connection
+   * @param request_broadcast called instead of BroadcastBinaryData for every DID this device needs
+   * @param static_br /tf_static broadcaster shared by the devices of the connection (see publish_static_tf)
+   */
+  InertialSenseROS(const ros::NodeHandle& nh, const ros::NodeHandle& nh_private, InertialSense& shared, int device,
+                   broadcast_request_t request_broadcast,
+                   std::shared_ptr<tf2_ros::StaticTransformBroadcaster> static_br = nullptr);
+
+  // a topic as converted offline, enough to write its messages to a bag
+  typedef struct
+  {
+    std::string topic;       // resolved
+    std::string datatype;
+    std::string md5sum;
+    std::string definition;
+  } offline_topic_t;
+  typedef std::function<void(const offline_topic_t& topic, const ros::Time& stamp, const uint8_t* data, uint32_t size)> message_sink_t;
+
+  /**
+   * @brief convert data sets fed in through dispatch() without a ROS master, e.g. logs to a bag
+   * Nothing is advertised: every message that would be published is serialized and handed to
+   * `sink` instead, stamped as published (messages without a header get the last stamp).
+   * Parameters come from `params`, a struct laid out like the private namespace.  No services,
+   * static transforms or diagnostics, and timers aren't run.
+   */
+  InertialSenseROS(const ros::NodeHandle& nh, const XmlRpc::XmlRpcValue& params, message_sink_t sink);
+  ~InertialSenseROS();
   void callback(p_data_t* data);
   void update();
 
+  /**
+   * @brief spin
+   * Event-driven main loop.  Blocks until serial data arrives or a ROS callback (timer, service,
+   * subscription) is queued, then decodes / dispatches.  Returns when ros::ok() is false.
+   */
+  void spin();
+  /// make spin() return (thread safe)
+  void shutdown();
+  std::atomic<bool> shutdown_requested_{false};
+  int idle_timeout_ms_;
+  bool server_connection_open_ = false;
+
+  // Optional pipeline mode: a reader thread drains the port into a ring consumed by spin()
+  void start_pipeline();
+  std::unique_ptr<SerialPipeline> pipeline_;
+
+  // Connection recovery: a port error, or no data for stall_timeout_ while streams are requested,
+  // closes the port and spin() reopens it with capped exponential backoff.  Only the streams are
+  // requested again; publishers, time sync and the com manager (with the log) carry on as they were.
+  enum connection_state_t
+  {
+    CONNECTION_UP,
+    CONNECTION_DOWN,      // port closed, reopened at next_reconnect_ns_
+    CONNECTION_RECOVERING // reopened, waiting for the first data set
+  };
+  connection_state_t connection_state_ = CONNECTION_UP;
+  bool reconnect_enabled_;
+  double stall_timeout_;
+  double reconnect_backoff_min_, reconnect_backoff_max_;
+  double reconnect_backoff_;        // next wait between attempts
+  int reconnect_attempts_ = 0;      // port opens this outage
+  uint64_t last_rx_ns_ = 0;         // CLOCK_MONOTONIC of the last data set, or of the last stream request
+  uint64_t disconnected_ns_ = 0;
+  uint64_t next_reconnect_ns_ = 0;
+  uint32_t reconnects_ = 0;
+  double last_recovery_s_ = 0.0;    // link lost to first data set again
+  bool streams_expected() const;
+  void check_connection(bool port_error);
+  void connection_lost(const char* reason);
+  void try_reconnect();
+  int connection_timeout_ms() const;  // ms until check_connection() has something to do, -1: nothing
+  void connection_diagnostics(diagnostic_msgs::DiagnosticArray& diag_array);
+
+  // Every DID we handle is routed through did_callbacks_, whether it comes from the uINS or a log
+  typedef std::function<void(const p_data_t*)> did_callback_t;
+  did_callback_t did_callbacks_[DID_COUNT];
+  int broadcast_period_[DID_COUNT] = {};  // period_multiple asked for, to ask again after a reset
+  void set_callback(uint32_t did, did_callback_t callback, int period_multiple);
+  void dispatch(const p_data_t* data);
+
+  // Host-side decimation: only every decimation_[did]-th data set of a DID reaches its callback
+  int decimation_[DID_COUNT] = {};
+  int decimation_count_[DID_COUNT] = {};
+  void set_decimation(uint32_t did, int decimation);
+  int stream_period_multiple(const std::string& stream, int default_multiple);
+  int stream_decimation(const std::string& stream);
+  DualImuAverager imu_averager_;
+  bool device_connected_;
+
+  // Lazy streams: DIDs that only feed topics are stopped on the uINS while none of those topics
+  // has a subscriber, and requested again when the first one connects
+  typedef struct
+  {
+    uint32_t did;
+    int period_multiple;
+    std::vector<const ros::Publisher*> pubs;
+    bool required;  // needed internally even without subscribers
+  } lazy_did_t;
+  bool lazy_streams_;
+  std::vector<lazy_did_t> lazy_dids_;
+  bool did_paused_[DID_COUNT] = {};
+  ros::SubscriberStatusCallback lazy_status_cb_;
+  void add_lazy_did(uint32_t did, int period_multiple, const std::vector<const ros::Publisher*>& pubs, bool required = false);
+  void update_lazy_streams();
+  void set_broadcast_period(uint32_t did, int period_multiple);
+  template <typename M>
+  void advertise_lazy(ros::Publisher& pub, const std::string& topic, uint32_t queue_size)
+  {
+    if (offline_)
+      advertise_offline<M>(pub, topic);
+    else if (!lazy_streams_)
+      pub = nh_.advertise<M>(topic, queue_size);
+    else
+      pub = nh_.advertise<M>(topic, queue_size, lazy_status_cb_, lazy_status_cb_);
+  }
+  template <typename M>
+  void advertise(ros::Publisher& pub, const std::string& topic, uint32_t queue_size)
+  {
+    if (offline_)
+      advertise_offline<M>(pub, topic);
+    else
+      pub = nh_.advertise<M>(topic, queue_size);
+  }
+
+  // Per-DID arrival / conversion / publish statistics gathered in dispatch()
+  bool did_stats_enabled_;
+  std::unique_ptr<DidStats> did_stats_[DID_COUNT];
+  uint64_t publish_ns_; // time spent in publish() during the current dispatch
+  ros::ServiceServer did_stats_srv_;
+  bool dump_did_stats_srv_callback(inertial_sense::DumpDidStats::Request& req, inertial_sense::DumpDidStats::Response& res);
+  void did_stats_diagnostics(diagnostic_msgs::DiagnosticArray& diag_array);
+
+  // Every publish goes through here so its time can be told apart from conversion time
+  template <typename M>
+  void publish(const ros::Publisher& pub, const M& msg)
+  {
+    if (offline_)
+    {
+      publish_offline(pub, msg);
+      return;
+    }
+    if (!did_stats_enabled_)
+    {
+      pub.publish(msg);
+      return;
+    }
+    uint64_t start = did_stats_now_ns();
+    pub.publish(msg);
+    publish_ns_ += did_stats_now_ns() - start;
+  }
+
+  // Publish a copy of a message we keep updating between callbacks.  Publishing through a shared
+  // pointer lets intra-process (nodelet) subscribers receive it without serialization.
+  template <typename T>
+  void publish_copy(const ros::Publisher& pub, const T& msg)
+  {
+    publish(pub, boost::shared_ptr<const T>(new T(msg)));
+  }
+
+  // Offline conversion (see the offline constructor): publishers only stand for their topic, and
+  // what goes through publish() is serialized and handed to offline_sink_
+  bool offline_ = false;
+  XmlRpc::XmlRpcValue offline_params_;
+  message_sink_t offline_sink_;
+  std::map<const ros::Publisher*, offline_topic_t> offline_topics_;
+  ros::Time offline_stamp_;              // of the last message with a header, for those without
+  std::vector<uint8_t> offline_buffer_;
+  template <typename M>
+  void advertise_offline(const ros::Publisher& pub, const std::string& topic)
+  {
+    offline_topic_t& t = offline_topics_[&pub];
+    t.topic = nh_.resolveName(topic);
+    t.datatype = ros::message_traits::datatype<M>();
+    t.md5sum = ros::message_traits::md5sum<M>();
+    t.definition = ros::message_traits::definition<M>();
+  }
+  template <typename M>
+  void publish_offline(const ros::Publisher& pub, const M& msg)
+  {
+    std::map<const ros::Publisher*, offline_topic_t>::const_iterator it = offline_topics_.find(&pub);
+    if (it == offline_topics_.end())
+      return;
+    const ros::Time* stamp = ros::message_traits::timeStamp(msg);
+    if (stamp != NULL && !stamp->isZero())
+      offline_stamp_ = *stamp;
+    uint32_t size = ros::serialization::serializationLength(msg);
+    offline_buffer_.resize(size);
+    ros::serialization::OStream stream(offline_buffer_.data(), size);
+    ros::serialization::serialize(stream, msg);
+    offline_sink_(it->second, offline_stamp_, offline_buffer_.data(), size);
+  }
+  template <typename M>
+  void publish_offline(const ros::Publisher& pub, const boost::shared_ptr<M>& msg)
+  {
+    publish_offline(pub, *msg);
+  }
+
+  // Parameters come from the private namespace, or from offline_params_ when converting offline
+  template <typename T>
+  bool get_param(const std::string& name, T& value)
+  {
+    if (!offline_)
+      return nh_private_.getParam(name, value);
+    return offline_params_.hasMember(name) && from_xmlrpc(offline_params_[name], value);
+  }
+  template <typename T>
+  void param(const std::string& name, T& value, const T& default_value)
+  {
+    if (!get_param(name, value))
+      value = default_value;
+  }
+  static bool from_xmlrpc(XmlRpc::XmlRpcValue& xml, bool& value);
+  static bool from_xmlrpc(XmlRpc::XmlRpcValue& xml, int& value);
+  static bool from_xmlrpc(XmlRpc::XmlRpcValue& xml, double& value);
+  static bool from_xmlrpc(XmlRpc::XmlRpcValue& xml, std::string& value);
+  template <typename T>
+  static bool from_xmlrpc(XmlRpc::XmlRpcValue& xml, std::vector<T>& value)
+  {
+    if (xml.getType() != XmlRpc::XmlRpcValue::TypeArray)
+      return false;
+    std::vector<T> values(xml.size());
+    for (int i = 0; i < xml.size(); i++)
+    {
+      if (!from_xmlrpc(xml[i], values[i]))
+        return false;
+    }
+    value.swap(values);
+    return true;
+  }
+
+  void init();
   void connect();
+  void attach();
+  void send_data(uint32_t did, const void* data, uint32_t size, uint32_t offset);
+  int device_;              // pHandle of this uINS on the connection
+  bool shared_connection_;  // IS_ is owned (opened, updated) by someone else
+  broadcast_request_t request_broadcast_;
   void set_navigation_dt_ms();
   void configure_parameters();
   void configure_rtk();
@@ -73,16 +340,44 @@ public:
   void configure_ascii_output();
   void start_log();
   
-  template<typename T> void set_vector_flash_config(std::string param_name, uint32_t size, uint32_t offset);
-  template<typename T>  void set_flash_config(std::string param_name, uint32_t offset, T def) __attribute__ ((optimize(0)));
+
+  // Flash configuration: parameters are staged into flash_target_, a copy of the uINS's flash
+  // configuration, and flash_commit() writes only the bytes that differ
+  nvm_flash_cfg_t flash_target_;
+  bool flash_known_;                          // the SDK had the uINS's flash configuration to compare with
+  std::vector<flash_write_t> flash_staged_;   // everything staged, written as is when !flash_known_
+  void flash_stage(uint32_t offset, const void* data, uint32_t size);
+  void flash_commit();
   void get_flash_config();
   void reset_device();
   void flash_config_callback(const nvm_flash_cfg_t* const msg);
+
+  // A navigation rate change is applied by resetting the uINS.  begin_reset() waits for the rate to
+  // be in flash and sends the reset, finish_reset() waits (at most reset_timeout_) for the uINS to
+  // come back at the new rate and asks for the streams again; the ROS setup runs in between.  On a
+  // shared connection the hub calls them once it has all its devices.
+  uint32_t reset_nav_dt_ms_ = 0;  // rate to come back at, 0: no reset pending
+  double reset_timeout_;
+  bool reset_pending() const { return reset_nav_dt_ms_ != 0; }
+  void begin_reset();
+  bool finish_reset();
+  bool wait_for_device_ready();
+  void request_streams();
+  // decode what arrives within timeout_ms and service commands_, for waiting before spin() runs
+  void pump_connection(int timeout_ms);
+  bool run_command_now(const CommandEngine::command_t& command, CommandEngine::result_t& result);
   // Serial Port Configuration
   std::string port_;
   int baudrate_;
+  bool low_latency_serial_;
   bool initialized_;
   bool log_enabled_;
+  // log_type "raw": the bytes read from our port, written by log_writer_'s own thread (one per
+  // port, so also on a shared connection); "dat": the SDK's logger for the whole connection
+  std::string log_type_;
+  std::unique_ptr<LogWriter> log_writer_;
+  void obs_diagnostics(diagnostic_msgs::DiagnosticArray& diag_array);
+  void log_diagnostics(diagnostic_msgs::DiagnosticArray& diag_array);
 
   std::string frame_id_;
 
@@ -101,9 +396,16 @@ public:
 
   ros_stream_t INL2_states_;
   void INL2_states_callback(const inl2_states_t* const msg);
-  tf::TransformBroadcaster br;
+  // TF tf_parent_frame -> tf_child_frame from the INS, stamped with the INS time, at most tf_rate Hz
+  std::unique_ptr<tf2_ros::TransformBroadcaster> br_;  // not offline, it advertises /tf
+  std::shared_ptr<tf2_ros::StaticTransformBroadcaster> static_br_;  // created on first use unless a hub shares one
+  ros::Publisher tf_pub_;                               // offline /tf
+  void send_transform(const geometry_msgs::TransformStamped& transform);
   bool publishTf;
-  tf::Transform transform;
+  geometry_msgs::TransformStamped ins_tf_;  // frames set once, only the pose changes
+  ros::Duration tf_min_interval_;
+  void configure_tf();
+  void publish_static_tf();
   int LTCF;
   enum
   {
@@ -111,22 +413,68 @@ public:
     ENU
   }ltcf;
 
-  ros_stream_t IMU_;
+  ros_stream_t IMU_;            // pub: imu (IMU1), pub2: imu2
+  bool imu2_enabled_;
+  ros_stream_t IMU_combined_;   // imu_combined: blend of both IMUs
+  float imu_combined_weight_;   // weight of IMU1
+  // which IMU topics have subscribers (always true without lazy_streams), so only those are converted
+  bool imu1_subscribed_ = true;
+  bool imu2_subscribed_ = true;
+  bool imu_combined_subscribed_ = true;
+  bool imu_batch_subscribed_ = true;
   void IMU_callback(const dual_imu_t* const msg);
 
+  // imu_batch: IMU_batch_size samples per message, or fewer once the first is IMU_batch_deadline old
+  ros_stream_t IMU_batch_;
+  int imu_batch_size_;
+  inertial_sense::ImuBatch::Ptr imu_batch_;  // batch being filled, storage reserved up front
+  ros::Timer imu_batch_timer_;
+  void IMU_batch_reset();
+  void IMU_batch_append(const ros::Time& stamp, const dual_imu_t* const msg);
+  void IMU_batch_publish();
+  void IMU_batch_timer_callback(const ros::TimerEvent& e);
+
   ros_stream_t GPS_;
   ros_stream_t GPS_obs_;
   ros_stream_t GPS_eph_;
   void GPS_pos_callback(const gps_pos_t* const msg);
   void GPS_vel_callback(const gps_vel_t* const msg);
-  void GPS_raw_callback(const gps_raw_t* const msg);
-  void GPS_obs_callback(const obsd_t * const msg, int nObs);
+  void GPS_raw_callback(const gps_raw_t* const msg, int receiver);
+  void GPS_obs_callback(int receiver, const obsd_t * const msg, int nObs);
   void GPS_eph_callback(const eph_t* const msg);
   void GPS_geph_callback(const geph_t* const msg);
-  void GPS_obs_bundle_timer_callback(const ros::TimerEvent& e);
-  inertial_sense::GNSSObsVec obs_Vec_;
-  ros::Timer obs_bundle_timer_;
-  ros::Time last_obs_time_;
+  void GPS_obs_bundle_timer_callback(int receiver);
+
+  // Observations are bundled into one message per epoch, separately for each receiver
+  typedef enum
+  {
+    GNSS_RECEIVER_GPS1,
+    GNSS_RECEIVER_GPS2,
+    GNSS_RECEIVER_BASE,
+    GNSS_RECEIVER_COUNT
+  } gnss_receiver_t;
+  static const size_t MAX_OBS_PER_BUNDLE = 128;
+  typedef struct
+  {
+    inertial_sense::GNSSObsVec msg;     // gps/obs, obs has MAX_OBS_PER_BUNDLE reserved, it never grows past that
+    inertial_sense::GNSSObsEpoch epoch; // gps/obs_epoch, arrays reserved the same way
+    size_t count;                   // observations collected for this epoch, not published yet
+    size_t total;                   // observations received for this epoch
+    gtime_t time;                   // epoch being collected
+    bool started;                   // time is set
+    bool published;                 // a bundle of this epoch has gone out, later observations go in a follow-up
+    bool closed;                    // its end was seen (short packet or next epoch)
+    size_t expected;                // observations in the last epoch whose end was seen
+    uint64_t followups;             // bundles published after their epoch had already gone out
+    uint64_t dropped;               // observations that didn't fit in MAX_OBS_PER_BUNDLE
+    ros::Timer deadline;            // one-shot, for epochs whose end we can't detect
+  } obs_bundle_t;
+  obs_bundle_t obs_bundles_[GNSS_RECEIVER_COUNT];
+  void GPS_obs_bundle_publish(obs_bundle_t& bundle);
+  void GPS_obs_epoch_close(obs_bundle_t& bundle);
+  bool obs_vec_enabled_;            // publish gps/obs (GNSSObsVec)
+  bool obs_epoch_enabled_;          // publish gps/obs_epoch (GNSSObsEpoch)
+  ros::Publisher obs_epoch_pub_;
 
   ros_stream_t GPS_info_;
   void GPS_info_callback(const gps_sat_t* const msg);
@@ -159,6 +507,17 @@ public:
   bool perform_multi_mag_cal_srv_callback(std_srvs::Trigger::Request & req, std_srvs::Trigger::Response & res);
   bool update_firmware_srv_callback(inertial_sense::FirmwareUpdate::Request & req, inertial_sense::FirmwareUpdate::Response & res);
 
+  // Services that wait for the uINS to answer run on their own thread and submit their writes to
+  // commands_, which the connection's thread services and matches against incoming data sets
+  // (see dispatch()), so streaming goes on while they wait
+  ros::CallbackQueue service_queue_;
+  std::unique_ptr<ros::AsyncSpinner> service_spinner_;
+  CommandEngine commands_{[this]() { callback_queue_.notify(); }};
+  void service_commands();
+  bool run_command(const CommandEngine::command_t& command, CommandEngine::result_t& result);
+  bool write_refLLA(const double* lla, std::string& message);
+  bool start_mag_cal(uint32_t recal_command, std::string& message);
+
   void publishGPS();
 
   typedef enum
@@ -204,23 +563,32 @@ public:
   double GPS_towOffset_ = 0; // The offset between GPS time-of-week and local time on the uINS
                              //  If this number is 0, then we have not yet got a fix
   uint64_t GPS_week_ = 0; // Week number to start of GPS_towOffset_ in GPS time
-  // Time sync variables
-  double INS_local_offset_ = 0.0; // Current estimate of the uINS start time in ROS time seconds
-  bool got_first_message_ = false; // Flag to capture first uINS start time guess
+  // Time sync without GPS: host time of uINS time stamps, estimated from when they arrive.  Each
+  // time base has its own estimate so they don't disturb each other
+  ClockSkewEstimator boot_clock_;  // time since boot (ros_time_from_start_time)
+  ClockSkewEstimator tow_clock_;   // GPS time of week before towOffset is known
+  TimeHandover gps_handover_;      // slews from the estimate to GPS time once there is a fix
+  std::string time_sync_file_;     // where boot_clock_ is kept across restarts, empty for nowhere
+  double host_arrival_time();
+  void load_time_sync();
+  void save_time_sync();
+  void time_sync_diagnostics(diagnostic_msgs::DiagnosticArray& diag_array);
 
   // Data to hold on to in between callbacks
   double lla_[3];
   double ecef_[3];
-  sensor_msgs::Imu imu1_msg, imu2_msg;
+  sensor_msgs::Imu imu1_msg, imu2_msg, imu_combined_msg;
   nav_msgs::Odometry odom_msg;
   inertial_sense::GPS gps_msg; 
   geometry_msgs::Vector3Stamped gps_velEcef;
   inertial_sense::GPSInfo gps_info_msg;
   inertial_sense::INL2States inl2_states_msg;
 
+  WakeableCallbackQueue callback_queue_; // must be declared before the node handles using it
   ros::NodeHandle nh_;
   ros::NodeHandle nh_private_;
 
-  // Connection to the uINS
-  InertialSense IS_;
+  // Connection to the uINS, either our own or shared with other devices
+  std::unique_ptr<InertialSense> owned_IS_;
+  InertialSense& IS_;
 };
\ No newline at end of file
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "inertial_sense.h"
+
+/**
+ * @brief Several uINS on separate ports driven from one process
+ * The SDK keeps its com manager state in globals, so all ports are opened on a single
+ * InertialSense connection and every device gets an InertialSenseROS bound to its index on it.
+ * Each device keeps its own namespace, frame_id, time-sync state and serial reader thread
+ * (pipeline mode), while decoding and callbacks share one spin() thread that sleeps until any
+ * port or device callback queue has work.
+ */
+class InertialSenseHub
+{
+public:
+  /**
+   * private parameters:
+   *   ports (list of serial ports), namespaces (one per port, default uins0, uins1, ...),
+   *   baudrate, low_latency_serial, enable_log - and per device <namespace>/... for everything
+   *   InertialSenseROS takes (frame_id defaults to <namespace>/body)
+   */
+  InertialSenseHub(const ros::NodeHandle& nh = ros::NodeHandle(), const ros::NodeHandle& nh_private = ros::NodeHandle("~"));
+  ~InertialSenseHub();
+
+  /// decode every port and run every device's callbacks until ros::ok() is false or shutdown()
+  void spin();
+  /// make spin() return (thread safe)
+  void shutdown();
+
+  size_t device_count() const { return devices_.size(); }
+  InertialSenseROS* device(size_t i) { return devices_[i].get(); }
+
+private:
+  void request_broadcast(uint32_t did, int period_multiple, int device);
+
+  ros::NodeHandle nh_;
+  ros::NodeHandle nh_private_;
+  int idle_timeout_ms_;
+  std::atomic<bool> shutdown_requested_{false};
+  WakeableCallbackQueue wake_;  // only used to interrupt spin()
+
+  InertialSense IS_;
+  std::vector<std::unique_ptr<InertialSenseROS>> devices_;  // indexed by pHandle
+  std::shared_ptr<tf2_ros::StaticTransformBroadcaster> static_br_;  // one /tf_static for all devices
+  std::vector<bool> handler_registered_;                     // per DID
+  std::vector<bool> requested_;                              // per device and DID
+};
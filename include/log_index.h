@@ -0,0 +1,175 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "ISComm.h"
+#include "did_time.h"
+
+/// where a packet of `did` timed `tow` starts in a raw log segment
+typedef struct
+{
+  double tow;          // GPS time of week (s), as DidTimeTracker assigns it
+  double tow_offset;   // boot-to-GPS offset known at that point, to time boot-stamped data read from here
+  uint64_t offset;     // file offset of the packet's start byte
+  uint32_t did;
+  uint32_t count;      // packets of did from here up to the next entry for did
+} log_index_entry_t;
+
+/// index sidecar of a raw log segment: LOG_SN30123_0000.raw -> LOG_SN30123_0000.idx
+std::string log_index_path(const std::string& log_path);
+
+/**
+ * @brief Builds the index of a raw log (see LogWriter) as its bytes go by
+ * Every DID gets an entry for its first packet, then for the first packet at least `interval`
+ * seconds of uINS time after its previous entry (or earlier in time, e.g. after a reset), so with
+ * 0.1 s a 5 Hz DID has every packet indexed and a 1 kHz one every 100th.  Packets before the
+ * first time stamped data set aren't indexed.
+ */
+class LogIndexer
+{
+public:
+  explicit LogIndexer(double interval = 0.1);
+
+  /// start over, for a new log
+  void reset();
+  /// start the next segment of the same log: offsets start over, time carries on
+  void next_segment();
+  /// carry on from the time at the end of the previous segment
+  void seed(double tow_offset, double tow) { clock_.seed(tow_offset, tow); }
+  /// bytes of the segment, in order
+  void add(const uint8_t* data, size_t len);
+
+  /// the index so far, by DID then offset, with each DID's latest packet as its last entry
+  std::vector<log_index_entry_t> entries() const;
+  uint64_t size() const { return offset_; }
+  double interval() const { return interval_; }
+  const DidTimeTracker& clock() const { return clock_; }
+  /// write the index, for a segment of size() bytes, replacing path atomically
+  bool save(const std::string& path) const;
+
+private:
+  LogIndexer(const LogIndexer&);
+  LogIndexer& operator=(const LogIndexer&);
+
+  double interval_;
+  is_comm_instance_t comm_;
+  uint8_t comm_buffer_[4096];
+  DidTimeTracker clock_;
+  uint64_t offset_;
+  uint64_t packet_start_;
+  std::vector<int64_t> last_entry_;             // per DID, index into entries_ or -1
+  std::vector<log_index_entry_t> last_packet_;  // per DID, count 0 if none yet
+  std::vector<log_index_entry_t> entries_;
+};
+
+/**
+ * @brief Raw log segments read through their indexes
+ * Segments are memory-mapped, so a time window only touches the pages holding it: for every DID
+ * asked for, the index entries that can hold data in the window give the byte ranges to parse,
+ * and segments entirely outside the window aren't looked at.  An index that's missing or doesn't
+ * match its segment (e.g. a log cut short by power loss) is built from the segment, and saved.
+ */
+class IndexedLog
+{
+public:
+  IndexedLog();
+  ~IndexedLog();
+
+  /// the raw log segments in a directory by device (prefix, e.g. LOG_SN30123), each in order
+  static std::map<std::string, std::vector<std::string> > find_segments(const std::string& directory);
+
+  /// add the next segment of the log
+  bool add_segment(const std::string& path, bool save_index = true);
+  /// what went wrong in the last add_segment(): it failed, or the index it built couldn't be saved
+  const std::string& error() const { return error_; }
+
+  size_t segment_count() const { return segments_.size(); }
+  uint64_t size() const;
+  uint64_t index_entries() const;
+  /// range of indexed GPS time of week, -1 if nothing is timed
+  double start_tow() const;
+  double end_tow() const;
+
+  /// read everything, timed or not
+  void rewind();
+  /// read the data sets of `dids` (every DID if empty) timed within [start, end]
+  void seek(double start, double end, const std::vector<uint32_t>& dids = std::vector<uint32_t>());
+
+  /**
+   * @brief next data set, in log order
+   * @param tow its GPS time of week, -1 if not timed (only when reading everything)
+   * @return NULL at the end; valid until the next call
+   */
+  const p_data_t* next(double& tow);
+  /// the framed packet next() last returned, as it is in the log
+  const uint8_t* packet(size_t& len) const;
+
+  /// bytes parsed since the last seek / rewind
+  uint64_t bytes_scanned() const { return scanned_; }
+
+private:
+  IndexedLog(const IndexedLog&);
+  IndexedLog& operator=(const IndexedLog&);
+
+  typedef struct
+  {
+    std::string path;
+    const uint8_t* data;
+    uint64_t size;
+    std::vector<log_index_entry_t> entries;                // by DID, then offset, once loaded
+    std::map<uint32_t, std::pair<size_t, size_t> > dids;   // DID -> [first, last) of entries
+    bool loaded;
+    uint32_t entry_count;
+    double interval;
+    double start_tow;
+    double end_tow;
+    double clock_tow;                                      // DidTimeTracker at the end, for indexing the next segment
+    double clock_tow_offset;
+  } segment_t;
+
+  typedef struct
+  {
+    uint64_t begin;   // start byte of the first packet
+    uint64_t end;     // packets starting before this
+    double tow;
+    double tow_offset;
+  } range_t;
+
+  bool load_index(segment_t& segment, bool entries);
+  void build_index(segment_t& segment, const segment_t* previous, bool save);
+  void map_entries(segment_t& segment);
+  void plan(size_t index);
+  void start_range();
+  bool wanted(uint32_t did) const;
+  const p_data_t* carry_over(const segment_t& segment, double& tow);
+
+  std::vector<segment_t> segments_;
+  std::string error_;
+
+  // reading
+  bool window_;
+  double start_;
+  double end_;
+  std::vector<uint32_t> filter_;       // sorted, empty for every DID
+  size_t segment_;
+  bool planned_;                       // ranges_ are segment_'s
+  std::vector<range_t> ranges_;
+  size_t range_;
+  uint64_t pos_;
+  uint64_t packet_start_;
+  uint64_t packet_end_;
+  uint64_t scanned_;
+  bool in_packet_;                     // comm_ is inside the packet that starts at packet_start_
+  bool carry_;                         // segment_ starts with the rest of the previous segment's last packet
+  uint64_t head_;                      // bytes at the start of segment_ that belong to that packet
+  std::vector<uint8_t> carried_;       // the whole of that packet, for packet()
+  bool packet_carried_;                // next() last returned it
+  is_comm_instance_t comm_;
+  uint8_t comm_buffer_[4096];
+  DidTimeTracker clock_;
+  p_data_t data_;
+};
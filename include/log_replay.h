@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "inertial_sense.h"
+#include "did_time.h"
+#include "log_index.h"
+
+/**
+ * @brief Plays recorded uINS logs back through InertialSenseROS
+ * Every data set is handed to InertialSenseROS::dispatch(), so it goes through exactly the same
+ * conversion and publish code as live data.  Several log directories (and every device in each
+ * of them) are merged into one stream ordered by uINS GPS time of week; ties are broken by the
+ * order the logs were given and then by file order, so the output order is deterministic.
+ * A directory holds either .dat logs, or raw logs (LogWriter segments), which are read through
+ * their indexes (IndexedLog).
+ */
+class LogReplay
+{
+public:
+  explicit LogReplay(InertialSenseROS& node);
+
+  /**
+   * @brief only replay data sets timed within [start, end] (GPS time of week, s), set before load()
+   * Raw logs go straight to the window through their indexes; .dat logs are read from the start.
+   */
+  void set_window(double start, double end);
+
+  /// open every device log found in each directory, returns false if none could be opened
+  bool load(const std::vector<std::string>& directories);
+
+  /**
+   * @brief replay everything that was loaded
+   * @param rate playback speed: 1.0 for real time, 2.0 for twice as fast, <= 0 as fast as possible
+   * @return number of data sets dispatched
+   */
+  uint64_t run(double rate);
+
+private:
+  typedef struct
+  {
+    std::shared_ptr<cISLogger> logger;
+    unsigned int device;
+    std::shared_ptr<IndexedLog> raw;  // instead of logger
+    DidTimeTracker clock;
+    p_data_t pending;             // next data set of this stream
+    std::vector<uint8_t> buffer;  // copy of its payload, the logger reuses its read buffer
+    double tow;
+    bool valid;
+  } stream_t;
+
+  bool advance(stream_t& stream);
+
+  InertialSenseROS& node_;
+  std::vector<stream_t> streams_;
+  bool window_;
+  double window_start_;
+  double window_end_;
+};
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "log_index.h"
+#include "serialPort.h"
+#include "spsc_ring.h"
+
+/**
+ * @brief Raw uINS log written from a background thread
+ * Every chunk the decoder reads from the port (framed packets, exactly as the uINS sent them) is
+ * copied into a preallocated lock-free ring; a writer thread moves it into fixed-size segment
+ * files in whole, aligned blocks, so a slow disk only ever fills the ring.  A chunk that doesn't
+ * fit is dropped whole and counted, never waited on.
+ * Segments are named <prefix>_<index>.raw, preallocated to segment_size when started, rotated by
+ * size and/or age, and truncated to their data when closed.  A segment cut short (power loss)
+ * ends in zeros, which packet parsers skip.
+ * The writer thread also indexes what it writes (see LogIndexer), and saves the index next to
+ * each segment as it's closed (<prefix>_<index>.idx).
+ */
+class LogWriter
+{
+public:
+  typedef struct
+  {
+    std::string directory;     // created if missing
+    std::string prefix;        // segment file name prefix, e.g. LOG_SN30123
+    uint64_t segment_size;     // bytes per segment (rounded up to block_size), preallocated
+    double segment_duration;   // seconds per segment, 0: rotate by size only
+    size_t block_size;         // write size and alignment, a multiple of 4096
+    size_t queue_size;         // ring bytes between the decoder and the writer thread
+    double sync_period;        // fdatasync every sync_period seconds, 0: only when a segment is closed
+    bool direct_io;            // O_DIRECT, bypassing the page cache
+    double index_interval;     // seconds of uINS time between index entries per DID, 0: no index
+  } config_t;
+
+  typedef struct
+  {
+    uint64_t queue_capacity;
+    uint64_t queue_fill;       // bytes waiting for the writer thread
+    uint64_t queue_high_water;
+    uint64_t bytes_in;         // bytes handed to write()
+    uint64_t bytes_written;    // bytes in segment files (not counting block padding)
+    uint64_t dropped_bytes;    // bytes that didn't fit in the queue, or whose block couldn't be written
+    uint64_t dropped_chunks;   // chunks, and blocks, dropped
+    uint32_t segments;         // segments started
+    uint32_t write_errors;
+    double max_write_ms;       // longest block write or sync, what the queue had to absorb
+  } stats_t;
+
+  static config_t default_config();
+
+  explicit LogWriter(const config_t& config);
+  ~LogWriter();
+
+  /// open the first segment and start the writer thread
+  bool start();
+  /// write out everything queued, close the segment and stop the writer thread
+  void stop();
+  bool running() const { return running_; }
+
+  /// producer (one thread): queue a chunk of raw bytes, never blocks
+  void write(const uint8_t* data, size_t len);
+
+  /**
+   * @brief log everything read from a serial port
+   * The port's pfnRead is wrapped, so whatever thread decodes the port becomes the producer.
+   * Attach again after anything else replaces pfnRead (e.g. a SerialPipeline starting); it's a
+   * no-op while still attached.
+   */
+  bool attach(serial_port_t* port);
+  void detach();
+
+  stats_t stats() const;
+  /// path of the segment being written (writer thread's, so may be one behind right after rotating)
+  std::string current_segment() const;
+
+private:
+  void writer_thread();
+  bool open_segment();
+  bool open_file();
+  void close_segment();
+  bool write_block();
+  void drop_block();
+  static int read_hook(serial_port_t* port, unsigned char* buf, int len, int timeoutMilliseconds);
+
+  config_t config_;
+  SpscByteRing ring_;
+  size_t wake_fill_;              // queued bytes worth waking the writer thread for
+  int event_fd_;
+  std::atomic<bool> signalled_;   // producer raised event_fd_ since the writer last cleared it
+  std::thread thread_;
+  std::atomic<bool> running_;
+
+  // writer thread
+  uint8_t* block_;                // block_size, aligned for O_DIRECT
+  size_t block_fill_;
+  int fd_;
+  uint32_t segment_index_;
+  uint64_t segment_offset_;       // file offset of block_
+  uint64_t segment_start_ns_;
+  uint64_t last_sync_ns_;
+  std::string segment_path_;      // guarded by path_mutex_
+  mutable std::mutex path_mutex_;
+  std::unique_ptr<LogIndexer> indexer_;
+
+  serial_port_t* port_;
+  pfnSerialPortRead port_read_;
+
+  std::atomic<uint64_t> high_water_;
+  std::atomic<uint64_t> bytes_in_;
+  std::atomic<uint64_t> bytes_written_;
+  std::atomic<uint64_t> dropped_bytes_;
+  std::atomic<uint64_t> dropped_chunks_;
+  std::atomic<uint32_t> segments_;
+  std::atomic<uint32_t> write_errors_;
+  std::atomic<uint64_t> max_write_ns_;
+};
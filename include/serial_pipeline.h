@@ -0,0 +1,88 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <thread>
+
+#include "serialPort.h"
+#include "spsc_ring.h"
+
+/**
+ * @brief Serial reader thread feeding the SDK decoder through a lock-free ring
+ * While running, a dedicated (optionally real-time priority) thread drains the serial port
+ * into a preallocated SpscByteRing, and the port's pfnRead is redirected to read from the ring.
+ * The InertialSense SDK therefore keeps calling IS_.Update() as usual on the decode thread, but
+ * a slow publish or service callback can no longer let the kernel RX buffer overflow.
+ */
+class SerialPipeline
+{
+public:
+  typedef struct
+  {
+    uint64_t capacity;        // ring size in bytes
+    uint64_t fill;            // bytes currently waiting for the decoder
+    uint64_t high_water;      // largest fill seen since start()
+    uint64_t bytes_in;        // bytes read from the port
+    uint64_t overflow_bytes;  // bytes dropped because the ring was full
+    uint64_t overflow_events; // number of reads that had to drop data
+  } stats_t;
+
+  explicit SerialPipeline(size_t ring_size);
+  ~SerialPipeline();
+
+  /**
+   * @brief start the reader thread on an open port
+   * @param priority SCHED_FIFO priority for the reader thread, 0 to leave the default policy
+   * @return false if the port is not open or a pipeline is already attached to it
+   */
+  bool start(serial_port_t* serialPort, int priority);
+
+  /// stop the reader thread and give the port back its original read function
+  void stop();
+
+  bool running() const { return running_; }
+
+  /// the port reported an error or hang-up (e.g. the device went away), the fd is signalled once
+  bool port_error() const { return port_error_; }
+
+  /// eventfd that is signalled whenever new bytes are placed in the ring
+  int fd() const { return event_fd_; }
+
+  stats_t stats() const;
+
+  /**
+   * @brief CLOCK_MONOTONIC time (ns) the bytes most recently handed to the decoder came off the port
+   * Only meaningful on the decode thread, right after a read (i.e. inside SDK data callbacks).
+   */
+  uint64_t last_arrival_ns() const { return last_arrival_ns_; }
+
+private:
+  void reader_thread();
+  static int read_hook(serial_port_t* serialPort, unsigned char* buf, int len, int timeoutMilliseconds);
+  int ring_read(unsigned char* buf, int len, int timeoutMilliseconds);
+
+  // stream position just past a chunk of bytes, and when that chunk was read
+  typedef struct
+  {
+    uint64_t end;
+    uint64_t arrival_ns;
+  } chunk_stamp_t;
+
+  SpscByteRing ring_;
+  SpscQueue<chunk_stamp_t> stamps_;
+  uint64_t ring_in_;         // reader side stream position, bytes put in the ring (not the dropped ones)
+  uint64_t bytes_out_;       // decoder side stream position
+  uint64_t last_arrival_ns_;
+  serial_port_t* port_;
+  pfnSerialPortRead port_read_;
+  int event_fd_;
+  std::thread thread_;
+  std::atomic<bool> running_;
+  std::atomic<bool> port_error_;
+
+  std::atomic<uint64_t> high_water_;
+  std::atomic<uint64_t> bytes_in_;
+  std::atomic<uint64_t> overflow_bytes_;
+  std::atomic<uint64_t> overflow_events_;
+};
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <atomic>
+#include <vector>
+
+/**
+ * @brief Lock-free single-producer / single-consumer byte ring
+ * Storage is allocated once in the constructor (capacity is rounded up to a power of two).
+ * Exactly one thread may call the producer functions and exactly one thread the consumer
+ * functions.  Positions are free-running counters, so full/empty never alias.
+ */
+class SpscByteRing
+{
+public:
+  explicit SpscByteRing(size_t capacity) :
+    head_(0), tail_(0)
+  {
+    size_t size = 1;
+    while (size < capacity)
+      size <<= 1;
+    buffer_.resize(size);
+    mask_ = size - 1;
+  }
+
+  size_t capacity() const { return buffer_.size(); }
+
+  /// bytes currently stored (safe to call from either side, or a third thread for statistics)
+  size_t size() const
+  {
+    return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+  }
+
+  // ---------------- producer ----------------
+
+  size_t writable() const { return capacity() - size(); }
+
+  /// contiguous free space starting at the write position, so read() can land directly in the ring
+  uint8_t* write_region(size_t& len)
+  {
+    size_t head = head_.load(std::memory_order_relaxed);
+    size_t tail = tail_.load(std::memory_order_acquire);
+    size_t free = capacity() - (head - tail);
+    size_t to_end = capacity() - (head & mask_);
+    len = free < to_end ? free : to_end;
+    return &buffer_[head & mask_];
+  }
+
+  /// publish n bytes previously written into write_region()
+  void commit_write(size_t n)
+  {
+    head_.store(head_.load(std::memory_order_relaxed) + n, std::memory_order_release);
+  }
+
+  /// copy in as much of data as fits, returns bytes written
+  size_t write(const uint8_t* data, size_t len)
+  {
+    size_t written = 0;
+    while (written < len)
+    {
+      size_t region_len;
+      uint8_t* region = write_region(region_len);
+      if (region_len == 0)
+        break;
+      size_t n = (len - written) < region_len ? (len - written) : region_len;
+      memcpy(region, data + written, n);
+      commit_write(n);
+      written += n;
+    }
+    return written;
+  }
+
+  // ---------------- consumer ----------------
+
+  /// contiguous stored bytes starting at the read position
+  const uint8_t* read_region(size_t& len) const
+  {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    size_t head = head_.load(std::memory_order_acquire);
+    size_t used = head - tail;
+    size_t to_end = capacity() - (tail & mask_);
+    len = used < to_end ? used : to_end;
+    return &buffer_[tail & mask_];
+  }
+
+  /// release n bytes previously obtained from read_region()
+  void consume(size_t n)
+  {
+    tail_.store(tail_.load(std::memory_order_relaxed) + n, std::memory_order_release);
+  }
+
+  /// copy out up to len bytes, returns bytes read
+  size_t read(uint8_t* out, size_t len)
+  {
+    size_t done = 0;
+    while (done < len)
+    {
+      size_t region_len;
+      const uint8_t* region = read_region(region_len);
+      if (region_len == 0)
+        break;
+      size_t n = (len - done) < region_len ? (len - done) : region_len;
+      memcpy(out + done, region, n);
+      consume(n);
+      done += n;
+    }
+    return done;
+  }
+
+private:
+  std::vector<uint8_t> buffer_;
+  size_t mask_;
+
+  // keep the producer and consumer positions on separate cache lines
+  alignas(64) std::atomic<size_t> head_;
+  alignas(64) std::atomic<size_t> tail_;
+};
+
+/**
+ * @brief Lock-free single-producer / single-consumer queue of fixed-size items
+ * Same rules as SpscByteRing: preallocated, power-of-two capacity, one thread per side.
+ */
+template <typename T>
+class SpscQueue
+{
+public:
+  explicit SpscQueue(size_t capacity) :
+    head_(0), tail_(0)
+  {
+    size_t size = 1;
+    while (size < capacity)
+      size <<= 1;
+    items_.resize(size);
+    mask_ = size - 1;
+  }
+
+  size_t capacity() const { return items_.size(); }
+
+  size_t size() const
+  {
+    return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+  }
+
+  /// returns false (and drops item) if the queue is full
+  bool push(const T& item)
+  {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) == items_.size())
+      return false;
+    items_[head & mask_] = item;
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// oldest item, or NULL if empty
+  T* front()
+  {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if (head_.load(std::memory_order_acquire) == tail)
+      return NULL;
+    return &items_[tail & mask_];
+  }
+
+  void pop()
+  {
+    tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
+private:
+  std::vector<T> items_;
+  size_t mask_;
+
+  alignas(64) std::atomic<size_t> head_;
+  alignas(64) std::atomic<size_t> tail_;
+};
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include "ros/callback_queue.h"
+
+/**
+ * @brief ROS callback queue that can be waited on together with other file descriptors
+ * Every callback added to the queue (subscriptions, timers, services) signals an eventfd, so
+ * the owner can block in poll()/epoll_wait() on this fd and the serial port at the same time
+ * instead of spinning.
+ */
+class WakeableCallbackQueue : public ros::CallbackQueue
+{
+public:
+  WakeableCallbackQueue() :
+    event_fd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+  {}
+
+  ~WakeableCallbackQueue()
+  {
+    if (event_fd_ >= 0)
+      close(event_fd_);
+  }
+
+  virtual void addCallback(const ros::CallbackInterfacePtr& callback, uint64_t owner_id = 0)
+  {
+    ros::CallbackQueue::addCallback(callback, owner_id);
+    notify();
+  }
+
+  /// wake up whoever is waiting on fd() without queueing a callback
+  void notify()
+  {
+    uint64_t one = 1;
+    ssize_t n = write(event_fd_, &one, sizeof(one));
+    (void)n;
+  }
+
+  /// reset the wake-up signal and run everything that is ready, without blocking
+  void callAvailableNow()
+  {
+    uint64_t count;
+    ssize_t n = read(event_fd_, &count, sizeof(count));
+    (void)n;
+    callAvailable(ros::WallDuration(0));
+  }
+
+  /// file descriptor that becomes readable whenever a callback is queued
+  int fd() const { return event_fd_; }
+
+private:
+  int event_fd_;
+};
@@ -11,7 +11,7 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 */
 
 #include "serialPort.h"
-#include "serialPortPlatform.h"
+#include "serialPortExt.h"
 #include "ISConstants.h"
 
 #if PLATFORM_IS_LINUX || PLATFORM_IS_APPLE
@@ -28,6 +28,8 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 #include <termios.h>
 #include <unistd.h>
 #include <poll.h>
+#include <time.h>
+#include <pthread.h>
 
 // cygwin defines FIONREAD in socket.h instead of ioctl.h
 #ifndef FIONREAD
@@ -44,6 +46,34 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 
 #endif
 
+#if PLATFORM_IS_LINUX
+
+#include <limits.h>
+#include <linux/serial.h>
+
+// glibc's termios has no way to set an arbitrary baud rate, so talk termios2 to the kernel directly
+// (TCGETS2 / TCSETS2 from asm/ioctls.h refer to struct termios2, which glibc does not define)
+#ifndef BOTHER
+#define BOTHER 0010000
+#endif
+#ifndef CBAUD
+#define CBAUD 0010017
+#endif
+
+struct termios2
+{
+	tcflag_t c_iflag;
+	tcflag_t c_oflag;
+	tcflag_t c_cflag;
+	tcflag_t c_lflag;
+	cc_t c_line;
+	cc_t c_cc[19];
+	speed_t c_ispeed;
+	speed_t c_ospeed;
+};
+
+#endif
+
 #ifndef error_message
 #define error_message printf
 #endif
@@ -69,6 +99,12 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 
 #endif
 
+#define SERIAL_PORT_READ_AHEAD_SIZE 512
+
+#if !PLATFORM_IS_WINDOWS
+typedef struct serialPortAsyncState serialPortAsyncState;
+#endif
+
 typedef struct
 {
 	int blocking;
@@ -83,10 +119,47 @@ typedef struct
 
 	int fd;
 
+	// small reads (i.e. a byte at a time) are served from here so they don't each cost a syscall
+	unsigned char readAhead[SERIAL_PORT_READ_AHEAD_SIZE];
+	int readAheadStart;
+	int readAheadCount;
+
+	// created on the first async read, see serialPortAsyncReadPlatform
+	serialPortAsyncState* async;
+
 #endif
 
 } serialPortHandle;
 
+#if !PLATFORM_IS_WINDOWS
+
+typedef struct serialPortAsyncRequest
+{
+	unsigned char* buffer;
+	int readCount;
+	pfnSerialPortAsyncReadCompletion completion;
+	struct serialPortAsyncRequest* next;
+} serialPortAsyncRequest;
+
+// completion worker for async reads: requests are queued FIFO and completed on this thread as data arrives
+struct serialPortAsyncState
+{
+	serial_port_t* serialPort;
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	int wakeFd[2];		// pipe used to interrupt poll() when closing
+	int stop;
+	int detached;		// closed from a completion, the thread frees this state when it finishes
+	serialPortAsyncRequest* head;
+	serialPortAsyncRequest* tail;
+};
+
+static void serialPortAsyncStop(serialPortHandle* handle);
+static void serialPortAsyncFree(serialPortAsyncState* async);
+
+#endif
+
 #if PLATFORM_IS_WINDOWS
 
 #define WINDOWS_OVERLAPPED_BUFFER_SIZE 8192
@@ -133,8 +206,99 @@ static int get_baud_speed(int baudRate)
 	}
 }
 
+// SERIAL_PORT_OPTION_* applied to every port opened from now on
+static int s_serialPortOptions = 0;
+
+#if PLATFORM_IS_LINUX
+
+static int set_custom_baud(int fd, int baudRate)
+{
+	struct termios2 tty2;
+	if (ioctl(fd, TCGETS2, &tty2) != 0)
+	{
+		error_message("error %d from ioctl TCGETS2", errno);
+		return -1;
+	}
+	tty2.c_cflag &= ~CBAUD;
+	tty2.c_cflag |= BOTHER;
+	tty2.c_ispeed = baudRate;
+	tty2.c_ospeed = baudRate;
+	if (ioctl(fd, TCSETS2, &tty2) != 0)
+	{
+		error_message("error %d from ioctl TCSETS2 (%d baud)", errno, baudRate);
+		return -1;
+	}
+	return 0;
+}
+
+// sysfs latency timer of a USB-serial adapter (FTDI and similar), e.g. /sys/class/tty/ttyUSB0/device/latency_timer
+static int get_latency_timer_path(const char* port, char* path, int pathSize)
+{
+	char device[PATH_MAX];
+	if (realpath(port, device) == 0)
+	{
+		return 0;
+	}
+	const char* name = strrchr(device, '/');
+	name = (name ? name + 1 : device);
+	snprintf(path, pathSize, "/sys/class/tty/%s/device/latency_timer", name);
+	return access(path, R_OK) == 0;
+}
+
+static int read_latency_timer(const char* port)
+{
+	char path[PATH_MAX + 64];
+	int latency = -1;
+	if (get_latency_timer_path(port, path, sizeof(path)))
+	{
+		FILE* f = fopen(path, "r");
+		if (f)
+		{
+			if (fscanf(f, "%d", &latency) != 1)
+			{
+				latency = -1;
+			}
+			fclose(f);
+		}
+	}
+	return latency;
+}
+
+static void set_low_latency(int fd, const char* port)
+{
+	// ASYNC_LOW_LATENCY makes the tty layer push received data immediately, and makes drivers
+	// such as ftdi_sio drop their USB latency timer to 1 ms
+	struct serial_struct serial;
+	if (ioctl(fd, TIOCGSERIAL, &serial) == 0)
+	{
+		serial.flags |= ASYNC_LOW_LATENCY;
+		if (ioctl(fd, TIOCSSERIAL, &serial) != 0)
+		{
+			error_message("error %d from ioctl TIOCSSERIAL, ASYNC_LOW_LATENCY not set\n", errno);
+		}
+	}
+
+	// drivers that ignore the flag still have the timer in sysfs (writable as root or through a udev rule)
+	if (read_latency_timer(port) > 1)
+	{
+		char path[PATH_MAX + 64];
+		if (get_latency_timer_path(port, path, sizeof(path)))
+		{
+			FILE* f = fopen(path, "w");
+			if (f)
+			{
+				fprintf(f, "1");
+				fclose(f);
+			}
+		}
+	}
+}
+
+#endif
+
 static int set_interface_attribs(int fd, int speed, int parity)
 {
+	int customBaud = 0;
 	struct termios tty;
 	memset(&tty, 0, sizeof tty);
 	if (tcgetattr(fd, &tty) != 0)
@@ -157,9 +321,18 @@ static int set_interface_attribs(int fd, int speed, int parity)
 
 #else
 
-	speed = get_baud_speed(speed);
-	cfsetospeed(&tty, speed);
-	cfsetispeed(&tty, speed);
+	int baud = get_baud_speed(speed);
+#if PLATFORM_IS_LINUX
+	// rates without a Bxxx constant (and, in low latency mode, everything above 921600 so the driver
+	// computes the exact divisor) are set through termios2 once the rest of the configuration is done
+	if (baud == 0 || ((s_serialPortOptions & SERIAL_PORT_OPTION_LOW_LATENCY) && speed > 921600))
+	{
+		customBaud = speed;
+		baud = B38400;
+	}
+#endif
+	cfsetospeed(&tty, baud);
+	cfsetispeed(&tty, baud);
 
 #endif
 
@@ -256,6 +429,15 @@ static int set_interface_attribs(int fd, int speed, int parity)
 		return -1;
 	}
 
+#if PLATFORM_IS_LINUX
+	if (customBaud != 0 && set_custom_baud(fd, customBaud) != 0)
+	{
+		return -1;
+	}
+#else
+	(void)customBaud;
+#endif
+
 	return 0;
 }
 
@@ -340,6 +522,12 @@ static int serialPortOpenPlatform(serial_port_t* serialPort, const char* port, i
 	{
 		return 0;
 	}
+#if PLATFORM_IS_LINUX
+	if (s_serialPortOptions & SERIAL_PORT_OPTION_LOW_LATENCY)
+	{
+		set_low_latency(fd, port);
+	}
+#endif
 	serialPortHandle* handle = (serialPortHandle*)calloc(sizeof(serialPortHandle), 1);
 	handle->fd = fd;
 	handle->blocking = blocking;
@@ -350,6 +538,12 @@ static int serialPortOpenPlatform(serial_port_t* serialPort, const char* port, i
 	return 1;	// success
 }
 
+// the SDK opens its ports with its own platform layer, whose handle has none of the fields used here
+static int serialPortIsExt(serial_port_t* serialPort)
+{
+	return serialPort != 0 && serialPort->handle != 0 && serialPort->pfnOpen == serialPortOpenPlatform;
+}
+
 static int serialPortIsOpenPlatform(serial_port_t* serialPort)
 {
 
@@ -391,6 +585,7 @@ static int serialPortClosePlatform(serial_port_t* serialPort)
 
 #else
 
+	serialPortAsyncStop(handle);
 	close(handle->fd);
 	handle->fd = 0;
 
@@ -416,6 +611,7 @@ static int serialPortFlushPlatform(serial_port_t* serialPort)
 #else
 
 	tcflush(handle->fd, TCIOFLUSH);
+	handle->readAheadCount = 0;
 
 #endif
 
@@ -478,53 +674,98 @@ static int serialPortReadTimeoutPlatformWindows(serialPortHandle* handle, unsign
 
 #else
 
-static int serialPortReadTimeoutPlatformLinux(serialPortHandle* handle, unsigned char* buffer, int readCount, int timeoutMilliseconds)
+static uint64_t monotonicTimeNs(void)
 {
-	int totalRead = 0;
-	int dtMs;
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static int takeReadAhead(serialPortHandle* handle, unsigned char* buffer, int readCount)
+{
+	int n = _MIN(readCount, handle->readAheadCount);
+	if (n > 0)
+	{
+		memcpy(buffer, handle->readAhead + handle->readAheadStart, n);
+		handle->readAheadStart += n;
+		handle->readAheadCount -= n;
+	}
+	return n;
+}
+
+// one non-blocking pass: buffered bytes first, then at most one read() syscall
+// returns bytes read or -1 on a read error with nothing read
+static int readAvailableLinux(serialPortHandle* handle, unsigned char* buffer, int readCount)
+{
+	int totalRead = takeReadAhead(handle, buffer, readCount);
+	int remaining = readCount - totalRead;
 	int n;
-	struct timeval start, curr;
-	if (timeoutMilliseconds > 0)
+	if (remaining == 0)
 	{
-		gettimeofday(&start, NULL);
+		return totalRead;
 	}
 
-	while (1)
+	if (remaining < SERIAL_PORT_READ_AHEAD_SIZE)
 	{
-		if (timeoutMilliseconds > 0)
+		// pull a whole block so the following small reads are served from memory
+		n = read(handle->fd, handle->readAhead, SERIAL_PORT_READ_AHEAD_SIZE);
+		if (n > 0)
 		{
-			struct pollfd fds[1];
-			fds[0].fd = handle->fd;
-			fds[0].events = POLLIN;
-			int pollrc = poll(fds, 1, timeoutMilliseconds);
-			if (pollrc <= 0 || !(fds[0].revents & POLLIN))
-			{
-				break;
-			}
+			handle->readAheadStart = 0;
+			handle->readAheadCount = n;
+			totalRead += takeReadAhead(handle, buffer + totalRead, remaining);
 		}
-		n = read(handle->fd, buffer + totalRead, readCount - totalRead);
-		if (n < -1)
+	}
+	else
+	{
+		n = read(handle->fd, buffer + totalRead, remaining);
+		if (n > 0)
 		{
-			error_message("error %d from read, fd %d", errno, handle->fd);
-			return 0;
+			totalRead += n;
 		}
-		else if (n != -1)
+	}
+
+	if (n < 0 && totalRead == 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+	{
+		error_message("error %d from read, fd %d", errno, handle->fd);
+		return -1;
+	}
+	return totalRead;
+}
+
+static int serialPortReadTimeoutPlatformLinux(serialPortHandle* handle, unsigned char* buffer, int readCount, int timeoutMilliseconds)
+{
+	int totalRead = 0;
+	uint64_t deadline = 0;
+	if (timeoutMilliseconds > 0)
+	{
+		deadline = monotonicTimeNs() + (uint64_t)timeoutMilliseconds * 1000000ULL;
+	}
+
+	while (1)
+	{
+		// read first, only wait in poll when nothing is buffered
+		int n = readAvailableLinux(handle, buffer + totalRead, readCount - totalRead);
+		if (n < 0)
 		{
-			totalRead += n;
+			break;
 		}
-		if (timeoutMilliseconds > 0 && totalRead < readCount)
+		totalRead += n;
+		if (totalRead >= readCount || timeoutMilliseconds <= 0)
 		{
-			gettimeofday(&curr, NULL);
-			dtMs = ((curr.tv_sec - start.tv_sec) * 1000) + ((curr.tv_usec - start.tv_usec) / 1000);
-			if (dtMs >= timeoutMilliseconds)
-			{
-				break;
-			}
+			break;
+		}
 
-			// try for another loop around with a lower timeout
-			timeoutMilliseconds = _MAX(0, timeoutMilliseconds - dtMs);
+		uint64_t now = monotonicTimeNs();
+		if (now >= deadline)
+		{
+			break;
 		}
-		else
+		struct pollfd fds[1];
+		fds[0].fd = handle->fd;
+		fds[0].events = POLLIN;
+		int pollrc = poll(fds, 1, (int)((deadline - now + 999999ULL) / 1000000ULL));
+		if (pollrc <= 0 || !(fds[0].revents & POLLIN))
 		{
 			break;
 		}
@@ -554,6 +795,151 @@ static int serialPortReadTimeoutPlatform(serial_port_t* serialPort, unsigned cha
 
 }
 
+#if !PLATFORM_IS_WINDOWS
+
+static void* serialPortAsyncThread(void* arg)
+{
+	serialPortHandle* handle = (serialPortHandle*)arg;
+	serialPortAsyncState* async = handle->async;
+	struct pollfd fds[2];
+	fds[0].fd = handle->fd;
+	fds[0].events = POLLIN;
+	fds[1].fd = async->wakeFd[0];
+	fds[1].events = POLLIN;
+
+	while (1)
+	{
+		// sleep until there is a read to complete
+		pthread_mutex_lock(&async->mutex);
+		while (async->head == 0 && !async->stop)
+		{
+			pthread_cond_wait(&async->cond, &async->mutex);
+		}
+		int stop = async->stop;
+		pthread_mutex_unlock(&async->mutex);
+		if (stop)
+		{
+			// the port may be closed and handle freed already, only async is ours from here
+			break;
+		}
+
+		// then until the port has data (or we are closing)
+		fds[0].revents = fds[1].revents = 0;
+		if (handle->readAheadCount == 0 && poll(fds, 2, -1) <= 0)
+		{
+			continue;
+		}
+		if (fds[1].revents & POLLIN)
+		{
+			continue;
+		}
+
+		pthread_mutex_lock(&async->mutex);
+		serialPortAsyncRequest* req = async->head;
+		async->head = req->next;
+		if (async->head == 0)
+		{
+			async->tail = 0;
+		}
+		pthread_mutex_unlock(&async->mutex);
+
+		int n = readAvailableLinux(handle, req->buffer, req->readCount);
+		if (n == 0 && (fds[0].revents & (POLLERR | POLLHUP | POLLNVAL)))
+		{
+			n = -1;
+			errno = EIO;
+		}
+		req->completion(async->serialPort, req->buffer, (n < 0 ? 0 : n), (n >= 0 ? 0 : errno));
+		free(req);
+	}
+
+	// complete anything still queued so callers can release their buffers
+	pthread_mutex_lock(&async->mutex);
+	serialPortAsyncRequest* req = async->head;
+	async->head = async->tail = 0;
+	int detached = async->detached;
+	pthread_mutex_unlock(&async->mutex);
+	while (req != 0)
+	{
+		serialPortAsyncRequest* next = req->next;
+		req->completion(async->serialPort, req->buffer, 0, ECANCELED);
+		free(req);
+		req = next;
+	}
+	if (detached)
+	{
+		serialPortAsyncFree(async);
+	}
+	return 0;
+}
+
+static serialPortAsyncState* serialPortAsyncStart(serial_port_t* serialPort, serialPortHandle* handle)
+{
+	serialPortAsyncState* async = (serialPortAsyncState*)calloc(sizeof(serialPortAsyncState), 1);
+	async->serialPort = serialPort;
+	if (pipe(async->wakeFd) != 0)
+	{
+		free(async);
+		return 0;
+	}
+	fcntl(async->wakeFd[0], F_SETFL, O_NONBLOCK);
+	pthread_mutex_init(&async->mutex, 0);
+	pthread_cond_init(&async->cond, 0);
+	handle->async = async;
+	if (pthread_create(&async->thread, 0, serialPortAsyncThread, handle) != 0)
+	{
+		error_message("error %d creating async read thread", errno);
+		handle->async = 0;
+		serialPortAsyncFree(async);
+		return 0;
+	}
+	return async;
+}
+
+static void serialPortAsyncStop(serialPortHandle* handle)
+{
+	serialPortAsyncState* async = handle->async;
+	if (async == 0)
+	{
+		return;
+	}
+
+	handle->async = 0;
+	if (pthread_equal(pthread_self(), async->thread))
+	{
+		// closed from a completion callback: joining ourselves would deadlock, so the thread stops
+		// once the callback returns, cancels what is still queued and cleans up after itself
+		pthread_mutex_lock(&async->mutex);
+		async->stop = 1;
+		async->detached = 1;
+		pthread_mutex_unlock(&async->mutex);
+		pthread_detach(async->thread);
+		return;
+	}
+
+	pthread_mutex_lock(&async->mutex);
+	async->stop = 1;
+	pthread_cond_signal(&async->cond);
+	pthread_mutex_unlock(&async->mutex);
+	if (write(async->wakeFd[1], "x", 1) < 0)
+	{
+		error_message("error %d waking async read thread", errno);
+	}
+	pthread_join(async->thread, 0);
+	serialPortAsyncFree(async);
+}
+
+static void serialPortAsyncFree(serialPortAsyncState* async)
+{
+	close(async->wakeFd[0]);
+	close(async->wakeFd[1]);
+	pthread_mutex_destroy(&async->mutex);
+	pthread_cond_destroy(&async->cond);
+	free(async);
+}
+
+#endif
+
 static int serialPortAsyncReadPlatform(serial_port_t* serialPort, unsigned char* buffer, int readCount, pfnSerialPortAsyncReadCompletion completion)
 {
 	serialPortHandle* handle = (serialPortHandle*)serialPort->handle;
@@ -573,9 +959,31 @@ static int serialPortAsyncReadPlatform(serial_port_t* serialPort, unsigned char*
 
 #else
 
-	// no support for async, just call the completion right away
-	int n = read(handle->fd, buffer, readCount);
-	completion(serialPort, buffer, (n < 0 ? 0 : n), (n >= 0 ? 0 : n));
+	// queue the read for the completion thread, which calls completion once data arrives
+	serialPortAsyncState* async = handle->async;
+	if (async == 0 && (async = serialPortAsyncStart(serialPort, handle)) == 0)
+	{
+		return 0;
+	}
+
+	serialPortAsyncRequest* req = (serialPortAsyncRequest*)malloc(sizeof(serialPortAsyncRequest));
+	req->buffer = buffer;
+	req->readCount = readCount;
+	req->completion = completion;
+	req->next = 0;
+
+	pthread_mutex_lock(&async->mutex);
+	if (async->tail != 0)
+	{
+		async->tail->next = req;
+	}
+	else
+	{
+		async->head = req;
+	}
+	async->tail = req;
+	pthread_cond_signal(&async->cond);
+	pthread_mutex_unlock(&async->mutex);
 
 #endif
 
@@ -654,9 +1062,9 @@ static int serialPortGetByteCountAvailableToReadPlatform(serial_port_t* serialPo
 
 #else
 
-	int bytesAvailable;
+	int bytesAvailable = 0;
 	ioctl(handle->fd, FIONREAD, &bytesAvailable);
-	return bytesAvailable;
+	return bytesAvailable + handle->readAheadCount;
 
 #endif
 
@@ -696,7 +1104,151 @@ static int serialPortSleepPlatform(serial_port_t* serialPort, int sleepMilliseco
 	return 1;
 }
 
-int serialPortPlatformInit(serial_port_t* serialPort)
+int serialPortReadBulk(serial_port_t* serialPort, unsigned char* buffer, int bufferSize, int timeoutMilliseconds, uint64_t* arrivalTimeNs)
+{
+	if (!serialPortIsExt(serialPort) || buffer == 0 || bufferSize < 1)
+	{
+		return -1;
+	}
+	serialPortHandle* handle = (serialPortHandle*)serialPort->handle;
+
+#if PLATFORM_IS_WINDOWS
+
+	int n = serialPortReadTimeoutPlatformWindows(handle, buffer, bufferSize, _MAX(timeoutMilliseconds, 0));
+	if (arrivalTimeNs != 0)
+	{
+		*arrivalTimeNs = GetTickCount64() * 1000000ULL;
+	}
+	return n;
+
+#else
+
+	if (timeoutMilliseconds > 0 && handle->readAheadCount == 0)
+	{
+		struct pollfd fds[1];
+		fds[0].fd = handle->fd;
+		fds[0].events = POLLIN;
+		if (poll(fds, 1, timeoutMilliseconds) <= 0)
+		{
+			return 0;
+		}
+	}
+
+	// A non-blocking read() on a tty returns everything the driver has buffered up to bufferSize,
+	// so there is no need to ask FIONREAD first - that would just be a second syscall.
+	int totalRead = takeReadAhead(handle, buffer, bufferSize);
+	int n = 0;
+	if (totalRead < bufferSize)
+	{
+		n = read(handle->fd, buffer + totalRead, bufferSize - totalRead);
+	}
+	if (arrivalTimeNs != 0)
+	{
+		*arrivalTimeNs = monotonicTimeNs();
+	}
+	if (n > 0)
+	{
+		totalRead += n;
+	}
+	else if (n < 0 && totalRead == 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+	{
+		return -1;
+	}
+	return totalRead;
+
+#endif
+
+}
+
+int serialPortGetFileDescriptor(serial_port_t* serialPort)
+{
+	if (!serialPortIsExt(serialPort))
+	{
+		return -1;
+	}
+
+#if PLATFORM_IS_WINDOWS
+
+	return -1;
+
+#else
+
+	serialPortHandle* handle = (serialPortHandle*)serialPort->handle;
+	return handle->fd;
+
+#endif
+
+}
+
+int serialPortGetReadAheadCount(serial_port_t* serialPort)
+{
+	if (!serialPortIsExt(serialPort))
+	{
+		return 0;
+	}
+
+#if PLATFORM_IS_WINDOWS
+
+	return 0;
+
+#else
+
+	serialPortHandle* handle = (serialPortHandle*)serialPort->handle;
+	return handle->readAheadCount;
+
+#endif
+
+}
+
+void serialPortPlatformSetOptions(int options)
+{
+	s_serialPortOptions = options;
+}
+
+int serialPortGetLatencyInfo(serial_port_t* serialPort, serial_port_latency_info_t* info)
+{
+	memset(info, 0, sizeof(*info));
+	info->latencyTimerMs = -1;
+
+	int fd = serialPortGetFileDescriptor(serialPort);
+	if (fd < 0)
+	{
+		return 0;
+	}
+
+#if PLATFORM_IS_LINUX
+
+	struct termios2 tty2;
+	if (ioctl(fd, TCGETS2, &tty2) != 0)
+	{
+		return 0;
+	}
+	info->baudRate = (int)tty2.c_ospeed;
+	info->customBaud = ((tty2.c_cflag & CBAUD) == BOTHER);
+
+	struct serial_struct serial;
+	if (ioctl(fd, TIOCGSERIAL, &serial) == 0)
+	{
+		info->lowLatency = ((serial.flags & ASYNC_LOW_LATENCY) != 0);
+	}
+	info->latencyTimerMs = read_latency_timer(serialPort->port);
+	return 1;
+
+#else
+
+	struct termios tty;
+	if (tcgetattr(fd, &tty) != 0)
+	{
+		return 0;
+	}
+	info->baudRate = (int)cfgetospeed(&tty);
+	return 1;
+
+#endif
+
+}
+
+static int serialPortExtInit(serial_port_t* serialPort)
 {
 	serialPort->pfnClose = serialPortClosePlatform;
 	serialPort->pfnFlush = serialPortFlushPlatform;
@@ -710,3 +1262,22 @@ int serialPortPlatformInit(serial_port_t* serialPort)
 	serialPort->pfnSleep = serialPortSleepPlatform;
 	return 0;
 }
+
+int serialPortPlatformAdopt(serial_port_t* serialPort, int baudRate)
+{
+	if (serialPort == 0)
+	{
+		return 0;
+	}
+	if (serialPort->pfnOpen == serialPortOpenPlatform)
+	{
+		return serialPort->handle != 0;
+	}
+
+	char port[MAX_SERIAL_PORT_NAME_LENGTH + 1];
+	memcpy(port, serialPort->port, sizeof(port));
+	port[MAX_SERIAL_PORT_NAME_LENGTH] = '\0';
+	serialPortClose(serialPort);
+	serialPortExtInit(serialPort);
+	return serialPortOpen(serialPort, port, baudRate, 0);
+}
@@ -0,0 +1,76 @@
+/*
+MIT LICENSE
+
+Copyright 2014 Inertial Sense, LLC - http://inertialsense.com
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files(the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions :
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef __IS_SERIALPORT_EXT_H
+#define __IS_SERIALPORT_EXT_H
+
+#include "serialPort.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	// Extensions to the SDK serial port layer (fd access, bulk reads, low latency mode, async reads that
+	// complete as data arrives).  InertialSense::Open opens its ports through the SDK's own platform layer;
+	// hand each of them to this one with serialPortPlatformAdopt before using any of the calls below, which
+	// fail (or return -1) on a port this layer did not open.
+	//
+	// serialPortReadTimeoutAsync on an adopted port (Linux / Apple): reads are queued in order and completed
+	// on a worker thread as data arrives, several may be outstanding at once; closing the port completes any
+	// still pending with errorCode ECANCELED.  A completion may close the port itself, the rest are then
+	// cancelled once it returns.  Don't mix synchronous and asynchronous reads on the same port while async
+	// reads are pending.
+
+	// re-open a port the SDK opened (same name, baudRate) through this layer, applying the current options.
+	// Does nothing to a port this layer already owns
+	// returns 1 if the port is open through this layer, 0 if it could not be re-opened
+	int serialPortPlatformAdopt(serial_port_t* serialPort, int baudRate);
+
+#define SERIAL_PORT_OPTION_LOW_LATENCY 0x00000001
+
+	// options (SERIAL_PORT_OPTION_*) applied to every port opened (or adopted) after this call
+	// SERIAL_PORT_OPTION_LOW_LATENCY (Linux): set ASYNC_LOW_LATENCY, ask USB-serial adapters for a
+	// 1 ms latency timer, and set every rate above 921600 through termios2 / BOTHER
+	void serialPortPlatformSetOptions(int options);
+
+	// effective configuration of an open port
+	typedef struct
+	{
+		int baudRate;				// baud rate the driver is running at
+		int customBaud;				// 1 if set through termios2 / BOTHER instead of a Bxxx constant
+		int lowLatency;				// 1 if ASYNC_LOW_LATENCY is set
+		int latencyTimerMs;			// USB-serial adapter latency timer, -1 if the adapter has none (or it can't be read)
+	} serial_port_latency_info_t;
+
+	// returns 1 if success, 0 if the port is not open or can't be queried
+	int serialPortGetLatencyInfo(serial_port_t* serialPort, serial_port_latency_info_t* info);
+
+	// get the file descriptor backing an open serial port so it can be waited on with poll/epoll
+	// returns -1 if the port is not open or the platform does not use file descriptors
+	int serialPortGetFileDescriptor(serial_port_t* serialPort);
+
+	// bytes already pulled from the driver into the port's read-ahead buffer.  poll() on the file
+	// descriptor can't see these, so don't wait on it while this is non-zero
+	int serialPortGetReadAheadCount(serial_port_t* serialPort);
+
+	// read everything the driver has buffered (up to bufferSize) with a single syscall, waiting up to
+	// timeoutMilliseconds for data if nothing is buffered yet
+	// arrivalTimeNs (optional) receives the CLOCK_MONOTONIC time in nanoseconds the bytes were pulled from the driver
+	// returns number of bytes read, 0 if nothing arrived, -1 on error
+	int serialPortReadBulk(serial_port_t* serialPort, unsigned char* buffer, int bufferSize, int timeoutMilliseconds, uint64_t* arrivalTimeNs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __IS_SERIALPORT_EXT_H
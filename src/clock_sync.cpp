@@ -0,0 +1,239 @@
+#include "clock_sync.h"
+
+#include <math.h>
+#include <stdio.h>
+
+#include <algorithm>
+
+static const double MAX_SKEW = 500e-6; // well beyond any crystal, anything more is a bad fit
+static const size_t MIN_FIT_BINS = 8;  // fewer minima than this give a poor skew
+
+ClockSkewEstimator::ClockSkewEstimator(double bin_s, int bins) :
+  bin_s_(bin_s), bins_(std::max(bins, 2)), fit_x_(bins_.size()), fit_y_(bins_.size()), fit_r_(bins_.size()),
+  fit_sorted_(bins_.size()), seed_skew_(0.0), seeded_line_(false),
+  seed_x_(0.0), seed_y_(0.0), resets_(0)
+{
+  reset();
+  reset_residuals();
+}
+
+void ClockSkewEstimator::reset()
+{
+  valid_ = false;
+  head_ = 0;
+  count_ = 0;
+  a_ = xm_ = 0.0;
+  skew_ = seed_skew_;
+}
+
+void ClockSkewEstimator::reset_residuals()
+{
+  residual_count_ = 0;
+  residual_mean_ = residual_m2_ = 0.0;
+}
+
+double ClockSkewEstimator::residual_stddev() const
+{
+  return residual_count_ > 1 ? sqrt(residual_m2_ / (residual_count_ - 1)) : 0.0;
+}
+
+void ClockSkewEstimator::seed(double device_s, double host_s, double skew)
+{
+  seed_skew_ = std::min(std::max(skew, -MAX_SKEW), MAX_SKEW);
+  seed_x_ = device_s;
+  seed_y_ = host_s - device_s;
+  seeded_line_ = true;
+  if (!valid_)
+    skew_ = seed_skew_;
+}
+
+double ClockSkewEstimator::to_host(double device_s) const
+{
+  return device_s + y0_ + a_ + skew_ * (device_s - x0_ - xm_);
+}
+
+double ClockSkewEstimator::update(double device_s, double host_s)
+{
+  if (valid_)
+  {
+    double x = device_s - x0_;
+    double y = (host_s - device_s) - y0_;
+    double residual = y - (a_ + skew_ * (x - xm_));
+    if (x < last_x_ - 1.0 || residual < -CAUSALITY_TOLERANCE_S)
+    {
+      // device rebooted, or one of the clocks was stepped
+      resets_++;
+      reset();
+    }
+    else
+    {
+      if (x > last_x_)
+        last_x_ = x;
+
+      int64_t bin = (int64_t)floor(x / bin_s_);
+      if (bin > bin_index_)
+      {
+        close_bin();
+        bin_index_ = bin;
+        bin_min_.x = x;
+        bin_min_.y = y;
+      }
+      else if (y < bin_min_.y)
+      {
+        bin_min_.x = x;
+        bin_min_.y = y;
+      }
+
+      // not enough bins to fit yet: follow the running minimum along the (seeded) skew
+      if (count_ < MIN_FIT_BINS)
+      {
+        double a = y - skew_ * (x - xm_);
+        if (a < a_)
+        {
+          a_ = a;
+          residual = 0.0;
+        }
+      }
+
+      residual_count_++;
+      double delta = residual - residual_mean_;
+      residual_mean_ += delta / residual_count_;
+      residual_m2_ += delta * (residual - residual_mean_);
+      return to_host(device_s);
+    }
+  }
+
+  // first sample: everything is relative to it
+  valid_ = true;
+  x0_ = device_s;
+  y0_ = host_s - device_s;
+  last_x_ = 0.0;
+  bin_index_ = 0;
+  bin_min_.x = bin_min_.y = 0.0;
+  xm_ = 0.0;
+  a_ = 0.0;
+  if (seeded_line_)
+  {
+    // the line from the last run still holds if this sample arrived just above it
+    double predicted = seed_y_ + seed_skew_ * (device_s - seed_x_);
+    double residual = y0_ - predicted;
+    if (residual > -CAUSALITY_TOLERANCE_S && residual < SEED_TOLERANCE_S)
+      a_ = predicted - y0_;
+    seeded_line_ = false;
+  }
+  return to_host(device_s);
+}
+
+void ClockSkewEstimator::close_bin()
+{
+  bins_[head_] = bin_min_;
+  head_ = (head_ + 1) % bins_.size();
+  if (count_ < bins_.size())
+    count_++;
+  if (count_ >= MIN_FIT_BINS)
+    fit();
+}
+
+// least squares line through (x, y), returns false if the points don't span any device time
+static bool fit_line(const double* x, const double* y, size_t n, double& xm, double& ym, double& slope)
+{
+  xm = ym = 0.0;
+  for (size_t i = 0; i < n; i++)
+  {
+    xm += x[i];
+    ym += y[i];
+  }
+  xm /= n;
+  ym /= n;
+  double sxx = 0.0, sxy = 0.0;
+  for (size_t i = 0; i < n; i++)
+  {
+    sxx += (x[i] - xm) * (x[i] - xm);
+    sxy += (x[i] - xm) * (y[i] - ym);
+  }
+  if (sxx <= 0.0)
+    return false;
+  slope = sxy / sxx;
+  return true;
+}
+
+void ClockSkewEstimator::fit()
+{
+  size_t n = count_;
+  for (size_t i = 0; i < n; i++)
+  {
+    fit_x_[i] = bins_[i].x;
+    fit_y_[i] = bins_[i].y;
+  }
+
+  double xm, ym, slope;
+  if (!fit_line(fit_x_.data(), fit_y_.data(), n, xm, ym, slope))
+    return;
+
+  // keep the lower half of the minima, the ones closest to the latency floor, and refit
+  for (size_t i = 0; i < n; i++)
+    fit_r_[i] = fit_sorted_[i] = fit_y_[i] - (ym + slope * (fit_x_[i] - xm));
+  std::nth_element(fit_sorted_.begin(), fit_sorted_.begin() + n / 2, fit_sorted_.begin() + n);
+  double median = fit_sorted_[n / 2];
+  size_t kept = 0;
+  for (size_t i = 0; i < n; i++)
+  {
+    if (fit_r_[i] <= median)
+    {
+      fit_x_[kept] = fit_x_[i];
+      fit_y_[kept] = fit_y_[i];
+      kept++;
+    }
+  }
+  if (kept >= 2)
+    fit_line(fit_x_.data(), fit_y_.data(), kept, xm, ym, slope);
+
+  xm_ = xm;
+  a_ = ym;
+  skew_ = std::min(std::max(slope, -MAX_SKEW), MAX_SKEW);
+}
+
+TimeHandover::TimeHandover(double slew_rate, double max_slew_s) :
+  slew_rate_(slew_rate), max_slew_s_(max_slew_s), started_(false), correction_(0.0), last_gps_s_(0.0)
+{}
+
+double TimeHandover::correction(double gps_s, double estimate_s)
+{
+  if (!started_)
+  {
+    started_ = true;
+    last_gps_s_ = gps_s;
+    correction_ = estimate_s - gps_s;
+    if (fabs(correction_) > max_slew_s_)
+      correction_ = 0.0;
+    return correction_;
+  }
+
+  // shrink the correction by at most slew_rate per second of GPS time, so stamps never go backwards
+  if (gps_s > last_gps_s_)
+  {
+    double step = slew_rate_ * (gps_s - last_gps_s_);
+    correction_ = correction_ > 0.0 ? std::max(0.0, correction_ - step) : std::min(0.0, correction_ + step);
+    last_gps_s_ = gps_s;
+  }
+  return correction_;
+}
+
+bool clock_sync_load(const std::string& path, clock_sync_state_t& state)
+{
+  FILE* file = fopen(path.c_str(), "r");
+  if (file == NULL)
+    return false;
+  int n = fscanf(file, "skew %lf\ndevice_time %lf\nhost_time %lf", &state.skew, &state.device_s, &state.host_s);
+  fclose(file);
+  return n == 3;
+}
+
+bool clock_sync_save(const std::string& path, const clock_sync_state_t& state)
+{
+  FILE* file = fopen(path.c_str(), "w");
+  if (file == NULL)
+    return false;
+  int n = fprintf(file, "skew %.12g\ndevice_time %.9f\nhost_time %.9f\n", state.skew, state.device_s, state.host_s);
+  return (fclose(file) == 0) && n > 0;
+}
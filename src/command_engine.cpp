@@ -0,0 +1,133 @@
+#include "command_engine.h"
+
+#include <algorithm>
+
+CommandEngine::CommandEngine(std::function<void()> wake) :
+  wake_(wake), waiting_(DID_COUNT, 0)
+{}
+
+std::future<CommandEngine::result_t> CommandEngine::submit(const command_t& command)
+{
+  std::unique_ptr<pending_t> pending(new pending_t);
+  pending->command = command;
+  pending->submitted = steady_t::now();
+  pending->deadline = pending->submitted + std::chrono::duration_cast<steady_t::duration>(
+                        std::chrono::duration<double>(command.timeout_s));
+  pending->next_write = pending->submitted;
+  pending->attempts = 0;
+  std::future<result_t> future = pending->promise.get_future();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    submitted_.push_back(std::move(pending));
+  }
+  if (wake_)
+    wake_();
+  return future;
+}
+
+void CommandEngine::complete(pending_t& pending, const p_data_t* data, bool success)
+{
+  result_t result;
+  result.success = success;
+  result.attempts = pending.attempts;
+  result.elapsed_s = std::chrono::duration<double>(steady_t::now() - pending.submitted).count();
+  result.hdr = p_data_hdr_t();
+  if (data != NULL)
+  {
+    result.hdr = data->hdr;
+    result.data.assign(data->buf, data->buf + data->hdr.size);
+  }
+  if (pending.command.match && pending.command.did < waiting_.size())
+    waiting_[pending.command.did]--;
+  pending.promise.set_value(result);
+}
+
+void CommandEngine::take_submitted()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto it = submitted_.begin(); it != submitted_.end(); ++it)
+  {
+    if ((*it)->command.match && (*it)->command.did < waiting_.size())
+      waiting_[(*it)->command.did]++;
+  }
+  pending_.splice(pending_.end(), submitted_);
+}
+
+void CommandEngine::service()
+{
+  take_submitted();
+
+  steady_t::time_point now = steady_t::now();
+  for (auto it = pending_.begin(); it != pending_.end();)
+  {
+    pending_t& pending = **it;
+    if (pending.attempts > 0 && now >= pending.deadline)
+    {
+      complete(pending, NULL, false);
+      it = pending_.erase(it);
+      continue;
+    }
+    if (now >= pending.next_write && (pending.attempts == 0 || pending.command.retry_s > 0.0))
+    {
+      if (pending.command.write)
+        pending.command.write();
+      pending.attempts++;
+      pending.next_write = now + std::chrono::duration_cast<steady_t::duration>(
+                             std::chrono::duration<double>(pending.command.retry_s));
+      if (!pending.command.match)
+      {
+        complete(pending, NULL, true);
+        it = pending_.erase(it);
+        continue;
+      }
+    }
+    ++it;
+  }
+}
+
+void CommandEngine::on_data(const p_data_t* data)
+{
+  if (!waiting_for(data->hdr.id))
+    return;
+  for (auto it = pending_.begin(); it != pending_.end();)
+  {
+    pending_t& pending = **it;
+    if (pending.attempts > 0 && pending.command.match && pending.command.did == data->hdr.id && pending.command.match(data))
+    {
+      complete(pending, data, true);
+      it = pending_.erase(it);
+    }
+    else
+      ++it;
+  }
+}
+
+int CommandEngine::next_timeout_ms() const
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!submitted_.empty())
+      return 0;
+  }
+  if (pending_.empty())
+    return -1;
+
+  steady_t::time_point next = steady_t::time_point::max();
+  for (auto it = pending_.begin(); it != pending_.end(); ++it)
+  {
+    next = std::min(next, (*it)->deadline);
+    if ((*it)->command.retry_s > 0.0)
+      next = std::min(next, (*it)->next_write);
+  }
+  // round up, waking a little late is fine but early would just go back to sleep
+  auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(next - steady_t::now()).count() + 1;
+  return (int)std::max<int64_t>(ms, 0);
+}
+
+void CommandEngine::cancel_all()
+{
+  take_submitted();
+  for (auto it = pending_.begin(); it != pending_.end(); ++it)
+    complete(**it, NULL, false);
+  pending_.clear();
+}
@@ -0,0 +1,64 @@
+#include "flash_config.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+#include <type_traits>
+
+template <typename T>
+static void store_as(double value, uint8_t* dst)
+{
+  T v = std::is_integral<T>::value ? (T)llround(value) : (T)value;
+  memcpy(dst, &v, sizeof(v));
+}
+
+// element type, count and size are taken from the struct, so a table entry can't disagree with it
+#define FLASH_ELEMENT(field) std::remove_extent<decltype(((nvm_flash_cfg_t*)0)->field)>::type
+#define FLASH_FIELD(param, field, default_value) \
+  { param, offsetof(nvm_flash_cfg_t, field), \
+    sizeof(((nvm_flash_cfg_t*)0)->field) / sizeof(FLASH_ELEMENT(field)), sizeof(FLASH_ELEMENT(field)), \
+    &store_as<FLASH_ELEMENT(field)>, default_value }
+
+const flash_field_t FLASH_FIELDS[] =
+{
+  FLASH_FIELD("INS_rpy_radians", insRotation, 0.0),
+  FLASH_FIELD("INS_xyz", insOffset, 0.0),
+  FLASH_FIELD("GPS_ant1_xyz", gps1AntOffset, 0.0),
+  FLASH_FIELD("GPS_ant2_xyz", gps2AntOffset, 0.0),
+  FLASH_FIELD("GPS_ref_lla", refLla, 0.0),
+  FLASH_FIELD("inclination", magInclination, 0.0),
+  FLASH_FIELD("declination", magDeclination, 0.0),
+  FLASH_FIELD("dynamic_model", insDynModel, 8),
+  FLASH_FIELD("ser1_baud_rate", ser1BaudRate, 921600),
+};
+const size_t FLASH_FIELD_COUNT = sizeof(FLASH_FIELDS) / sizeof(FLASH_FIELDS[0]);
+
+std::vector<flash_write_t> flash_config_diff(const void* current, const void* target, size_t size, uint32_t max_gap)
+{
+  const uint8_t* a = static_cast<const uint8_t*>(current);
+  const uint8_t* b = static_cast<const uint8_t*>(target);
+  std::vector<flash_write_t> writes;
+  for (uint32_t i = 0; i < size; i++)
+  {
+    if (a[i] == b[i])
+      continue;
+    if (!writes.empty() && i - (writes.back().offset + writes.back().size) < max_gap)
+      writes.back().size = i + 1 - writes.back().offset;
+    else
+      writes.push_back({ i, 1 });
+  }
+
+  // whole 32-bit words, so no field is written in pieces, joining ranges that then touch
+  std::vector<flash_write_t> words;
+  for (size_t i = 0; i < writes.size(); i++)
+  {
+    uint32_t start = writes[i].offset & ~3u;
+    uint32_t end = std::min<uint32_t>((writes[i].offset + writes[i].size + 3) & ~3u, size);
+    if (!words.empty() && words.back().offset + words.back().size >= start)
+      words.back().size = end - words.back().offset;
+    else
+      words.push_back({ start, end - start });
+  }
+  return words;
+}
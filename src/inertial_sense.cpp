@@ -1,29 +1,167 @@
 #include "inertial_sense.h"
+#include <array>
 #include <chrono>
+#include <iomanip>
+#include <sstream>
 #include <stddef.h>
+#include <string.h>
+#include <errno.h>
 #include <unistd.h>
-#include <tf/tf.h>
+#include <poll.h>
 #include <ros/console.h>
 
-InertialSenseROS::InertialSenseROS() :
-  nh_(), nh_private_("~"), initialized_(false)
+// whether a data set carries bytes [offset, offset + size) of its DID
+static bool data_covers(const p_data_t* data, uint32_t offset, uint32_t size)
 {
-  connect();
-  set_navigation_dt_ms();
+  return data->hdr.offset <= offset && data->hdr.offset + data->hdr.size >= offset + size;
+}
+
+InertialSenseROS::InertialSenseROS(const ros::NodeHandle& nh, const ros::NodeHandle& nh_private, bool connect_to_device) :
+  nh_(nh), nh_private_(nh_private), initialized_(false), device_connected_(connect_to_device), publish_ns_(0),
+  device_(0), shared_connection_(false), owned_IS_(new InertialSense()), IS_(*owned_IS_)
+{
+  init();
+}
+
+InertialSenseROS::InertialSenseROS(const ros::NodeHandle& nh, const ros::NodeHandle& nh_private, InertialSense& shared,
+                                   int device, broadcast_request_t request_broadcast,
+                                   std::shared_ptr<tf2_ros::StaticTransformBroadcaster> static_br) :
+  nh_(nh), nh_private_(nh_private), initialized_(false), device_connected_(true), publish_ns_(0),
+  device_(device), shared_connection_(true), request_broadcast_(request_broadcast), IS_(shared)
+{
+  static_br_ = static_br;
+  init();
+}
+
+InertialSenseROS::InertialSenseROS(const ros::NodeHandle& nh, const XmlRpc::XmlRpcValue& params, message_sink_t sink) :
+  nh_(nh), nh_private_(nh), initialized_(false), device_connected_(false), publish_ns_(0), offline_(true),
+  offline_params_(params), offline_sink_(sink), device_(0), shared_connection_(false), owned_IS_(new InertialSense()),
+  IS_(*owned_IS_)
+{
+  init();
+}
+
+bool InertialSenseROS::from_xmlrpc(XmlRpc::XmlRpcValue& xml, bool& value)
+{
+  if (xml.getType() != XmlRpc::XmlRpcValue::TypeBoolean)
+    return false;
+  value = (bool)xml;
+  return true;
+}
+
+bool InertialSenseROS::from_xmlrpc(XmlRpc::XmlRpcValue& xml, int& value)
+{
+  if (xml.getType() != XmlRpc::XmlRpcValue::TypeInt)
+    return false;
+  value = (int)xml;
+  return true;
+}
+
+bool InertialSenseROS::from_xmlrpc(XmlRpc::XmlRpcValue& xml, double& value)
+{
+  // as getParam(), a whole number will do
+  if (xml.getType() == XmlRpc::XmlRpcValue::TypeInt)
+    value = (int)xml;
+  else if (xml.getType() == XmlRpc::XmlRpcValue::TypeDouble)
+    value = (double)xml;
+  else
+    return false;
+  return true;
+}
+
+bool InertialSenseROS::from_xmlrpc(XmlRpc::XmlRpcValue& xml, std::string& value)
+{
+  if (xml.getType() != XmlRpc::XmlRpcValue::TypeString)
+    return false;
+  value = (std::string)xml;
+  return true;
+}
 
-  /// Start Up ROS service servers
-  refLLA_set_current_srv_ = nh_.advertiseService("set_refLLA_current", &InertialSenseROS::set_current_position_as_refLLA, this);
-  refLLA_set_value_srv_ = nh_.advertiseService("set_refLLA_value", &InertialSenseROS::set_refLLA_to_value, this);
-  mag_cal_srv_ = nh_.advertiseService("single_axis_mag_cal", &InertialSenseROS::perform_mag_cal_srv_callback, this);
-  multi_mag_cal_srv_ = nh_.advertiseService("multi_axis_mag_cal", &InertialSenseROS::perform_multi_mag_cal_srv_callback, this);
-  firmware_update_srv_ = nh_.advertiseService("firmware_update", &InertialSenseROS::update_firmware_srv_callback, this);
+void InertialSenseROS::init()
+{
+  // All of our callbacks go through callback_queue_ so spin() can sleep on it together with the serial port
+  nh_.setCallbackQueue(&callback_queue_);
+  nh_private_.setCallbackQueue(&callback_queue_);
+  param<int>("idle_timeout_ms", idle_timeout_ms_, 100);
+  param<bool>("did_stats", did_stats_enabled_, true);
+  param<double>("reset_timeout", reset_timeout_, 5.0);
+  param<bool>("reconnect", reconnect_enabled_, true);
+  param<double>("stall_timeout", stall_timeout_, 2.0);
+  param<double>("reconnect_backoff_min", reconnect_backoff_min_, 0.1);
+  param<double>("reconnect_backoff_max", reconnect_backoff_max_, 5.0);
+  reconnect_backoff_max_ = std::max(reconnect_backoff_max_, reconnect_backoff_min_);
+  if (offline_)
+    did_stats_enabled_ = false;  // nothing to report them to
+  // connect() / attach() read it with the port settings, a replay or offline conversion has neither
+  if (!device_connected_)
+    param<std::string>("frame_id", frame_id_, "body");
+
+  // per-phase startup timing, logged at the end
+  std::vector<std::pair<const char*, double>> phases;
+  std::chrono::steady_clock::time_point startup = std::chrono::steady_clock::now(), phase_start = startup;
+  auto phase_done = [&phases, &phase_start](const char* name)
+  {
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    phases.push_back(std::make_pair(name, std::chrono::duration<double>(now - phase_start).count()));
+    phase_start = now;
+  };
 
-  configure_parameters();
+  if (device_connected_)
+  {
+    if (shared_connection_)
+      attach();
+    else
+      connect();
+    start_pipeline();
+    load_time_sync();
+    phase_done("connect");
+
+    /// Start Up ROS service servers
+    // the ones waiting on the uINS get their own thread, see commands_
+    ros::NodeHandle service_nh(nh_);
+    service_nh.setCallbackQueue(&service_queue_);
+    refLLA_set_current_srv_ = service_nh.advertiseService("set_refLLA_current", &InertialSenseROS::set_current_position_as_refLLA, this);
+    refLLA_set_value_srv_ = service_nh.advertiseService("set_refLLA_value", &InertialSenseROS::set_refLLA_to_value, this);
+    mag_cal_srv_ = service_nh.advertiseService("single_axis_mag_cal", &InertialSenseROS::perform_mag_cal_srv_callback, this);
+    multi_mag_cal_srv_ = service_nh.advertiseService("multi_axis_mag_cal", &InertialSenseROS::perform_multi_mag_cal_srv_callback, this);
+    service_spinner_.reset(new ros::AsyncSpinner(1, &service_queue_));
+    service_spinner_->start();
+    // flash configuration echoes answer commands, route them to dispatch() without streaming them
+    set_callback(DID_FLASH_CONFIG, [](const p_data_t* data) { (void)data; }, -1);
+    // bootloading closes and re-opens every port of the connection, so it's only offered for a single device
+    if (!shared_connection_)
+      firmware_update_srv_ = nh_.advertiseService("firmware_update", &InertialSenseROS::update_firmware_srv_callback, this);
+
+    configure_parameters();
+    set_navigation_dt_ms();
+  }
   configure_rtk();
+  if (device_connected_)
+  {
+    // all flash changes go out together, then a navigation rate change resets the uINS.  Data from
+    // a shared connection only reaches us once the hub has us, so it runs the reset itself.
+    flash_commit();
+    if (reset_pending() && !shared_connection_)
+      begin_reset();
+  }
+  phase_done("configure");
+
+  // the ROS side is set up while the uINS reboots, the stream requests it misses are repeated below
   configure_data_streams();
+  if (did_stats_enabled_)
+    did_stats_srv_ = nh_.advertiseService("dump_did_stats", &InertialSenseROS::dump_did_stats_srv_callback, this);
+  phase_done("streams");
 
-  nh_private_.param<bool>("enable_log", log_enabled_, false);
-  if (log_enabled_)
+  if (device_connected_ && reset_pending() && !shared_connection_)
+  {
+    finish_reset();
+    phase_done("reset");
+  }
+
+  // the SDK's logger records every port of the connection, so a shared connection logs from InertialSenseHub
+  param<bool>("enable_log", log_enabled_, false);
+  param<std::string>("log_type", log_type_, "dat");
+  if (log_enabled_ && device_connected_ && (!shared_connection_ || log_type_ == "raw"))
   {
     start_log();//start log should always happen last, does not all stop all message streams.
   }
@@ -31,113 +169,555 @@ InertialSenseROS::InertialSenseROS() :
 
 //  configure_ascii_output(); //does not work right now
 
+  phase_done("log");
+  last_rx_ns_ = did_stats_now_ns();
+  std::ostringstream timing;
+  for (size_t i = 0; i < phases.size(); i++)
+    timing << (i ? ", " : "") << phases[i].first << " " << std::fixed << std::setprecision(1) << phases[i].second * 1e3 << " ms";
+  ROS_INFO_COND(!offline_, "inertialsense: started in %.1f ms (%s)",
+           std::chrono::duration<double>(std::chrono::steady_clock::now() - startup).count() * 1e3, timing.str().c_str());
+
   initialized_ = true;
 }
 
+InertialSenseROS::~InertialSenseROS()
+{
+  // whoever ran the connection has stopped, so fail what's pending instead of letting services time out
+  commands_.cancel_all();
+  if (service_spinner_)
+    service_spinner_->stop();
+  save_time_sync();
+  // the log's tap sits on top of the pipeline's, and the reader thread uses the serial port owned
+  // by IS_, so both have to go first
+  if (log_writer_)
+    log_writer_->stop();
+  if (pipeline_)
+    pipeline_->stop();
+}
+
+void InertialSenseROS::set_callback(uint32_t did, did_callback_t callback, int period_multiple)
+{
+  if (did >= DID_COUNT)
+    return;
+  did_callbacks_[did] = callback;
+  broadcast_period_[did] = period_multiple;
+  if (did_stats_enabled_ && !did_stats_[did])
+    did_stats_[did].reset(new DidStats());
+  if (request_broadcast_)
+  {
+    // the owner of the shared connection routes this DID back to us by device index
+    request_broadcast_(did, period_multiple, device_);
+  }
+  else if (device_connected_)
+  {
+    IS_.BroadcastBinaryData(did, period_multiple, [this](InertialSense*i, p_data_t* data, int pHandle)
+    {
+      this->dispatch(data);
+    });
+  }
+}
+
+void InertialSenseROS::set_decimation(uint32_t did, int decimation)
+{
+  if (did >= DID_COUNT)
+    return;
+  decimation_[did] = decimation;
+  decimation_count_[did] = 0;
+}
+
+int InertialSenseROS::stream_period_multiple(const std::string& stream, int default_multiple)
+{
+  int period_multiple;
+  param<int>("period_multiple_" + stream, period_multiple, default_multiple);
+  return std::max(period_multiple, 1);
+}
+
+int InertialSenseROS::stream_decimation(const std::string& stream)
+{
+  int decimation;
+  param<int>("decimate_" + stream, decimation, 1);
+  return std::max(decimation, 1);
+}
+
+void InertialSenseROS::dispatch(const p_data_t* data)
+{
+  const uint32_t did = data->hdr.id;
+  if (did >= DID_COUNT)
+    return;
+  last_rx_ns_ = did_stats_now_ns();
+  if (connection_state_ == CONNECTION_RECOVERING)
+  {
+    connection_state_ = CONNECTION_UP;
+    reconnects_++;
+    last_recovery_s_ = (last_rx_ns_ - disconnected_ns_) * 1e-9;
+    ROS_INFO("inertialsense: connection to \"%s\" recovered in %.3f s (%d attempt(s))", port_.c_str(), last_recovery_s_, reconnect_attempts_);
+  }
+  if (commands_.waiting_for(did))
+    commands_.on_data(data);
+  if (!did_callbacks_[did] || did_paused_[did])
+    return;  // paused: data sets still in flight when the stream was stopped
+
+  DidStats* stats = did_stats_[did].get();
+  if (decimation_[did] > 1 && ++decimation_count_[did] < decimation_[did])
+  {
+    if (stats)
+      stats->record_arrival((pipeline_ && pipeline_->running()) ? pipeline_->last_arrival_ns() : did_stats_now_ns());
+    return;
+  }
+  decimation_count_[did] = 0;
+
+  if (stats == NULL)
+  {
+    did_callbacks_[did](data);
+    return;
+  }
+
+  uint64_t start = did_stats_now_ns();
+  publish_ns_ = 0;
+  did_callbacks_[did](data);
+  uint64_t elapsed = did_stats_now_ns() - start;
+
+  // with the pipeline we know when the bytes actually came off the port
+  uint64_t arrival = (pipeline_ && pipeline_->running()) ? pipeline_->last_arrival_ns() : start;
+  stats->record(arrival, elapsed - publish_ns_, publish_ns_);
+}
+
+bool InertialSenseROS::dump_did_stats_srv_callback(inertial_sense::DumpDidStats::Request& req, inertial_sense::DumpDidStats::Response& res)
+{
+  res.bucket_lower_ns.resize(DurationHistogram::BUCKETS);
+  for (int i = 0; i < DurationHistogram::BUCKETS; i++)
+    res.bucket_lower_ns[i] = DurationHistogram::bucket_lower_bound(i);
+
+  for (uint32_t did = 0; did < DID_COUNT; did++)
+  {
+    DidStats* stats = did_stats_[did].get();
+    if (stats == NULL)
+      continue;
+
+    inertial_sense::DidStats s;
+    s.did = did;
+    s.name = cISDataMappings::GetDataSetName(did);
+    s.count = stats->count;
+    s.rate = stats->rate_hz();
+    s.interval_mean = stats->interval_mean_s;
+    s.jitter = stats->jitter_s();
+    s.interval_hist.assign(stats->interval.buckets, stats->interval.buckets + DurationHistogram::BUCKETS);
+    s.convert_hist.assign(stats->convert.buckets, stats->convert.buckets + DurationHistogram::BUCKETS);
+    s.publish_hist.assign(stats->publish.buckets, stats->publish.buckets + DurationHistogram::BUCKETS);
+    s.interval_max_ns = stats->interval.max_ns;
+    s.convert_max_ns = stats->convert.max_ns;
+    s.publish_max_ns = stats->publish.max_ns;
+    res.stats.push_back(s);
+
+    if (req.reset)
+      stats->reset();
+  }
+  return true;
+}
+
+void InertialSenseROS::did_stats_diagnostics(diagnostic_msgs::DiagnosticArray& diag_array)
+{
+  for (uint32_t did = 0; did < DID_COUNT; did++)
+  {
+    DidStats* stats = did_stats_[did].get();
+    if (stats == NULL || stats->count == 0)
+      continue;
+
+    diagnostic_msgs::DiagnosticStatus status;
+    status.name = std::string("DID ") + cISDataMappings::GetDataSetName(did);
+    status.level = diagnostic_msgs::DiagnosticStatus::OK;
+    status.message = did_paused_[did] ? "paused, no subscribers" : std::to_string(stats->rate_hz()) + " Hz";
+
+    diagnostic_msgs::KeyValue kv;
+    kv.key = "Count";
+    kv.value = std::to_string(stats->count);
+    status.values.push_back(kv);
+    kv.key = "Rate (Hz)";
+    kv.value = std::to_string(stats->rate_hz());
+    status.values.push_back(kv);
+    kv.key = "Jitter (ms)";
+    kv.value = std::to_string(stats->jitter_s() * 1e3);
+    status.values.push_back(kv);
+    kv.key = "Max Interval (ms)";
+    kv.value = std::to_string(stats->interval.max_ns * 1e-6);
+    status.values.push_back(kv);
+    kv.key = "Convert p50 / p99 / max (us)";
+    kv.value = std::to_string(stats->convert.percentile(0.5) * 1e-3) + " / " + std::to_string(stats->convert.percentile(0.99) * 1e-3)
+             + " / " + std::to_string(stats->convert.max_ns * 1e-3);
+    status.values.push_back(kv);
+    kv.key = "Publish p50 / p99 / max (us)";
+    kv.value = std::to_string(stats->publish.percentile(0.5) * 1e-3) + " / " + std::to_string(stats->publish.percentile(0.99) * 1e-3)
+             + " / " + std::to_string(stats->publish.max_ns * 1e-3);
+    status.values.push_back(kv);
+    diag_array.status.push_back(status);
+  }
+}
 
 void InertialSenseROS::configure_data_streams()
 {
-  SET_CALLBACK(DID_GPS1_POS, gps_pos_t, GPS_pos_callback,1); // we always need GPS for Fix status
-  SET_CALLBACK(DID_GPS1_VEL, gps_vel_t, GPS_vel_callback,1); // we always need GPS for Fix status
+  // Each stream asks the uINS for its data sets every period_multiple_<stream> base periods, and
+  // can publish only every decimate_<stream>-th of them, for streams that are sampled fast on the
+  // device but consumed slower.  GPS defaults to full rate because it drives time sync.
+  // With lazy_streams, the streams that only feed topics are stopped while nothing subscribes to
+  // them.  The log only records what the uINS sends, so logging turns that off by default.
+  bool log_requested;
+  param<bool>("enable_log", log_requested, false);
+  param<bool>("lazy_streams", lazy_streams_, !log_requested);
+  lazy_streams_ = lazy_streams_ && device_connected_;
+  lazy_status_cb_ = [this](const ros::SingleSubscriberPublisher& pub) { (void)pub; update_lazy_streams(); };
+
+  int gps_period = stream_period_multiple("GPS", 1);
+  SET_CALLBACK(DID_GPS1_POS, gps_pos_t, GPS_pos_callback, gps_period); // we always need GPS for Fix status
+  SET_CALLBACK(DID_GPS1_VEL, gps_vel_t, GPS_vel_callback, gps_period); // we always need GPS for Fix status
   SET_CALLBACK(DID_STROBE_IN_TIME, strobe_in_time_t, strobe_in_time_callback,1); // we always want the strobe
   
 
-  nh_private_.param<bool>("stream_INS", INS_.enabled, true);
+  param<bool>("stream_INS", INS_.enabled, true);
+  param<int>("LTCF", LTCF, NED);
+  configure_tf();
+  // Set up the IMU ROS stream
+  param<bool>("stream_IMU", IMU_.enabled, true);
+
   if (INS_.enabled)
   {
-    INS_.pub = nh_.advertise<nav_msgs::Odometry>("ins", 1);
-    SET_CALLBACK(DID_INS_1, ins_1_t, INS1_callback, 5);
-    SET_CALLBACK(DID_INS_2, ins_2_t, INS2_callback,5);
-    SET_CALLBACK(DID_DUAL_IMU, dual_imu_t, IMU_callback,1);
+    advertise<nav_msgs::Odometry>(INS_.pub, "ins", 1);
+    // the imu stream used to pull INS up to full rate as well, so that stays the default with it
+    int ins_period = stream_period_multiple("INS", IMU_.enabled ? 1 : 5);
+    SET_CALLBACK(DID_INS_1, ins_1_t, INS1_callback, ins_period);
+    SET_CALLBACK(DID_INS_2, ins_2_t, INS2_callback, ins_period);
+    set_decimation(DID_INS_2, stream_decimation("INS"));  // INS_2 is the one that publishes
 //    SET_CALLBACK(DID_INL2_VARIANCE, nav_dt_ms, inl2_variance_t, INS_variance_callback);
   }
-  nh_private_.param<bool>("publishTf", publishTf, true);
-  nh_private_.param<int>("LTCF", LTCF, NED);
-  // Set up the IMU ROS stream
-  nh_private_.param<bool>("stream_IMU", IMU_.enabled, true);
 
   //std::cout << "\n\n\n\n\n\n\n\n\n\n stream_GPS: " << GPS_.enabled << "\n\n\n\n\n\n\n\n\n\n\n";
-  if (IMU_.enabled)
+  param<bool>("stream_IMU_batch", IMU_batch_.enabled, false);
+  param<bool>("stream_IMU2", imu2_enabled_, IMU_.enabled);
+  param<bool>("stream_IMU_combined", IMU_combined_.enabled, false);
+  // ins also needs the IMU for its angular rates
+  if (IMU_.enabled || imu2_enabled_ || IMU_combined_.enabled || IMU_batch_.enabled || INS_.enabled)
   {
-    IMU_.pub = nh_.advertise<sensor_msgs::Imu>("imu", 1);
-    SET_CALLBACK(DID_INS_1, ins_1_t, INS1_callback,1);
-    SET_CALLBACK(DID_INS_2, ins_2_t, INS2_callback,1);
-    SET_CALLBACK(DID_DUAL_IMU, dual_imu_t, IMU_callback,1);
+    if (IMU_.enabled)
+      advertise_lazy<sensor_msgs::Imu>(IMU_.pub, "imu", 1);
+    if (imu2_enabled_)
+      advertise_lazy<sensor_msgs::Imu>(IMU_.pub2, "imu2", 1);
+    if (IMU_combined_.enabled)
+    {
+      // weight of IMU1 in the blend, IMU2 gets the rest
+      double weight;
+      param<double>("IMU_combined_weight", weight, 0.5);
+      imu_combined_weight_ = (float)std::min(std::max(weight, 0.0), 1.0);
+      advertise_lazy<sensor_msgs::Imu>(IMU_combined_.pub, "imu_combined", 1);
+    }
+    if (IMU_batch_.enabled)
+    {
+      double deadline;
+      param<int>("IMU_batch_size", imu_batch_size_, 10);
+      param<double>("IMU_batch_deadline", deadline, 0.1);
+      imu_batch_size_ = std::max(imu_batch_size_, 1);
+      advertise_lazy<inertial_sense::ImuBatch>(IMU_batch_.pub, "imu_batch", 10);
+      imu_batch_timer_ = nh_.createTimer(ros::Duration(deadline), &InertialSenseROS::IMU_batch_timer_callback, this, true, false);
+      IMU_batch_reset();
+    }
+    int imu_period = stream_period_multiple("IMU", 1);
+    int imu_decimation = stream_decimation("IMU");
+    bool average_imu;
+    param<bool>("average_IMU", average_imu, false);
+    if (average_imu && imu_decimation > 1)
+    {
+      // boxcar average every sample of the window instead of dropping all but one
+      imu_averager_.set_factor(imu_decimation);
+      set_callback(DID_DUAL_IMU, [this](const p_data_t* data)
+        {
+          const dual_imu_t* average = imu_averager_.add(*reinterpret_cast<const dual_imu_t*>(data->buf));
+          if (average)
+            IMU_callback(average);
+        }, imu_period);
+    }
+    else
+    {
+      SET_CALLBACK(DID_DUAL_IMU, dual_imu_t, IMU_callback, imu_period);
+      set_decimation(DID_DUAL_IMU, imu_decimation);
+    }
+    add_lazy_did(DID_DUAL_IMU, imu_period, { &IMU_.pub, &IMU_.pub2, &IMU_combined_.pub, &IMU_batch_.pub }, INS_.enabled);
   }
 
   // Set up the IMU bias ROS stream
-  nh_private_.param<bool>("stream_INL2_states", INL2_states_.enabled, false);
+  param<bool>("stream_INL2_states", INL2_states_.enabled, false);
   if (INL2_states_.enabled)
   {
-    INL2_states_.pub = nh_.advertise<inertial_sense::INL2States>("inl2_states", 1);
-    SET_CALLBACK(DID_INL2_STATES, inl2_states_t, INL2_states_callback);
+    advertise_lazy<inertial_sense::INL2States>(INL2_states_.pub, "inl2_states", 1);
+    int period = stream_period_multiple("INL2_states", 1);
+    SET_CALLBACK(DID_INL2_STATES, inl2_states_t, INL2_states_callback, period);
+    add_lazy_did(DID_INL2_STATES, period, { &INL2_states_.pub });
+    set_decimation(DID_INL2_STATES, stream_decimation("INL2_states"));
   }
 
   // Set up the GPS ROS stream - we always need GPS information for time sync, just don't always need to publish it
-  nh_private_.param<bool>("stream_GPS", GPS_.enabled, true);
+  param<bool>("stream_GPS", GPS_.enabled, true);
   if (GPS_.enabled)
-      GPS_.pub = nh_.advertise<inertial_sense::GPS>("gps", 1);
+      advertise<inertial_sense::GPS>(GPS_.pub, "gps", 1);
 
-  nh_private_.param<bool>("stream_GPS_raw", GPS_obs_.enabled, false);
-  nh_private_.param<bool>("stream_GPS_raw", GPS_eph_.enabled, false);
+  param<bool>("stream_GPS_raw", GPS_obs_.enabled, false);
+  param<bool>("stream_GPS_raw", GPS_eph_.enabled, false);
   if (GPS_obs_.enabled)
   {
-    GPS_obs_.pub = nh_.advertise<inertial_sense::GNSSObsVec>("gps/obs", 50);
-    GPS_eph_.pub = nh_.advertise<inertial_sense::GNSSEphemeris>("gps/eph", 50);
-    GPS_eph_.pub2 = nh_.advertise<inertial_sense::GlonassEphemeris>("gps/geph", 50);
-    SET_CALLBACK(DID_GPS1_RAW, gps_raw_t, GPS_raw_callback,1);
-    SET_CALLBACK(DID_GPS_BASE_RAW, gps_raw_t, GPS_raw_callback,1);
-    SET_CALLBACK(DID_GPS2_RAW, gps_raw_t, GPS_raw_callback,1);
-    obs_bundle_timer_ = nh_.createTimer(ros::Duration(0.001), InertialSenseROS::GPS_obs_bundle_timer_callback, this);
+    // "vector": GNSSObsVec on gps/obs, "epoch": GNSSObsEpoch on gps/obs_epoch, or "both"
+    std::string obs_format;
+    param<std::string>("obs_format", obs_format, "vector");
+    if (obs_format != "vector" && obs_format != "epoch" && obs_format != "both")
+    {
+      ROS_WARN("inertialsense: unknown obs_format \"%s\" (vector|epoch|both), using vector", obs_format.c_str());
+      obs_format = "vector";
+    }
+    obs_vec_enabled_ = (obs_format != "epoch");
+    obs_epoch_enabled_ = (obs_format == "epoch" || obs_format == "both");
+    if (obs_vec_enabled_)
+      advertise<inertial_sense::GNSSObsVec>(GPS_obs_.pub, "gps/obs", 50);
+    if (obs_epoch_enabled_)
+      advertise<inertial_sense::GNSSObsEpoch>(obs_epoch_pub_, "gps/obs_epoch", 50);
+    advertise<inertial_sense::GNSSEphemeris>(GPS_eph_.pub, "gps/eph", 50);
+    advertise<inertial_sense::GlonassEphemeris>(GPS_eph_.pub2, "gps/geph", 50);
+    set_callback(DID_GPS1_RAW, [this](const p_data_t* data)
+      { GPS_raw_callback(reinterpret_cast<const gps_raw_t*>(data->buf), GNSS_RECEIVER_GPS1); }, 1);
+    set_callback(DID_GPS_BASE_RAW, [this](const p_data_t* data)
+      { GPS_raw_callback(reinterpret_cast<const gps_raw_t*>(data->buf), GNSS_RECEIVER_BASE); }, 1);
+    set_callback(DID_GPS2_RAW, [this](const p_data_t* data)
+      { GPS_raw_callback(reinterpret_cast<const gps_raw_t*>(data->buf), GNSS_RECEIVER_GPS2); }, 1);
+
+    for (int i = 0; i < GNSS_RECEIVER_COUNT; i++)
+    {
+      if (obs_vec_enabled_)
+        obs_bundles_[i].msg.obs.reserve(MAX_OBS_PER_BUNDLE);
+      if (obs_epoch_enabled_)
+        gnss_obs_epoch_reserve(obs_bundles_[i].epoch, MAX_OBS_PER_BUNDLE);
+      obs_bundles_[i].count = 0;
+      obs_bundles_[i].total = 0;
+      obs_bundles_[i].started = false;
+      obs_bundles_[i].published = false;
+      obs_bundles_[i].closed = false;
+      obs_bundles_[i].expected = 0;
+      obs_bundles_[i].followups = 0;
+      obs_bundles_[i].dropped = 0;
+    }
+    // by default twice the time a full observation packet takes on the wire, so the deadline
+    // doesn't fire between two packets of an epoch
+    double packet_s = (offsetof(gps_raw_t, data) + MAX_OBSERVATION_COUNT_IN_RTK_MESSAGE * sizeof(obsd_t)) * 10.0 /
+                      (baudrate_ > 0 ? baudrate_ : 921600);
+    double obs_bundle_timeout;
+    param<double>("obs_bundle_timeout", obs_bundle_timeout, std::max(0.01, 2.0 * packet_s));
+    // a deadline per receiver, so one receiver's packets don't hold back another's epoch
+    for (int i = 0; i < GNSS_RECEIVER_COUNT; i++)
+      obs_bundles_[i].deadline = nh_.createTimer(ros::Duration(obs_bundle_timeout),
+                                                 [this, i](const ros::TimerEvent&) { GPS_obs_bundle_timer_callback(i); }, true, false);
   }
 
   // Set up the GPS info ROS stream
-  nh_private_.param<bool>("stream_GPS_info", GPS_info_.enabled, false);
+  param<bool>("stream_GPS_info", GPS_info_.enabled, false);
   if (GPS_info_.enabled)
   {
-    GPS_info_.pub = nh_.advertise<inertial_sense::GPSInfo>("gps/info", 1);
-    SET_CALLBACK(DID_GPS1_SAT, gps_sat_t, GPS_info_callback,1);
+    advertise_lazy<inertial_sense::GPSInfo>(GPS_info_.pub, "gps/info", 1);
+    int period = stream_period_multiple("GPS_info", 1);
+    SET_CALLBACK(DID_GPS1_SAT, gps_sat_t, GPS_info_callback, period);
+    add_lazy_did(DID_GPS1_SAT, period, { &GPS_info_.pub });
+    set_decimation(DID_GPS1_SAT, stream_decimation("GPS_info"));
   }
 
   // Set up the magnetometer ROS stream
-  nh_private_.param<bool>("stream_mag", mag_.enabled, false);
+  param<bool>("stream_mag", mag_.enabled, false);
   if (mag_.enabled)
   {
-    mag_.pub = nh_.advertise<sensor_msgs::MagneticField>("mag", 1);
-    //    mag_.pub2 = nh_.advertise<sensor_msgs::MagneticField>("mag2", 1);
-    SET_CALLBACK(DID_MAGNETOMETER_1, magnetometer_t, mag_callback,1);
+    advertise_lazy<sensor_msgs::MagneticField>(mag_.pub, "mag", 1);
+    //    advertise<sensor_msgs::MagneticField>(mag_.pub2, "mag2", 1);
+    int period = stream_period_multiple("mag", 1);
+    SET_CALLBACK(DID_MAGNETOMETER_1, magnetometer_t, mag_callback, period);
+    add_lazy_did(DID_MAGNETOMETER_1, period, { &mag_.pub });
+    set_decimation(DID_MAGNETOMETER_1, stream_decimation("mag"));
   }
 
   // Set up the barometer ROS stream
-  nh_private_.param<bool>("stream_baro", baro_.enabled, false);
+  param<bool>("stream_baro", baro_.enabled, false);
   if (baro_.enabled)
   {
-    baro_.pub = nh_.advertise<sensor_msgs::FluidPressure>("baro", 1);
-    SET_CALLBACK(DID_BAROMETER, barometer_t, baro_callback,1);
+    advertise_lazy<sensor_msgs::FluidPressure>(baro_.pub, "baro", 1);
+    int period = stream_period_multiple("baro", 1);
+    SET_CALLBACK(DID_BAROMETER, barometer_t, baro_callback, period);
+    add_lazy_did(DID_BAROMETER, period, { &baro_.pub });
+    set_decimation(DID_BAROMETER, stream_decimation("baro"));
   }
 
   // Set up the preintegrated IMU (coning and sculling integral) ROS stream
-  nh_private_.param<bool>("stream_preint_IMU", dt_vel_.enabled, false);
+  param<bool>("stream_preint_IMU", dt_vel_.enabled, false);
   if (dt_vel_.enabled)
   {
-    dt_vel_.pub = nh_.advertise<inertial_sense::PreIntIMU>("preint_imu", 1);
-    SET_CALLBACK(DID_PREINTEGRATED_IMU, preintegrated_imu_t, preint_IMU_callback,1);
+    advertise_lazy<inertial_sense::PreIntIMU>(dt_vel_.pub, "preint_imu", 1);
+    // no host-side decimation: dropping sets would lose their integrals, a longer period makes the uINS integrate longer
+    int period = stream_period_multiple("preint_IMU", 1);
+    SET_CALLBACK(DID_PREINTEGRATED_IMU, preintegrated_imu_t, preint_IMU_callback, period);
+    add_lazy_did(DID_PREINTEGRATED_IMU, period, { &dt_vel_.pub });
   }
 
   // Set up ROS dianostics for rqt_robot_monitor
-  nh_private_.param<bool>("stream_diagnostics", diagnostics_.enabled, true);
+  param<bool>("stream_diagnostics", diagnostics_.enabled, true);
   if (diagnostics_.enabled)
   {
-    diagnostics_.pub = nh_.advertise<diagnostic_msgs::DiagnosticArray>("diagnostics", 1);
+    advertise<diagnostic_msgs::DiagnosticArray>(diagnostics_.pub, "diagnostics", 1);
     diagnostics_timer_ = nh_.createTimer(ros::Duration(0.5), &InertialSenseROS::diagnostics_callback , this); // 2 Hz
   }
+
+  // stop whatever nobody has subscribed to yet
+  if (lazy_streams_)
+    update_lazy_streams();
+}
+
+void InertialSenseROS::configure_tf()
+{
+  double tf_rate;
+  param<bool>("publishTf", publishTf, true);
+  param<std::string>("tf_parent_frame", ins_tf_.header.frame_id, "ins");
+  param<std::string>("tf_child_frame", ins_tf_.child_frame_id, "base_link");
+  param<double>("tf_rate", tf_rate, 0.0);
+  // 1% short of the period, so stamps landing exactly on it aren't skipped to the next one
+  tf_min_interval_ = (tf_rate > 0.0) ? ros::Duration(0.99 / tf_rate) : ros::Duration(0.0);
+  ins_tf_.header.stamp = ros::Time(0);
+
+  bool publish_static;
+  param<bool>("publish_static_tf", publish_static, publishTf);
+  if (publish_static && !offline_)
+    publish_static_tf();
+  if (offline_)
+    advertise<tf2_msgs::TFMessage>(tf_pub_, "/tf", 100);
+  else if (!br_)
+    br_.reset(new tf2_ros::TransformBroadcaster());
+}
+
+void InertialSenseROS::send_transform(const geometry_msgs::TransformStamped& transform)
+{
+  if (!offline_)
+  {
+    br_->sendTransform(transform);
+    return;
+  }
+  tf2_msgs::TFMessage tf;
+  tf.transforms.push_back(transform);
+  publish(tf_pub_, tf);
+}
+
+void InertialSenseROS::publish_static_tf()
+{
+  if (frame_id_.empty())
+    return;  // not connected, the body frame comes with the device
+  // GPS antennas, at the offsets configured in GPS_ant<n>_xyz (body frame)
+  std::vector<geometry_msgs::TransformStamped> transforms;
+  const char* antennas[] = { "GPS_ant1_xyz", "GPS_ant2_xyz" };
+  const char* frames[] = { "gps1_frame", "gps2_frame" };
+  for (int i = 0; i < 2; i++)
+  {
+    std::vector<double> xyz;
+    if (!get_param(antennas[i], xyz) || xyz.size() != 3)
+      continue;
+    geometry_msgs::TransformStamped t;
+    t.header.stamp = ros::Time::now();
+    t.header.frame_id = frame_id_;
+    param<std::string>(frames[i], t.child_frame_id, frame_id_ + "_gps" + std::to_string(i + 1));
+    t.transform.translation.x = xyz[0];
+    t.transform.translation.y = xyz[1];
+    t.transform.translation.z = xyz[2];
+    t.transform.rotation.w = 1.0;
+    transforms.push_back(t);
+  }
+  if (transforms.empty())
+    return;
+  // a latched publisher republishes everything it was given, so the devices of a hub share one
+  // rather than replace each other's transforms
+  if (!static_br_)
+    static_br_.reset(new tf2_ros::StaticTransformBroadcaster());
+  static_br_->sendTransform(transforms);
+}
+
+void InertialSenseROS::add_lazy_did(uint32_t did, int period_multiple, const std::vector<const ros::Publisher*>& pubs, bool required)
+{
+  if (!lazy_streams_ || did >= DID_COUNT)
+    return;
+  lazy_did_t lazy = { did, period_multiple, pubs, required };
+  lazy_dids_.push_back(lazy);
+}
+
+void InertialSenseROS::update_lazy_streams()
+{
+  // runs from spin() on (dis)connect of a subscriber, so this is never in the data path
+  imu1_subscribed_ = IMU_.pub.getNumSubscribers() > 0;
+  imu2_subscribed_ = IMU_.pub2.getNumSubscribers() > 0;
+  imu_combined_subscribed_ = IMU_combined_.pub.getNumSubscribers() > 0;
+  imu_batch_subscribed_ = IMU_batch_.pub.getNumSubscribers() > 0;
+
+  for (size_t i = 0; i < lazy_dids_.size(); i++)
+  {
+    const lazy_did_t& lazy = lazy_dids_[i];
+    bool wanted = lazy.required;
+    for (size_t j = 0; j < lazy.pubs.size() && !wanted; j++)
+      wanted = lazy.pubs[j]->getNumSubscribers() > 0;
+    if (wanted != did_paused_[lazy.did])
+      continue;
+
+    did_paused_[lazy.did] = !wanted;
+    decimation_count_[lazy.did] = 0;
+    if (lazy.did == DID_DUAL_IMU)
+      imu_averager_.reset();
+    set_broadcast_period(lazy.did, wanted ? lazy.period_multiple : 0);
+    ROS_DEBUG("inertialsense: %s %s", cISDataMappings::GetDataSetName(lazy.did), wanted ? "resumed" : "paused, no subscribers");
+  }
+}
+
+void InertialSenseROS::set_broadcast_period(uint32_t did, int period_multiple)
+{
+  if (!device_connected_)
+    return;
+  if (period_multiple > 0)
+    last_rx_ns_ = did_stats_now_ns();  // give a (re)started stream stall_timeout_ to arrive
+  if (request_broadcast_)
+    request_broadcast_(did, period_multiple, device_);
+  else if (period_multiple > 0)
+    comManagerGetData(device_, did, 0, 0, period_multiple);
+  else
+    comManagerDisableData(device_, did);  // a period of 0 would be a one-shot request
 }
 
 void InertialSenseROS::start_log()
 {
-  std::string filename = cISLogger::CreateCurrentTimestamp();
-  ROS_INFO_STREAM("Creating log in " << filename << " folder");
-  IS_.SetLoggerEnabled(true, filename, cISLogger::LOGTYPE_DAT, RMC_PRESET_PPD_ROBOT);
+  std::string filename;
+  param<std::string>("log_directory", filename, cISLogger::CreateCurrentTimestamp());
+  if (log_type_ != "raw")
+  {
+    ROS_INFO_STREAM("Creating log in " << filename << " folder");
+    IS_.SetLoggerEnabled(true, filename, cISLogger::LOGTYPE_DAT, RMC_PRESET_PPD_ROBOT);
+    return;
+  }
+
+  LogWriter::config_t config = LogWriter::default_config();
+  double segment_mb, block_kb, queue_mb;
+  config.directory = filename;
+  config.prefix = "LOG_SN" + std::to_string(IS_.GetDeviceInfo(device_).serialNumber);
+  param<double>("log_segment_mb", segment_mb, config.segment_size / 1048576.0);
+  param<double>("log_segment_duration", config.segment_duration, config.segment_duration);
+  param<double>("log_block_kb", block_kb, config.block_size / 1024.0);
+  param<double>("log_queue_mb", queue_mb, config.queue_size / 1048576.0);
+  param<double>("log_sync_period", config.sync_period, config.sync_period);
+  param<bool>("log_direct_io", config.direct_io, config.direct_io);
+  param<double>("log_index_interval", config.index_interval, config.index_interval);
+  config.segment_size = (uint64_t)(segment_mb * 1048576.0);
+  config.block_size = (size_t)(block_kb * 1024.0);
+  config.queue_size = (size_t)(queue_mb * 1048576.0);
+
+  log_writer_.reset(new LogWriter(config));
+  if (!log_writer_->start() || !log_writer_->attach(IS_.GetSerialPort(device_)))
+  {
+    ROS_ERROR("inertialsense: unable to start the raw log in %s", filename.c_str());
+    log_writer_.reset();
+    return;
+  }
+  ROS_INFO("inertialsense: raw log of \"%s\" in %s (%s_*.raw)", port_.c_str(), filename.c_str(), config.prefix.c_str());
+  // the same data sets the SDK's logger would ask for
+  IS_.BroadcastBinaryDataRmcPreset(RMC_PRESET_PPD_ROBOT, RMC_OPTIONS_PRESERVE_CTRL);
 }
 
 void InertialSenseROS::configure_ascii_output()
@@ -152,73 +732,292 @@ void InertialSenseROS::configure_ascii_output()
   //  msgs.gpgll = (NMEA_message_configuration & NMEA_GPGLL) ? NMEA_rate : 0;
   //  msgs.gpgsa = (NMEA_message_configuration & NMEA_GPGSA) ? NMEA_rate : 0;
   //  msgs.gprmc = (NMEA_message_configuration & NMEA_GPRMC) ? NMEA_rate : 0;
-  //  IS_.SendData(DID_ASCII_BCAST_PERIOD, (uint8_t*)(&msgs), sizeof(ascii_msgs_t), 0);
+  //  send_data(DID_ASCII_BCAST_PERIOD, (uint8_t*)(&msgs), sizeof(ascii_msgs_t), 0);
 
 }
 
 void InertialSenseROS::connect()
 {
-  nh_private_.param<std::string>("port", port_, "/dev/ttyUSB0");
-  nh_private_.param<int>("baudrate", baudrate_, 921600);
-  nh_private_.param<std::string>("frame_id", frame_id_, "body");
+  param<std::string>("port", port_, "/dev/ttyUSB0");
+  param<int>("baudrate", baudrate_, 921600);
+  param<std::string>("frame_id", frame_id_, "body");
+  param<bool>("low_latency_serial", low_latency_serial_, false);
+
+  // applied when the port the SDK opened is adopted by our serial layer below
+  serialPortPlatformSetOptions(low_latency_serial_ ? SERIAL_PORT_OPTION_LOW_LATENCY : 0);
 
-  /// Connect to the uINS
+  /// Connect to the uINS, waiting for it to show up unless reconnecting is off
   ROS_INFO("Connecting to serial port \"%s\", at %d baud", port_.c_str(), baudrate_);
-  if (! IS_.Open(port_.c_str(), baudrate_))
+  double backoff = reconnect_backoff_min_;
+  while (!IS_.Open(port_.c_str(), baudrate_) || !serialPortPlatformAdopt(IS_.GetSerialPort(device_), baudrate_))
   {
-    ROS_FATAL("inertialsense: Unable to open serial port \"%s\", at %d baud", port_.c_str(), baudrate_);
-    exit(0);
+    if (!reconnect_enabled_ || !ros::ok())
+    {
+      ROS_FATAL("inertialsense: Unable to open serial port \"%s\", at %d baud", port_.c_str(), baudrate_);
+      exit(0);
+    }
+    ROS_WARN("inertialsense: Unable to open serial port \"%s\", at %d baud, retrying in %.1f s", port_.c_str(), baudrate_, backoff);
+    ros::WallDuration(backoff).sleep();
+    backoff = std::min(backoff * 2.0, reconnect_backoff_max_);
   }
-  else
+  // Print if Successful
+  ROS_INFO("Connected to uINS %d on \"%s\", at %d baud", IS_.GetDeviceInfo(device_).serialNumber, port_.c_str(), baudrate_);
+
+  serial_port_latency_info_t info;
+  if (serialPortGetLatencyInfo(IS_.GetSerialPort(device_), &info))
   {
-    // Print if Successful
-    ROS_INFO("Connected to uINS %d on \"%s\", at %d baud", IS_.GetDeviceInfo().serialNumber, port_.c_str(), baudrate_);
+    ROS_INFO("Serial port running at %d baud%s, low latency %s, adapter latency timer %s",
+             info.baudRate, info.customBaud ? " (custom divisor)" : "", info.lowLatency ? "on" : "off",
+             info.latencyTimerMs < 0 ? "n/a" : (std::to_string(info.latencyTimerMs) + " ms").c_str());
+    if (info.baudRate != baudrate_)
+      ROS_WARN("Serial port baud rate is %d, %d was requested", info.baudRate, baudrate_);
+    if (low_latency_serial_ && info.latencyTimerMs > 1)
+      ROS_WARN("USB-serial latency timer is still %d ms, allow writing %s's latency_timer in sysfs (e.g. with a udev rule) to lower it",
+               info.latencyTimerMs, port_.c_str());
   }
 }
 
+void InertialSenseROS::attach()
+{
+  port_ = IS_.GetSerialPort(device_)->port;
+  param<std::string>("frame_id", frame_id_, "body");
+
+  // the port was opened by the owner of the connection, so take its settings from the port itself
+  serial_port_latency_info_t info = {};
+  serialPortGetLatencyInfo(IS_.GetSerialPort(device_), &info);
+  baudrate_ = info.baudRate;
+  low_latency_serial_ = info.lowLatency;
+  ROS_INFO("Attached to uINS %d on \"%s\" (device %d), at %d baud", IS_.GetDeviceInfo(device_).serialNumber, port_.c_str(), device_, baudrate_);
+}
+
+void InertialSenseROS::send_data(uint32_t did, const void* data, uint32_t size, uint32_t offset)
+{
+  comManagerSendData(device_, did, const_cast<void*>(data), size, offset);
+}
+
+void InertialSenseROS::start_pipeline()
+{
+  bool pipeline_mode;
+  int ring_size, priority;
+  param<bool>("pipeline_mode", pipeline_mode, shared_connection_); // one reader thread per device when sharing
+  param<int>("pipeline_ring_size", ring_size, 262144); // ~2.8 s of data at 921600 baud
+  param<int>("pipeline_reader_priority", priority, 0);
+  if (!pipeline_mode)
+    return;
+
+  // the raw log reads through whatever the decoder reads from, so it goes on top of the pipeline
+  if (log_writer_)
+    log_writer_->detach();
+  if (!pipeline_)
+    pipeline_.reset(new SerialPipeline(ring_size));
+  if (pipeline_->start(IS_.GetSerialPort(device_), priority))
+    ROS_INFO("inertialsense: serial reader thread started (%llu byte ring)", (unsigned long long)pipeline_->stats().capacity);
+  else
+    ROS_ERROR("inertialsense: unable to start serial reader thread, reading on the main thread");
+  if (log_writer_)
+    log_writer_->attach(IS_.GetSerialPort(device_));
+}
+
 void InertialSenseROS::set_navigation_dt_ms()
 {
-  // Make sure the navigation rate is right, if it's not, then we need to change and reset it.
-  int nav_dt_ms = IS_.GetFlashConfig().startupNavDtMs;
-  if (nh_private_.getParam("navigation_dt_ms", nav_dt_ms))
+  // Make sure the navigation rate is right, if it's not, it's written with the rest of the flash
+  // configuration and the uINS reset to make the change (see begin_reset())
+  int nav_dt_ms;
+  reset_nav_dt_ms_ = 0;
+  if (get_param("navigation_dt_ms", nav_dt_ms) && nav_dt_ms > 0 && (uint32_t)nav_dt_ms != flash_target_.startupNavDtMs)
+  {
+    ROS_INFO("navigation rate change from %dms to %dms, resetting uINS to make change", flash_target_.startupNavDtMs, nav_dt_ms);
+    uint32_t data = nav_dt_ms;
+    flash_stage(offsetof(nvm_flash_cfg_t, startupNavDtMs), &data, sizeof(data));
+    reset_nav_dt_ms_ = nav_dt_ms;
+  }
+}
+
+void InertialSenseROS::pump_connection(int timeout_ms)
+{
+  struct pollfd fd;
+  if (pipeline_ && pipeline_->running())
+    fd.fd = pipeline_->fd();
+  else
+    fd.fd = serialPortGetFileDescriptor(IS_.GetSerialPort(device_));
+  fd.events = POLLIN;
+  fd.revents = 0;
+  poll(&fd, 1, timeout_ms);
+  IS_.Update();
+  commands_.service();
+}
+
+bool InertialSenseROS::run_command_now(const CommandEngine::command_t& command, CommandEngine::result_t& result)
+{
+  std::future<CommandEngine::result_t> future = commands_.submit(command);
+  while (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
   {
-    if (nav_dt_ms != IS_.GetFlashConfig().startupNavDtMs)
+    int timeout_ms = commands_.next_timeout_ms();
+    pump_connection(timeout_ms < 0 ? 10 : std::min(timeout_ms, 10));
+  }
+  result = future.get();
+  return result.success;
+}
+
+void InertialSenseROS::begin_reset()
+{
+  // The new rate has to be applied before resetting: wait for the flash configuration to echo it,
+  // then give the uINS flash_save_time to store it, still decoding whatever arrives meanwhile
+  const uint32_t nav_dt_ms = reset_nav_dt_ms_;
+  CommandEngine::command_t applied;
+  applied.write = [this]() { comManagerGetData(device_, DID_FLASH_CONFIG, 0, 0, 0); };
+  applied.did = DID_FLASH_CONFIG;
+  applied.match = [nav_dt_ms](const p_data_t* data)
+  {
+    const uint32_t offset = offsetof(nvm_flash_cfg_t, startupNavDtMs);
+    uint32_t value;
+    if (!data_covers(data, offset, sizeof(value)))
+      return false;
+    memcpy(&value, data->buf + (offset - data->hdr.offset), sizeof(value));
+    return value == nav_dt_ms;
+  };
+  applied.timeout_s = reset_timeout_;
+  applied.retry_s = 0.2;
+  CommandEngine::result_t result;
+  if (!run_command_now(applied, result))
+    ROS_WARN("inertialsense: the uINS didn't confirm the navigation rate change, resetting anyway");
+
+  double flash_save_time;
+  param<double>("flash_save_time", flash_save_time, 0.25);
+  std::chrono::steady_clock::time_point saved = std::chrono::steady_clock::now() +
+    std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(flash_save_time));
+  while (std::chrono::steady_clock::now() < saved)
+    pump_connection(10);
+
+  reset_device();
+}
+
+bool InertialSenseROS::finish_reset()
+{
+  bool ready = wait_for_device_ready();
+  request_streams();
+  return ready;
+}
+
+bool InertialSenseROS::wait_for_device_ready()
+{
+  // Back from the reset once it reports running at the new rate.  Asking again every 100 ms also
+  // covers the boot, when requests go unanswered.
+  const uint32_t nav_dt_ms = reset_nav_dt_ms_;
+  reset_nav_dt_ms_ = 0;
+  set_callback(DID_SYS_PARAMS, [](const p_data_t* data) { (void)data; }, -1);
+  CommandEngine::command_t ready;
+  ready.write = [this]() { comManagerGetData(device_, DID_SYS_PARAMS, 0, 0, 0); };
+  ready.did = DID_SYS_PARAMS;
+  ready.match = [nav_dt_ms](const p_data_t* data)
+  {
+    const uint32_t offset = offsetof(sys_params_t, navPeriodMs);
+    uint32_t value;
+    if (!data_covers(data, offset, sizeof(value)))
+      return false;
+    memcpy(&value, data->buf + (offset - data->hdr.offset), sizeof(value));
+    return value == nav_dt_ms;
+  };
+  ready.timeout_s = reset_timeout_;
+  ready.retry_s = 0.1;
+  CommandEngine::result_t result;
+  if (!run_command_now(ready, result))
+  {
+    ROS_WARN("inertialsense: no answer at the %u ms navigation rate within %.1f s of the reset", nav_dt_ms, reset_timeout_);
+    return false;
+  }
+  ROS_INFO("inertialsense: uINS back from reset after %.2f s", result.elapsed_s);
+  return true;
+}
+
+void InertialSenseROS::request_streams()
+{
+  // a reset forgets every broadcast, ask for them again (except those lazy_streams paused)
+  for (uint32_t did = 0; did < DID_COUNT; did++)
+  {
+    if (did_callbacks_[did] && broadcast_period_[did] > 0 && !did_paused_[did])
+      set_broadcast_period(did, broadcast_period_[did]);
+  }
+}
+
+void InertialSenseROS::configure_parameters()
+{
+  // start from what the uINS has (the SDK reads it when the port opens), so only what the
+  // parameters change gets written
+  flash_target_ = IS_.GetFlashConfig(device_);
+  flash_known_ = (flash_target_.size == sizeof(nvm_flash_cfg_t));
+  flash_staged_.clear();
+
+  std::vector<uint8_t> bytes;
+  for (size_t i = 0; i < FLASH_FIELD_COUNT; i++)
+  {
+    const flash_field_t& field = FLASH_FIELDS[i];
+    std::vector<double> values(field.count, field.default_value);
+    if (field.count == 1)
+      param<double>(field.param, values[0], field.default_value);
+    else if (get_param(field.param, values) && values.size() != field.count)
     {
-      uint32_t data = nav_dt_ms;
-      IS_.SendData(DID_FLASH_CONFIG, (uint8_t*)(&data), sizeof(uint32_t), offsetof(nvm_flash_cfg_t, startupNavDtMs));
-      ROS_INFO("navigation rate change from %dms to %dms, resetting uINS to make change", IS_.GetFlashConfig().startupNavDtMs, nav_dt_ms);
-      sleep(3);
-      reset_device();
+      ROS_ERROR("inertialsense: %s needs %u values, leaving it unchanged", field.param, field.count);
+      continue;
     }
+    bytes.resize(field.count * field.element_size);
+    for (uint32_t j = 0; j < field.count; j++)
+      field.store(values[j], &bytes[j * field.element_size]);
+    flash_stage(field.offset, bytes.data(), (uint32_t)bytes.size());
   }
 }
 
-void InertialSenseROS::configure_parameters()
+void InertialSenseROS::flash_stage(uint32_t offset, const void* data, uint32_t size)
+{
+  if (offset + size > sizeof(flash_target_))
+    return;
+  memcpy(reinterpret_cast<uint8_t*>(&flash_target_) + offset, data, size);
+  flash_staged_.push_back({ offset, size });
+}
+
+void InertialSenseROS::flash_commit()
 {
-  set_vector_flash_config<float>("INS_rpy_radians", 3, offsetof(nvm_flash_cfg_t, insRotation));
-  set_vector_flash_config<float>("INS_xyz", 3, offsetof(nvm_flash_cfg_t, insOffset));
-  set_vector_flash_config<float>("GPS_ant1_xyz", 3, offsetof(nvm_flash_cfg_t, gps1AntOffset));
-  set_vector_flash_config<float>("GPS_ant2_xyz", 3, offsetof(nvm_flash_cfg_t, gps2AntOffset));
-  set_vector_flash_config<double>("GPS_ref_lla", 3, offsetof(nvm_flash_cfg_t, refLla));
+  // bytes a write costs on top of its data (packet and data headers, checksum), also the largest
+  // run of unchanged bytes worth rewriting to save one
+  const uint32_t WRITE_OVERHEAD = 24;
+
+  nvm_flash_cfg_t& current = IS_.GetFlashConfig(device_);
+  std::vector<flash_write_t> writes = flash_known_ ?
+    flash_config_diff(&current, &flash_target_, sizeof(nvm_flash_cfg_t), WRITE_OVERHEAD) : flash_staged_;
+
+  uint32_t staged_bytes = 0, written_bytes = 0;
+  for (size_t i = 0; i < flash_staged_.size(); i++)
+    staged_bytes += flash_staged_[i].size + WRITE_OVERHEAD;
+  for (size_t i = 0; i < writes.size(); i++)
+  {
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(&flash_target_) + writes[i].offset;
+    send_data(DID_FLASH_CONFIG, data, writes[i].size, writes[i].offset);
+    // keep the SDK's copy current, nothing reads it back from the uINS
+    memcpy(reinterpret_cast<uint8_t*>(&current) + writes[i].offset, data, writes[i].size);
+    written_bytes += writes[i].size + WRITE_OVERHEAD;
+  }
 
-  set_flash_config<float>("inclination", offsetof(nvm_flash_cfg_t, magInclination), 0.0f);
-  set_flash_config<float>("declination", offsetof(nvm_flash_cfg_t, magDeclination), 0.0f);
-  set_flash_config<int>("dynamic_model", offsetof(nvm_flash_cfg_t, insDynModel), 8);
-  set_flash_config<int>("ser1_baud_rate", offsetof(nvm_flash_cfg_t, ser1BaudRate), 921600);
+  // startup report: link time of what was written against writing every field
+  double byte_s = 10.0 / std::max(baudrate_, 1);
+  ROS_INFO("inertialsense: flash configuration %s: %lu write(s), %u bytes (%.2f ms) instead of %lu, %u bytes (%.2f ms)",
+           flash_known_ ? "compared" : "unknown, written in full",
+           (unsigned long)writes.size(), written_bytes, written_bytes * byte_s * 1e3,
+           (unsigned long)flash_staged_.size(), staged_bytes, staged_bytes * byte_s * 1e3);
+  flash_staged_.clear();
 }
 
 void InertialSenseROS::configure_rtk()
 {
   bool RTK_rover, RTK_rover_radio_enable, RTK_base, dual_GNSS;
-  nh_private_.param<bool>("RTK_rover", RTK_rover, false);
-  nh_private_.param<bool>("RTK_rover_radio_enable", RTK_rover_radio_enable, false);
-  nh_private_.param<bool>("RTK_base", RTK_base, false);
-  nh_private_.param<bool>("dual_GNSS", dual_GNSS, false);
+  param<bool>("RTK_rover", RTK_rover, false);
+  param<bool>("RTK_rover_radio_enable", RTK_rover_radio_enable, false);
+  param<bool>("RTK_base", RTK_base, false);
+  param<bool>("dual_GNSS", dual_GNSS, false);
   std::string RTK_server_IP, RTK_correction_type;
   int RTK_server_port;
-  nh_private_.param<std::string>("RTK_server_IP", RTK_server_IP, "127.0.0.1");
-  nh_private_.param<int>("RTK_server_port", RTK_server_port, 7777);
-  nh_private_.param<std::string>("RTK_correction_type", RTK_correction_type, "UBLOX");
+  param<std::string>("RTK_server_IP", RTK_server_IP, "127.0.0.1");
+  param<int>("RTK_server_port", RTK_server_port, 7777);
+  param<std::string>("RTK_correction_type", RTK_correction_type, "UBLOX");
   ROS_ERROR_COND(RTK_rover && RTK_base, "unable to configure uINS to be both RTK rover and base - default to rover");
   ROS_ERROR_COND(RTK_rover && dual_GNSS, "unable to configure uINS to be both RTK rover as dual GNSS - default to dual GNSS");
 
@@ -232,8 +1031,8 @@ void InertialSenseROS::configure_rtk()
     SET_CALLBACK(DID_GPS2_RTK_CMP_MISC, gps_rtk_misc_t, RTK_Misc_callback,1);
     SET_CALLBACK(DID_GPS2_RTK_CMP_REL, gps_rtk_rel_t, RTK_Rel_callback,1);
     RTK_.enabled = true;
-    RTK_.pub = nh_.advertise<inertial_sense::RTKInfo>("RTK/info", 10);
-    RTK_.pub2 = nh_.advertise<inertial_sense::RTKRel>("RTK/rel", 10);
+    advertise<inertial_sense::RTKInfo>(RTK_.pub, "RTK/info", 10);
+    advertise<inertial_sense::RTKRel>(RTK_.pub2, "RTK/rel", 10);
   }
 
   if (RTK_rover_radio_enable)
@@ -246,8 +1045,8 @@ void InertialSenseROS::configure_rtk()
     SET_CALLBACK(DID_GPS1_RTK_POS_MISC, gps_rtk_misc_t, RTK_Misc_callback,1);
     SET_CALLBACK(DID_GPS1_RTK_POS_REL, gps_rtk_rel_t, RTK_Rel_callback,1);
     RTK_.enabled = true;
-    RTK_.pub = nh_.advertise<inertial_sense::RTKInfo>("RTK/info", 10);
-    RTK_.pub2 = nh_.advertise<inertial_sense::RTKRel>("RTK/rel", 10);
+    advertise<inertial_sense::RTKInfo>(RTK_.pub, "RTK/info", 10);
+    advertise<inertial_sense::RTKRel>(RTK_.pub2, "RTK/rel", 10);
   }
   else if (RTK_rover)
   {
@@ -257,16 +1056,22 @@ void InertialSenseROS::configure_rtk()
     RTK_state_ = RTK_ROVER;
     RTKCfgBits |= RTK_CFG_BITS_ROVER_MODE_RTK_POSITIONING_F9P;
 
-    if (IS_.OpenServerConnection(RTK_connection))
-      ROS_INFO_STREAM("Successfully connected to " << RTK_connection << " RTK server");
-    else
-      ROS_ERROR_STREAM("Failed to connect to base server at " << RTK_connection);
+    if (device_connected_)
+    {
+      if (IS_.OpenServerConnection(RTK_connection))
+      {
+        ROS_INFO_STREAM("Successfully connected to " << RTK_connection << " RTK server");
+        server_connection_open_ = true;
+      }
+      else
+        ROS_ERROR_STREAM("Failed to connect to base server at " << RTK_connection);
+    }
 
     SET_CALLBACK(DID_GPS1_RTK_POS_MISC, gps_rtk_misc_t, RTK_Misc_callback,1);
     SET_CALLBACK(DID_GPS1_RTK_POS_REL, gps_rtk_rel_t, RTK_Rel_callback,1);
     RTK_.enabled = true;
-    RTK_.pub = nh_.advertise<inertial_sense::RTKInfo>("RTK/info", 10);
-    RTK_.pub2 = nh_.advertise<inertial_sense::RTKRel>("RTK/rel", 10);
+    advertise<inertial_sense::RTKInfo>(RTK_.pub, "RTK/info", 10);
+    advertise<inertial_sense::RTKRel>(RTK_.pub2, "RTK/rel", 10);
   }
   else if (RTK_base)
   {
@@ -276,39 +1081,19 @@ void InertialSenseROS::configure_rtk()
     RTK_state_ = RTK_BASE;
     RTKCfgBits |= RTK_CFG_BITS_BASE_OUTPUT_GPS1_UBLOX_SER0;
 
-    if (IS_.CreateHost(RTK_connection))
+    if (device_connected_)
     {
-      ROS_INFO_STREAM("Successfully created " << RTK_connection << " as RTK server");
-      initialized_ = true;
-      return;
+      if (IS_.CreateHost(RTK_connection))
+      {
+        ROS_INFO_STREAM("Successfully created " << RTK_connection << " as RTK server");
+        initialized_ = true;
+        return;
+      }
+      else
+        ROS_ERROR_STREAM("Failed to create base server at " << RTK_connection);
     }
-    else
-      ROS_ERROR_STREAM("Failed to create base server at " << RTK_connection);
   }
-  IS_.SendData(DID_FLASH_CONFIG, reinterpret_cast<uint8_t*>(&RTKCfgBits), sizeof(RTKCfgBits), offsetof(nvm_flash_cfg_t, RTKCfgBits));
-}
-
-template <typename T>
-void InertialSenseROS::set_vector_flash_config(std::string param_name, uint32_t size, uint32_t offset){
-  std::vector<double> tmp(size,0);
-  T v[size];
-  if (nh_private_.hasParam(param_name))
-    nh_private_.getParam(param_name, tmp);
-  for (int i = 0; i < size; i++)
-  {
-    v[i] = tmp[i];
-  }
-  
-  IS_.SendData(DID_FLASH_CONFIG, reinterpret_cast<uint8_t*>(&v), sizeof(v), offset);
-  IS_.GetFlashConfig() = IS_.GetFlashConfig();
-}
-
-template <typename T>
-void InertialSenseROS::set_flash_config(std::string param_name, uint32_t offset, T def)
-{
-  T tmp;
-  nh_private_.param<T>(param_name, tmp, def);
-  IS_.SendData(DID_FLASH_CONFIG, reinterpret_cast<uint8_t*>(&tmp), sizeof(T), offset);
+  flash_stage(offsetof(nvm_flash_cfg_t, RTKCfgBits), &RTKCfgBits, sizeof(RTKCfgBits));
 }
 
 void InertialSenseROS::INS1_callback(const ins_1_t * const msg)
@@ -404,19 +1189,20 @@ void InertialSenseROS::INS2_callback(const ins_2_t * const msg)
   odom_msg.twist.twist.angular.y = imu1_msg.angular_velocity.y;
   odom_msg.twist.twist.angular.z = imu1_msg.angular_velocity.z;
 
-  if (publishTf)
+  // rate limited on INS time, so a replayed log gives the same TF; going back in time (reset) always publishes
+  if (publishTf && (tf_min_interval_.isZero() || odom_msg.header.stamp < ins_tf_.header.stamp ||
+                    odom_msg.header.stamp - ins_tf_.header.stamp >= tf_min_interval_))
   {
-    // Calculate the TF from the pose...
-		transform.setOrigin(tf::Vector3(odom_msg.pose.pose.position.x, odom_msg.pose.pose.position.y, odom_msg.pose.pose.position.z));
-    tf::Quaternion q;
-    tf::quaternionMsgToTF(odom_msg.pose.pose.orientation, q);
-    transform.setRotation(q);
-
-    br.sendTransform(tf::StampedTransform(transform, ros::Time::now(), "ins", "base_link"));
+    ins_tf_.header.stamp = odom_msg.header.stamp;
+    ins_tf_.transform.translation.x = odom_msg.pose.pose.position.x;
+    ins_tf_.transform.translation.y = odom_msg.pose.pose.position.y;
+    ins_tf_.transform.translation.z = odom_msg.pose.pose.position.z;
+    ins_tf_.transform.rotation = odom_msg.pose.pose.orientation;
+    send_transform(ins_tf_);
   }
 
   if (INS_.enabled)
-    INS_.pub.publish(odom_msg);
+    publish_copy(INS_.pub, odom_msg);
 }
 
 
@@ -453,35 +1239,88 @@ void InertialSenseROS::INL2_states_callback(const inl2_states_t* const msg)
   // Use custom INL2 states message
   if(INL2_states_.enabled)
   {
-    INL2_states_.pub.publish(inl2_states_msg);
+    publish_copy(INL2_states_.pub, inl2_states_msg);
   }
 }
 
 
+static inline void imu_to_msg(const imus_t& in, sensor_msgs::Imu& out)
+{
+  out.angular_velocity.x = in.pqr[0];
+  out.angular_velocity.y = in.pqr[1];
+  out.angular_velocity.z = in.pqr[2];
+  out.linear_acceleration.x = in.acc[0];
+  out.linear_acceleration.y = in.acc[1];
+  out.linear_acceleration.z = in.acc[2];
+}
+
 void InertialSenseROS::IMU_callback(const dual_imu_t* const msg)
 {
   imu1_msg.header.stamp = imu2_msg.header.stamp = ros_time_from_start_time(msg->time);
   imu1_msg.header.frame_id = imu2_msg.header.frame_id = frame_id_;
 
-  imu1_msg.angular_velocity.x = msg->I[0].pqr[0];
-  imu1_msg.angular_velocity.y = msg->I[0].pqr[1];
-  imu1_msg.angular_velocity.z = msg->I[0].pqr[2];
-  imu1_msg.linear_acceleration.x = msg->I[0].acc[0];
-  imu1_msg.linear_acceleration.y = msg->I[0].acc[1];
-  imu1_msg.linear_acceleration.z = msg->I[0].acc[2];
+  // imu1_msg is always converted, the INS needs its angular rates
+  imu_to_msg(msg->I[0], imu1_msg);
 
-  //  imu2_msg.angular_velocity.x = msg->I[1].pqr[0];
-  //  imu2_msg.angular_velocity.y = msg->I[1].pqr[1];
-  //  imu2_msg.angular_velocity.z = msg->I[1].pqr[2];
-  //  imu2_msg.linear_acceleration.x = msg->I[1].acc[0];
-  //  imu2_msg.linear_acceleration.y = msg->I[1].acc[1];
-  //  imu2_msg.linear_acceleration.z = msg->I[1].acc[2];
+  if (IMU_.enabled && imu1_subscribed_)
+    publish_copy(IMU_.pub, imu1_msg);
+  if (imu2_enabled_ && imu2_subscribed_)
+  {
+    imu_to_msg(msg->I[1], imu2_msg);
+    publish_copy(IMU_.pub2, imu2_msg);
+  }
+  if (IMU_combined_.enabled && imu_combined_subscribed_)
+  {
+    imus_t combined;
+    dual_imu_blend(*msg, imu_combined_weight_, combined);
+    imu_combined_msg.header = imu1_msg.header;
+    imu_to_msg(combined, imu_combined_msg);
+    publish_copy(IMU_combined_.pub, imu_combined_msg);
+  }
+  if (IMU_batch_.enabled && imu_batch_subscribed_)
+    IMU_batch_append(imu1_msg.header.stamp, msg);
+}
 
-  if (IMU_.enabled)
+void InertialSenseROS::IMU_batch_reset()
+{
+  // one allocation per batch - appending samples stays within the reserved storage
+  imu_batch_.reset(new inertial_sense::ImuBatch);
+  imu_batch_->header.frame_id = frame_id_;
+  imu_batch_->stamp.reserve(imu_batch_size_);
+  imu_batch_->angular_velocity.reserve(3 * imu_batch_size_);
+  imu_batch_->linear_acceleration.reserve(3 * imu_batch_size_);
+}
+
+void InertialSenseROS::IMU_batch_append(const ros::Time& stamp, const dual_imu_t* const msg)
+{
+  if (imu_batch_->stamp.empty())
   {
-    IMU_.pub.publish(imu1_msg);
-    //    IMU_.pub2.publish(imu2_msg);
+    imu_batch_->header.stamp = stamp;
+    imu_batch_timer_.stop();
+    imu_batch_timer_.start();
   }
+  imu_batch_->stamp.push_back(stamp);
+  for (int i = 0; i < 3; i++)
+  {
+    imu_batch_->angular_velocity.push_back(msg->I[0].pqr[i]);
+    imu_batch_->linear_acceleration.push_back(msg->I[0].acc[i]);
+  }
+  if ((int)imu_batch_->stamp.size() >= imu_batch_size_)
+    IMU_batch_publish();
+}
+
+void InertialSenseROS::IMU_batch_publish()
+{
+  imu_batch_timer_.stop();
+  publish(IMU_batch_.pub, imu_batch_);
+  IMU_batch_reset();
+}
+
+void InertialSenseROS::IMU_batch_timer_callback(const ros::TimerEvent& e)
+{
+  (void)e;
+  if (imu_batch_ && !imu_batch_->stamp.empty())
+    IMU_batch_publish();
 }
 
 
@@ -527,7 +1366,7 @@ void InertialSenseROS::publishGPS()
     if ((gps_velEcef.header.stamp - gps_msg.header.stamp).toSec() < 2e-3)
 	{
 		gps_msg.velEcef = gps_velEcef.vector;
-		GPS_.pub.publish(gps_msg);
+		publish_copy(GPS_.pub, gps_msg);
 	}
 }
 
@@ -536,17 +1375,183 @@ void InertialSenseROS::update()
 	IS_.Update();
 }
 
+void InertialSenseROS::spin()
+{
+  // RTK corrections from a TCP server are read inside IS_.Update(), not off the serial port,
+  // so keep waking up often enough to forward them when that connection is open
+  const int server_poll_ms = 10;
+
+  struct pollfd fds[2];
+  fds[0].fd = callback_queue_.fd();
+  fds[0].events = POLLIN;
+  fds[1].events = POLLIN;
+
+  while (ros::ok() && !shutdown_requested_)
+  {
+    // the port can be re-opened (e.g. firmware update, reconnect), so look the descriptor up every pass
+    // the SDK reads small requests ahead from the port, poll() can't see what it has buffered
+    bool buffered = false;
+    if (connection_state_ == CONNECTION_DOWN)
+      fds[1].fd = -1;
+    else if (pipeline_ && pipeline_->running())
+      fds[1].fd = pipeline_->fd();
+    else
+    {
+      fds[1].fd = serialPortGetFileDescriptor(IS_.GetSerialPort(device_));
+      buffered = serialPortGetReadAheadCount(IS_.GetSerialPort(device_)) > 0;
+    }
+    fds[0].revents = fds[1].revents = 0;
+
+    int timeout_ms = server_connection_open_ ? std::min(idle_timeout_ms_, server_poll_ms) : idle_timeout_ms_;
+    if (buffered)
+      timeout_ms = 0;
+    int command_ms = commands_.next_timeout_ms();
+    if (command_ms >= 0)
+      timeout_ms = std::min(timeout_ms, command_ms);
+    int connection_ms = connection_timeout_ms();
+    if (connection_ms >= 0)
+      timeout_ms = std::min(timeout_ms, connection_ms);
+    int n = poll(fds, 2, timeout_ms);
+    if (n < 0 && errno != EINTR)
+    {
+      ROS_ERROR("inertialsense: poll failed (%s)", strerror(errno));
+      break;
+    }
+
+    // Decode whatever is waiting on the port.  On timeout we still step the SDK so
+    // periodic housekeeping in the com manager keeps running while the device is quiet.
+    bool port_error = (fds[1].revents & (POLLERR | POLLHUP | POLLNVAL)) != 0 ||
+                      (pipeline_ && pipeline_->running() && pipeline_->port_error());
+    if (n == 0 || buffered || (fds[1].revents & (POLLIN | POLLERR | POLLHUP)))
+      update();
+
+    callback_queue_.callAvailableNow();
+    service_commands();
+    check_connection(port_error);
+  }
+}
+
+bool InertialSenseROS::streams_expected() const
+{
+  for (uint32_t did = 0; did < DID_COUNT; did++)
+  {
+    if (did_callbacks_[did] && broadcast_period_[did] > 0 && !did_paused_[did])
+      return true;
+  }
+  return false;
+}
+
+int InertialSenseROS::connection_timeout_ms() const
+{
+  if (!reconnect_enabled_ || shared_connection_ || !device_connected_)
+    return -1;
+  uint64_t now = did_stats_now_ns();
+  uint64_t next;
+  if (connection_state_ == CONNECTION_DOWN)
+    next = next_reconnect_ns_;
+  else if (stall_timeout_ > 0.0)
+    next = last_rx_ns_ + (uint64_t)(stall_timeout_ * 1e9);
+  else
+    return -1;
+  return next > now ? (int)((next - now) / 1000000ull) + 1 : 0;
+}
+
+void InertialSenseROS::check_connection(bool port_error)
+{
+  // a hub owns its connection, and a log has none
+  if (shared_connection_ || !device_connected_)
+    return;
+  if (!reconnect_enabled_)
+  {
+    // a hung up port stays readable, so carrying on would spin on it
+    if (port_error && connection_state_ != CONNECTION_DOWN)
+    {
+      ROS_FATAL("inertialsense: serial port error on \"%s\" and reconnect is off, shutting down", port_.c_str());
+      if (pipeline_)
+        pipeline_->stop();
+      serialPortClose(IS_.GetSerialPort(device_));
+      connection_state_ = CONNECTION_DOWN;
+      shutdown();
+    }
+    return;
+  }
+  uint64_t now = did_stats_now_ns();
+  if (connection_state_ == CONNECTION_DOWN)
+  {
+    if (now >= next_reconnect_ns_)
+      try_reconnect();
+  }
+  else if (port_error)
+    connection_lost("serial port error");
+  else if (stall_timeout_ > 0.0 && now > last_rx_ns_ + (uint64_t)(stall_timeout_ * 1e9) && streams_expected())
+    connection_lost("no data");
+}
+
+void InertialSenseROS::connection_lost(const char* reason)
+{
+  uint64_t now = did_stats_now_ns();
+  // a reopened port that never delivered is the same outage, keep backing off
+  if (connection_state_ != CONNECTION_RECOVERING)
+  {
+    disconnected_ns_ = now;
+    reconnect_attempts_ = 0;
+    reconnect_backoff_ = reconnect_backoff_min_;
+    next_reconnect_ns_ = now;
+  }
+  ROS_WARN("inertialsense: %s on \"%s\", reconnecting", reason, port_.c_str());
+
+  if (pipeline_)
+    pipeline_->stop();
+  serialPortClose(IS_.GetSerialPort(device_));
+  // anything waiting on an answer won't get one from this port
+  commands_.cancel_all();
+  connection_state_ = CONNECTION_DOWN;
+}
+
+void InertialSenseROS::try_reconnect()
+{
+  reconnect_attempts_++;
+  if (!serialPortOpen(IS_.GetSerialPort(device_), port_.c_str(), baudrate_, 0))
+  {
+    ROS_WARN_THROTTLE(10.0, "inertialsense: unable to reopen \"%s\" (attempt %d), retrying every %.1f s at most",
+                      port_.c_str(), reconnect_attempts_, reconnect_backoff_max_);
+    next_reconnect_ns_ = did_stats_now_ns() + (uint64_t)(reconnect_backoff_ * 1e9);
+    reconnect_backoff_ = std::min(reconnect_backoff_ * 2.0, reconnect_backoff_max_);
+    return;
+  }
+
+  // same port, com manager and handlers: only the streams have to be asked for again, in case
+  // the uINS was power cycled.  Nothing arriving within stall_timeout_ counts as another failure.
+  connection_state_ = CONNECTION_RECOVERING;
+  start_pipeline();
+  request_streams();
+  last_rx_ns_ = did_stats_now_ns();
+  next_reconnect_ns_ = last_rx_ns_ + (uint64_t)(reconnect_backoff_ * 1e9);
+  reconnect_backoff_ = std::min(reconnect_backoff_ * 2.0, reconnect_backoff_max_);
+}
+
+void InertialSenseROS::service_commands()
+{
+  commands_.service();
+}
+
+void InertialSenseROS::shutdown()
+{
+  shutdown_requested_ = true;
+  callback_queue_.notify();
+}
+
 void InertialSenseROS::strobe_in_time_callback(const strobe_in_time_t * const msg)
 {
   // create the subscriber if it doesn't exist
   if (strobe_pub_.getTopic().empty())
-    strobe_pub_ = nh_.advertise<std_msgs::Header>("strobe_time", 1);
+    advertise<std_msgs::Header>(strobe_pub_, "strobe_time", 1);
   
   if (GPS_towOffset_ > 0.001)
   {
-  std_msgs::Header strobe_msg;
-  strobe_msg.stamp = ros_time_from_week_and_tow(msg->week, msg->timeOfWeekMs * 1e-3);
-  strobe_pub_.publish(strobe_msg);
+  std_msgs::Header::Ptr strobe_msg(new std_msgs::Header);
+  strobe_msg->stamp = ros_time_from_week_and_tow(msg->week, msg->timeOfWeekMs * 1e-3);
+  publish(strobe_pub_, strobe_msg);
 }
 }
 
@@ -566,72 +1571,72 @@ void InertialSenseROS::GPS_info_callback(const gps_sat_t* const msg)
     gps_info_msg.sattelite_info[i].sat_id = msg->sat[i].svId;
     gps_info_msg.sattelite_info[i].cno = msg->sat[i].cno;
   }
-  GPS_info_.pub.publish(gps_info_msg);
+  publish_copy(GPS_info_.pub, gps_info_msg);
 }
 
 
 void InertialSenseROS::mag_callback(const magnetometer_t* const msg)
 {
-  sensor_msgs::MagneticField mag_msg;
-  mag_msg.header.stamp = ros_time_from_start_time(msg->time);
-  mag_msg.header.frame_id = frame_id_;
-  mag_msg.magnetic_field.x = msg->mag[0];
-  mag_msg.magnetic_field.y = msg->mag[1];
-  mag_msg.magnetic_field.z = msg->mag[2];
-
-  mag_.pub.publish(mag_msg);
+  sensor_msgs::MagneticField::Ptr mag_msg(new sensor_msgs::MagneticField);
+  mag_msg->header.stamp = ros_time_from_start_time(msg->time);
+  mag_msg->header.frame_id = frame_id_;
+  mag_msg->magnetic_field.x = msg->mag[0];
+  mag_msg->magnetic_field.y = msg->mag[1];
+  mag_msg->magnetic_field.z = msg->mag[2];
+
+  publish(mag_.pub, mag_msg);
 }
 
 void InertialSenseROS::baro_callback(const barometer_t * const msg)
 {
-  sensor_msgs::FluidPressure baro_msg;
-  baro_msg.header.stamp = ros_time_from_start_time(msg->time);
-  baro_msg.header.frame_id = frame_id_;
-  baro_msg.fluid_pressure = msg->bar;
-  baro_msg.variance = msg-> barTemp;
+  sensor_msgs::FluidPressure::Ptr baro_msg(new sensor_msgs::FluidPressure);
+  baro_msg->header.stamp = ros_time_from_start_time(msg->time);
+  baro_msg->header.frame_id = frame_id_;
+  baro_msg->fluid_pressure = msg->bar;
+  baro_msg->variance = msg-> barTemp;
 
-  baro_.pub.publish(baro_msg);
+  publish(baro_.pub, baro_msg);
 }
 
 void InertialSenseROS::preint_IMU_callback(const preintegrated_imu_t * const msg)
 {
-  inertial_sense::PreIntIMU preintIMU_msg;
-  preintIMU_msg.header.stamp = ros_time_from_start_time(msg->time);
-  preintIMU_msg.header.frame_id = frame_id_;
-  preintIMU_msg.dtheta.x = msg->theta1[0];
-  preintIMU_msg.dtheta.y = msg->theta1[1];
-  preintIMU_msg.dtheta.z = msg->theta1[2];
+  inertial_sense::PreIntIMU::Ptr preintIMU_msg(new inertial_sense::PreIntIMU);
+  preintIMU_msg->header.stamp = ros_time_from_start_time(msg->time);
+  preintIMU_msg->header.frame_id = frame_id_;
+  preintIMU_msg->dtheta.x = msg->theta1[0];
+  preintIMU_msg->dtheta.y = msg->theta1[1];
+  preintIMU_msg->dtheta.z = msg->theta1[2];
 
-  preintIMU_msg.dvel.x = msg->vel1[0];
-  preintIMU_msg.dvel.y = msg->vel1[1];
-  preintIMU_msg.dvel.z = msg->vel1[2];
+  preintIMU_msg->dvel.x = msg->vel1[0];
+  preintIMU_msg->dvel.y = msg->vel1[1];
+  preintIMU_msg->dvel.z = msg->vel1[2];
 
-  preintIMU_msg.dt = msg->dt;
+  preintIMU_msg->dt = msg->dt;
 
-  dt_vel_.pub.publish(preintIMU_msg);
+  publish(dt_vel_.pub, preintIMU_msg);
 }
 
 void InertialSenseROS::RTK_Misc_callback(const gps_rtk_misc_t* const msg)
 {
   if (RTK_.enabled && GPS_towOffset_ > 0.001)
   {
-    inertial_sense::RTKInfo rtk_info;
-    rtk_info.header.stamp = ros_time_from_week_and_tow(GPS_week_, msg->timeOfWeekMs/1000.0);
-    rtk_info.baseAntcount = msg->baseAntennaCount;
-    rtk_info.baseEph = msg->baseBeidouEphemerisCount + msg->baseGalileoEphemerisCount + msg->baseGlonassEphemerisCount
-                       + msg->baseGpsEphemerisCount;
-    rtk_info.baseObs = msg->baseBeidouObservationCount + msg->baseGalileoObservationCount + msg->baseGlonassObservationCount
-                       + msg->baseGpsObservationCount;
-    rtk_info.BaseLLA[0] = msg->baseLla[0];
-    rtk_info.BaseLLA[1] = msg->baseLla[1];
-    rtk_info.BaseLLA[2] = msg->baseLla[2];
-
-    rtk_info.roverEph = msg->roverBeidouEphemerisCount + msg->roverGalileoEphemerisCount + msg->roverGlonassEphemerisCount
-                        + msg->roverGpsEphemerisCount;
-    rtk_info.roverObs = msg->roverBeidouObservationCount + msg->roverGalileoObservationCount + msg->roverGlonassObservationCount
-                        + msg->roverGpsObservationCount;
-    rtk_info.cycle_slip_count = msg->cycleSlipCount;
-    RTK_.pub.publish(rtk_info);
+    inertial_sense::RTKInfo::Ptr rtk_info(new inertial_sense::RTKInfo);
+    rtk_info->header.stamp = ros_time_from_week_and_tow(GPS_week_, msg->timeOfWeekMs/1000.0);
+    rtk_info->baseAntcount = msg->baseAntennaCount;
+    rtk_info->baseEph = msg->baseBeidouEphemerisCount + msg->baseGalileoEphemerisCount + msg->baseGlonassEphemerisCount
+                        + msg->baseGpsEphemerisCount;
+    rtk_info->baseObs = msg->baseBeidouObservationCount + msg->baseGalileoObservationCount + msg->baseGlonassObservationCount
+                        + msg->baseGpsObservationCount;
+    rtk_info->BaseLLA[0] = msg->baseLla[0];
+    rtk_info->BaseLLA[1] = msg->baseLla[1];
+    rtk_info->BaseLLA[2] = msg->baseLla[2];
+
+    rtk_info->roverEph = msg->roverBeidouEphemerisCount + msg->roverGalileoEphemerisCount + msg->roverGlonassEphemerisCount
+                         + msg->roverGpsEphemerisCount;
+    rtk_info->roverObs = msg->roverBeidouObservationCount + msg->roverGalileoObservationCount + msg->roverGlonassObservationCount
+                         + msg->roverGpsObservationCount;
+    rtk_info->cycle_slip_count = msg->cycleSlipCount;
+    publish(RTK_.pub, rtk_info);
   }
 }
 
@@ -640,30 +1645,30 @@ void InertialSenseROS::RTK_Rel_callback(const gps_rtk_rel_t* const msg)
 {
   if (RTK_.enabled && GPS_towOffset_ > 0.001)
   {
-    inertial_sense::RTKRel rtk_rel;
-    rtk_rel.header.stamp = ros_time_from_week_and_tow(GPS_week_, msg->timeOfWeekMs/1000.0);
-    rtk_rel.differential_age = msg->differentialAge;
-    rtk_rel.ar_ratio = msg->arRatio;
-    rtk_rel.vector_base_to_rover.x = msg->baseToRoverVector[0];
-    rtk_rel.vector_base_to_rover.y = msg->baseToRoverVector[1];
-    rtk_rel.vector_base_to_rover.z = msg->baseToRoverVector[2];
-    rtk_rel.distance_base_to_rover = msg->baseToRoverDistance;
-    rtk_rel.heading_base_to_rover = msg->baseToRoverHeading;
-    RTK_.pub2.publish(rtk_rel);
+    inertial_sense::RTKRel::Ptr rtk_rel(new inertial_sense::RTKRel);
+    rtk_rel->header.stamp = ros_time_from_week_and_tow(GPS_week_, msg->timeOfWeekMs/1000.0);
+    rtk_rel->differential_age = msg->differentialAge;
+    rtk_rel->ar_ratio = msg->arRatio;
+    rtk_rel->vector_base_to_rover.x = msg->baseToRoverVector[0];
+    rtk_rel->vector_base_to_rover.y = msg->baseToRoverVector[1];
+    rtk_rel->vector_base_to_rover.z = msg->baseToRoverVector[2];
+    rtk_rel->distance_base_to_rover = msg->baseToRoverDistance;
+    rtk_rel->heading_base_to_rover = msg->baseToRoverHeading;
+    publish(RTK_.pub2, rtk_rel);
 
     // save for diagnostics
-    diagnostic_ar_ratio_ = rtk_rel.ar_ratio;
-    diagnostic_differential_age_ = rtk_rel.differential_age;
-    diagnostic_heading_base_to_rover_ = rtk_rel.heading_base_to_rover;
+    diagnostic_ar_ratio_ = rtk_rel->ar_ratio;
+    diagnostic_differential_age_ = rtk_rel->differential_age;
+    diagnostic_heading_base_to_rover_ = rtk_rel->heading_base_to_rover;
   }
 }
 
-void InertialSenseROS::GPS_raw_callback(const gps_raw_t * const msg)
+void InertialSenseROS::GPS_raw_callback(const gps_raw_t * const msg, int receiver)
 {
   switch(msg->dataType)
   {
   case raw_data_type_observation:
-    GPS_obs_callback((obsd_t*)&msg->data.obs, msg->obsCount);
+    GPS_obs_callback(receiver, (obsd_t*)&msg->data.obs, msg->obsCount);
     break;
 
   case raw_data_type_ephemeris:
@@ -679,122 +1684,176 @@ void InertialSenseROS::GPS_raw_callback(const gps_raw_t * const msg)
   }
 }
 
-void InertialSenseROS::GPS_obs_callback(const obsd_t * const msg, int nObs)
+void InertialSenseROS::GPS_obs_callback(int receiver, const obsd_t * const msg, int nObs)
 {
-  if (obs_Vec_.obs.size() > 0 &&
-       (msg[0].time.time != obs_Vec_.obs[0].time.time ||
-        msg[0].time.sec != obs_Vec_.obs[0].time.sec))
-      GPS_obs_bundle_timer_callback(ros::TimerEvent());
+  if (nObs <= 0)
+    return;
+  obs_bundle_t& bundle = obs_bundles_[receiver];
 
+  if (!bundle.started || msg[0].time.time != bundle.time.time || msg[0].time.sec != bundle.time.sec)
+  {
+    // observations from a new epoch mean the previous one is complete
+    if (bundle.started && !bundle.closed)
+      GPS_obs_epoch_close(bundle);
+    bundle.time = msg[0].time;
+    bundle.started = true;
+    bundle.published = false;
+    bundle.closed = false;
+    bundle.total = 0;
+  }
+  bundle.total += nObs;
+
+  // both formats are filled in the same pass over the observations
   for (int i = 0; i < nObs; i++)
   {
-      inertial_sense::GNSSObservation obs;
-      obs.header.stamp = ros_time_from_gtime(msg[i].time.time, msg[i].time.sec);
-      obs.time.time = msg[i].time.time;
-      obs.time.sec = msg[i].time.sec;
-      obs.sat = msg[i].sat;
-      obs.rcv = msg[i].rcv;
-      obs.SNR = msg[i].SNR[0];
-      obs.LLI = msg[i].LLI[0];
-      obs.code = msg[i].code[0];
-      obs.qualL = msg[i].qualL[0];
-      obs.qualP = msg[i].qualP[0];
-      obs.L = msg[i].L[0];
-      obs.P = msg[i].P[0];
-      obs.D = msg[i].D[0];
-      obs_Vec_.obs.push_back(obs);
-      last_obs_time_ = ros::Time::now();
+    if (bundle.count >= MAX_OBS_PER_BUNDLE)
+    {
+      bundle.dropped++;
+      continue;
+    }
+    if (obs_vec_enabled_)
+    {
+      bundle.msg.obs.emplace_back();
+      gnss_obs_to_msg(msg[i], ros_time_from_gtime(msg[i].time.time, msg[i].time.sec), bundle.msg.obs.back());
+    }
+    if (obs_epoch_enabled_)
+      gnss_obs_epoch_append(msg[i], bundle.epoch);
+    bundle.count++;
+  }
+
+  // The uINS sends an epoch as full packets followed by a partial one, so a short packet ends the
+  // epoch.  Reaching the count of the last complete epoch publishes it without waiting for the
+  // next one, though the epoch stays open to learn its real size.  Otherwise wait for the next
+  // epoch or the deadline.  Observations that come after their epoch went out (it was bigger than
+  // the last one, or a packet was late) go out in a follow-up bundle for the same epoch.
+  if (nObs < MAX_OBSERVATION_COUNT_IN_RTK_MESSAGE)
+    GPS_obs_epoch_close(bundle);
+  else if (bundle.closed)
+    GPS_obs_bundle_publish(bundle);
+  else if (!bundle.published && bundle.expected > 0 && bundle.count >= bundle.expected)
+    GPS_obs_bundle_publish(bundle);
+  else
+  {
+    bundle.deadline.stop();
+    bundle.deadline.start();
   }
 }
 
-void InertialSenseROS::GPS_obs_bundle_timer_callback(const ros::TimerEvent &e)
+void InertialSenseROS::GPS_obs_epoch_close(obs_bundle_t& bundle)
 {
-    if (obs_Vec_.obs.size() == 0)
-        return;
+  if (!bundle.published || bundle.count > 0)
+    GPS_obs_bundle_publish(bundle);
+  // only an epoch whose end was seen tells how many observations to wait for
+  bundle.expected = bundle.total;
+  bundle.closed = true;
+}
 
-    if ((ros::Time::now() - last_obs_time_).toSec() > 1e-2)
-    {
-        obs_Vec_.header.stamp = ros_time_from_gtime(obs_Vec_.obs[0].time.time, obs_Vec_.obs[0].time.sec);
-        obs_Vec_.time = obs_Vec_.obs[0].time;
-        GPS_obs_.pub.publish(obs_Vec_);
-        obs_Vec_.obs.clear();
-//        cout << "dt" << (obs_Vec_.header.stamp - ros::Time::now()) << endl;
-    }
+void InertialSenseROS::GPS_obs_bundle_publish(obs_bundle_t& bundle)
+{
+  ros::Time stamp = ros_time_from_gtime(bundle.time.time, bundle.time.sec);
+  if (obs_vec_enabled_)
+  {
+    bundle.msg.header.stamp = stamp;
+    bundle.msg.time.time = bundle.time.time;
+    bundle.msg.time.sec = bundle.time.sec;
+    publish_copy(GPS_obs_.pub, bundle.msg);
+    bundle.msg.obs.clear(); // keeps the reserved storage
+  }
+  if (obs_epoch_enabled_)
+  {
+    bundle.epoch.header.stamp = stamp;
+    bundle.epoch.time.time = bundle.time.time;
+    bundle.epoch.time.sec = bundle.time.sec;
+    publish_copy(obs_epoch_pub_, bundle.epoch);
+    gnss_obs_epoch_clear(bundle.epoch);
+  }
+  if (bundle.published)
+    bundle.followups++;
+  bundle.count = 0;
+  bundle.published = true;
+  bundle.deadline.stop();
+}
+
+void InertialSenseROS::GPS_obs_bundle_timer_callback(int receiver)
+{
+  obs_bundle_t& bundle = obs_bundles_[receiver];
+  if (bundle.started && bundle.count > 0)
+    GPS_obs_bundle_publish(bundle);
 }
 
 
 void InertialSenseROS::GPS_eph_callback(const eph_t * const msg)
 {
-  inertial_sense::GNSSEphemeris eph;
-  eph.sat = msg->sat;
-  eph.iode = msg->iode;
-  eph.iodc = msg->iodc;
-  eph.sva = msg->sva;
-  eph.svh = msg->svh;
-  eph.week = msg->week;
-  eph.code = msg->code;
-  eph.flag = msg->flag;
-  eph.toe.time = msg->toe.time;
-  eph.toc.time = msg->toc.time;
-  eph.ttr.time = msg->ttr.time;
-  eph.toe.sec = msg->toe.sec;
-  eph.toc.sec = msg->toc.sec;
-  eph.ttr.sec = msg->ttr.sec;
-  eph.A = msg->A;
-  eph.e = msg->e;
-  eph.i0 = msg->i0;
-  eph.OMG0 = msg->OMG0;
-  eph.omg = msg->omg;
-  eph.M0 = msg->M0;
-  eph.deln = msg->deln;
-  eph.OMGd = msg->OMGd;
-  eph.idot = msg->idot;
-  eph.crc = msg->crc;
-  eph.crs = msg->crs;
-  eph.cuc = msg->cuc;
-  eph.cus = msg->cus;
-  eph.cic = msg->cic;
-  eph.cis = msg->cis;
-  eph.toes = msg->toes;
-  eph.fit = msg->fit;
-  eph.f0 = msg->f0;
-  eph.f1 = msg->f1;
-  eph.f2 = msg->f2;
-  eph.tgd[0] = msg->tgd[0];
-  eph.tgd[1] = msg->tgd[1];
-  eph.tgd[2] = msg->tgd[2];
-  eph.tgd[3] = msg->tgd[3];
-  eph.Adot = msg->Adot;
-  eph.ndot = msg->ndot;
-  GPS_eph_.pub.publish(eph);
+  inertial_sense::GNSSEphemeris::Ptr eph(new inertial_sense::GNSSEphemeris);
+  eph->sat = msg->sat;
+  eph->iode = msg->iode;
+  eph->iodc = msg->iodc;
+  eph->sva = msg->sva;
+  eph->svh = msg->svh;
+  eph->week = msg->week;
+  eph->code = msg->code;
+  eph->flag = msg->flag;
+  eph->toe.time = msg->toe.time;
+  eph->toc.time = msg->toc.time;
+  eph->ttr.time = msg->ttr.time;
+  eph->toe.sec = msg->toe.sec;
+  eph->toc.sec = msg->toc.sec;
+  eph->ttr.sec = msg->ttr.sec;
+  eph->A = msg->A;
+  eph->e = msg->e;
+  eph->i0 = msg->i0;
+  eph->OMG0 = msg->OMG0;
+  eph->omg = msg->omg;
+  eph->M0 = msg->M0;
+  eph->deln = msg->deln;
+  eph->OMGd = msg->OMGd;
+  eph->idot = msg->idot;
+  eph->crc = msg->crc;
+  eph->crs = msg->crs;
+  eph->cuc = msg->cuc;
+  eph->cus = msg->cus;
+  eph->cic = msg->cic;
+  eph->cis = msg->cis;
+  eph->toes = msg->toes;
+  eph->fit = msg->fit;
+  eph->f0 = msg->f0;
+  eph->f1 = msg->f1;
+  eph->f2 = msg->f2;
+  eph->tgd[0] = msg->tgd[0];
+  eph->tgd[1] = msg->tgd[1];
+  eph->tgd[2] = msg->tgd[2];
+  eph->tgd[3] = msg->tgd[3];
+  eph->Adot = msg->Adot;
+  eph->ndot = msg->ndot;
+  publish(GPS_eph_.pub, eph);
 }
 
 void InertialSenseROS::GPS_geph_callback(const geph_t * const msg)
 {
-  inertial_sense::GlonassEphemeris geph;
-  geph.sat = msg->sat;
-  geph.iode = msg->iode;
-  geph.frq = msg->frq;
-  geph.svh = msg->svh;
-  geph.sva = msg->sva;
-  geph.age = msg->age;
-  geph.toe.time = msg->toe.time;
-  geph.tof.time = msg->tof.time;
-  geph.toe.sec = msg->toe.sec;
-  geph.tof.sec = msg->tof.sec;
-  geph.pos[0] = msg->pos[0];
-  geph.pos[1] = msg->pos[1];
-  geph.pos[2] = msg->pos[2];
-  geph.vel[0] = msg->vel[0];
-  geph.vel[1] = msg->vel[1];
-  geph.vel[2] = msg->vel[2];
-  geph.acc[0] = msg->acc[0];
-  geph.acc[1] = msg->acc[1];
-  geph.acc[2] = msg->acc[2];
-  geph.taun = msg->taun;
-  geph.gamn = msg->gamn;
-  geph.dtaun = msg->dtaun;
-  GPS_eph_.pub2.publish(geph);
+  inertial_sense::GlonassEphemeris::Ptr geph(new inertial_sense::GlonassEphemeris);
+  geph->sat = msg->sat;
+  geph->iode = msg->iode;
+  geph->frq = msg->frq;
+  geph->svh = msg->svh;
+  geph->sva = msg->sva;
+  geph->age = msg->age;
+  geph->toe.time = msg->toe.time;
+  geph->tof.time = msg->tof.time;
+  geph->toe.sec = msg->toe.sec;
+  geph->tof.sec = msg->tof.sec;
+  geph->pos[0] = msg->pos[0];
+  geph->pos[1] = msg->pos[1];
+  geph->pos[2] = msg->pos[2];
+  geph->vel[0] = msg->vel[0];
+  geph->vel[1] = msg->vel[1];
+  geph->vel[2] = msg->vel[2];
+  geph->acc[0] = msg->acc[0];
+  geph->acc[1] = msg->acc[1];
+  geph->acc[2] = msg->acc[2];
+  geph->taun = msg->taun;
+  geph->gamn = msg->gamn;
+  geph->dtaun = msg->dtaun;
+  publish(GPS_eph_.pub2, geph);
 }
 
 void InertialSenseROS::diagnostics_callback(const ros::TimerEvent& event)
@@ -850,131 +1909,162 @@ void InertialSenseROS::diagnostics_callback(const ros::TimerEvent& event)
     diag_array.status.push_back(rtk_status);
   }
 
+  if (pipeline_ && pipeline_->running())
+  {
+    SerialPipeline::stats_t stats = pipeline_->stats();
+    diagnostic_msgs::DiagnosticStatus pipeline_status;
+    pipeline_status.name = "Serial Pipeline";
+    pipeline_status.level = stats.overflow_bytes ? diagnostic_msgs::DiagnosticStatus::WARN : diagnostic_msgs::DiagnosticStatus::OK;
+    pipeline_status.message = stats.overflow_bytes ? "Ring overflowed, increase pipeline_ring_size" : "OK";
+
+    diagnostic_msgs::KeyValue kv;
+    kv.key = "Ring Size (bytes)";
+    kv.value = std::to_string(stats.capacity);
+    pipeline_status.values.push_back(kv);
+    kv.key = "Fill (bytes)";
+    kv.value = std::to_string(stats.fill);
+    pipeline_status.values.push_back(kv);
+    kv.key = "High Water (bytes)";
+    kv.value = std::to_string(stats.high_water);
+    pipeline_status.values.push_back(kv);
+    kv.key = "Bytes Read";
+    kv.value = std::to_string(stats.bytes_in);
+    pipeline_status.values.push_back(kv);
+    kv.key = "Overflow (bytes)";
+    kv.value = std::to_string(stats.overflow_bytes);
+    pipeline_status.values.push_back(kv);
+    kv.key = "Overflow Events";
+    kv.value = std::to_string(stats.overflow_events);
+    pipeline_status.values.push_back(kv);
+    diag_array.status.push_back(pipeline_status);
+  }
+
+  did_stats_diagnostics(diag_array);
+  time_sync_diagnostics(diag_array);
+  connection_diagnostics(diag_array);
+  obs_diagnostics(diag_array);
+  log_diagnostics(diag_array);
+
   diagnostics_.pub.publish(diag_array);
 }
 
-bool InertialSenseROS::set_current_position_as_refLLA(std_srvs::Trigger::Request &req, std_srvs::Trigger::Response &res)
+bool InertialSenseROS::run_command(const CommandEngine::command_t& command, CommandEngine::result_t& result)
 {
-  (void)req;
-  double current_lla_[3];
-  current_lla_[0] = lla_[0];
-  current_lla_[1] = lla_[1];
-  current_lla_[2] = lla_[2];
-
-  IS_.SendData(DID_FLASH_CONFIG, reinterpret_cast<uint8_t*>(&current_lla_), sizeof(current_lla_), offsetof(nvm_flash_cfg_t, refLla));
+  std::future<CommandEngine::result_t> future = commands_.submit(command);
+  // the engine times the command out itself, this only guards against the connection's thread stopping
+  if (future.wait_for(std::chrono::duration<double>(command.timeout_s + 1.0)) != std::future_status::ready)
+    return false;
+  result = future.get();
+  return result.success;
+}
 
-  comManagerGetData(0, DID_FLASH_CONFIG, 0, 0, 1);
+bool InertialSenseROS::write_refLLA(const double* lla, std::string& message)
+{
+  std::shared_ptr<std::array<double, 3>> value(new std::array<double, 3>());
+  bool current = (lla == NULL);
+  if (!current)
+    std::copy(lla, lla + 3, value->begin());
 
-  int i = 0;
-  nvm_flash_cfg_t current_flash = IS_.GetFlashConfig();
-  while (current_flash.refLla[0] == IS_.GetFlashConfig().refLla[0] && current_flash.refLla[1] == IS_.GetFlashConfig().refLla[1] && current_flash.refLla[2] == IS_.GetFlashConfig().refLla[2])
+  CommandEngine::command_t command;
+  command.write = [this, value, current]() mutable
   {
-      comManagerStep();
-      i++;
-      if(i>100){break;}
+    if (current)
+    {
+      // the position is only touched on this thread, and retries write the same one
+      std::copy(lla_, lla_ + 3, value->begin());
+      current = false;
     }
-
-  if(current_lla_[0] == IS_.GetFlashConfig().refLla[0] && current_lla_[1] == IS_.GetFlashConfig().refLla[1] && current_lla_[2] == IS_.GetFlashConfig().refLla[2])
+    send_data(DID_FLASH_CONFIG, value->data(), sizeof(*value), offsetof(nvm_flash_cfg_t, refLla));
+    comManagerGetData(device_, DID_FLASH_CONFIG, 0, 0, 0);  // once, its echo answers the command
+  };
+  command.did = DID_FLASH_CONFIG;
+  command.match = [value](const p_data_t* data)
   {
-      comManagerGetData(0, DID_FLASH_CONFIG, 0, 0, 0);
-      res.success = true;
-      res.message = ("Update was succesful.  refLla: Lat: " + to_string(current_lla_[0]) + "  Lon: " +to_string( current_lla_[1]) + "  Alt: " + to_string(current_lla_[2]));
-    }
-  else
+    const uint32_t offset = offsetof(nvm_flash_cfg_t, refLla);
+    return data_covers(data, offset, sizeof(*value)) &&
+           memcmp(data->buf + (offset - data->hdr.offset), value->data(), sizeof(*value)) == 0;
+  };
+  command.timeout_s = 2.0;
+  command.retry_s = 0.5;
+
+  CommandEngine::result_t result;
+  if (!run_command(command, result))
   {
-      comManagerGetData(0, DID_FLASH_CONFIG, 0, 0, 0);
-      res.success = false;
-      res.message = "Unable to update refLLA. Please try again.";
-
-  }
-    
+    message = "Unable to update refLLA. Please try again.";
+    return false;
   }
+  message = "Update was succesful.  refLla: Lat: " + to_string((*value)[0]) + "  Lon: " + to_string((*value)[1]) +
+            "  Alt: " + to_string((*value)[2]);
+  return true;
+}
 
-bool InertialSenseROS::set_refLLA_to_value(inertial_sense::refLLAUpdate::Request &req, inertial_sense::refLLAUpdate::Response &res)
-{
-  IS_.SendData(DID_FLASH_CONFIG, reinterpret_cast<uint8_t*>(&req.lla), sizeof(req.lla), offsetof(nvm_flash_cfg_t, refLla));
-
-  comManagerGetData(0, DID_FLASH_CONFIG, 0, 0, 1);
-
-  int i = 0;
-  nvm_flash_cfg_t current_flash = IS_.GetFlashConfig();
-  while (current_flash.refLla[0] == IS_.GetFlashConfig().refLla[0] && current_flash.refLla[1] == IS_.GetFlashConfig().refLla[1] && current_flash.refLla[2] == IS_.GetFlashConfig().refLla[2])
+bool InertialSenseROS::set_current_position_as_refLLA(std_srvs::Trigger::Request &req, std_srvs::Trigger::Response &res)
 {
-      comManagerStep();
-      i++;
-      if(i>100){break;}
+  (void)req;
+  res.success = write_refLLA(NULL, res.message);
+  return true;
 }
 
-  if(req.lla[0] == IS_.GetFlashConfig().refLla[0] && req.lla[1] == IS_.GetFlashConfig().refLla[1] && req.lla[2] == IS_.GetFlashConfig().refLla[2])
+bool InertialSenseROS::set_refLLA_to_value(inertial_sense::refLLAUpdate::Request &req, inertial_sense::refLLAUpdate::Response &res)
 {
-      comManagerGetData(0, DID_FLASH_CONFIG, 0, 0, 0);
-  res.success = true;
-      res.message = ("Update was succesful.  refLla: Lat: " + to_string(req.lla[0]) + "  Lon: " +to_string( req.lla[1]) + "  Alt: " + to_string(req.lla[2]));
+  res.success = write_refLLA(req.lla.data(), res.message);
+  return true;
 }
-  else
+
+bool InertialSenseROS::start_mag_cal(uint32_t recal_command, std::string& message)
 {
-      comManagerGetData(0, DID_FLASH_CONFIG, 0, 0, 0);
-      res.success = false;
-      res.message = "Unable to update refLLA. Please try again.";
+  bool ins_streamed = INS_.enabled;
+
+  CommandEngine::command_t command;
+  command.write = [this, recal_command, ins_streamed]()
+  {
+    // the INS status answers, so it has to come in even when the INS isn't published
+    if (!ins_streamed)
+    {
+      if (!did_callbacks_[DID_INS_1])
+        set_callback(DID_INS_1, [](const p_data_t* data) { (void)data; }, 1);
+      else
+        set_broadcast_period(DID_INS_1, 1);
+    }
+    uint32_t cmd = recal_command;
+    send_data(DID_MAG_CAL, &cmd, sizeof(cmd), offsetof(mag_cal_t, recalCmd));
+  };
+  command.did = DID_INS_1;
+  command.match = [](const p_data_t* data)
+  {
+    const uint32_t offset = offsetof(ins_1_t, insStatus);
+    uint32_t status;
+    if (!data_covers(data, offset, sizeof(status)))
+      return false;
+    memcpy(&status, data->buf + (offset - data->hdr.offset), sizeof(status));
+    return (status & INS_STATUS_MAG_RECALIBRATING) != 0;  // set while a recalibration runs
+  };
+  command.timeout_s = 3.0;
+  command.retry_s = 1.0;
+
+  CommandEngine::result_t result;
+  bool success = run_command(command, result);
+  if (!ins_streamed)
+  {
+    CommandEngine::command_t stop = { [this]() { set_broadcast_period(DID_INS_1, 0); }, 0, CommandEngine::match_t(), 1.0, 0.0 };
+    commands_.submit(stop);
   }
+  message = success ? "Successfully initiated mag recalibration." : "The uINS didn't start mag recalibration.";
+  return success;
 }
 
 bool InertialSenseROS::perform_mag_cal_srv_callback(std_srvs::Trigger::Request &req, std_srvs::Trigger::Response &res)
 {
   (void)req;
-    uint32_t single_axis_command = 2;
-    IS_.SendData(DID_MAG_CAL, reinterpret_cast<uint8_t*>(&single_axis_command), sizeof(uint32_t), offsetof(mag_cal_t, recalCmd));
-
-    is_comm_instance_t comm;
-    uint8_t buffer[2048];
-  is_comm_init(&comm, buffer, sizeof(buffer));
-    serial_port_t* serialPort = IS_.GetSerialPort();
-  uint8_t inByte;
-  int n;
-
-  while ((n = serialPortReadCharTimeout(serialPort, &inByte, 20)) > 0)
-    {
-    // Search comm buffer for valid packets
-    if (is_comm_parse_byte(&comm, inByte) == _PTYPE_INERTIAL_SENSE_DATA && comm.dataHdr.id == DID_INS_1)
-        {
-      ins_1_t* msg = (ins_1_t*)(comm.dataPtr + comm.dataHdr.offset);
-            if (msg->insStatus & 0x00400000)
-            {
-  res.success = true;
-                res.message = "Successfully initiated mag recalibration.";
-                return true;
-            }
-        }
-    }
+  res.success = start_mag_cal(2, res.message);  // single axis
+  return true;
 }
 
 bool InertialSenseROS::perform_multi_mag_cal_srv_callback(std_srvs::Trigger::Request &req, std_srvs::Trigger::Response &res)
 {
   (void)req;
-  uint32_t multi_axis_command = 1;
-  IS_.SendData(DID_MAG_CAL, reinterpret_cast<uint8_t*>(&multi_axis_command), sizeof(uint32_t), offsetof(mag_cal_t, recalCmd));
-
-  is_comm_instance_t comm;
-  uint8_t buffer[2048];
-  is_comm_init(&comm, buffer, sizeof(buffer));
-  serial_port_t* serialPort = IS_.GetSerialPort();
-  uint8_t inByte;
-  int n;
-
-  while ((n = serialPortReadCharTimeout(serialPort, &inByte, 20)) > 0)
-  {
-    // Search comm buffer for valid packets
-    if (is_comm_parse_byte(&comm, inByte) == _PTYPE_INERTIAL_SENSE_DATA && comm.dataHdr.id == DID_INS_1)
-      {
-      ins_1_t* msg = (ins_1_t*)(comm.dataPtr + comm.dataHdr.offset);
-          if (msg->insStatus & 0x00400000)
-          {
-  res.success = true;
-        res.message = "Successfully initiated mag recalibration.";
-              return true;
-          }
-      }
-  }
+  res.success = start_mag_cal(1, res.message);  // multi axis
+  return true;
 }
 
 void InertialSenseROS::reset_device()
@@ -983,12 +2073,15 @@ void InertialSenseROS::reset_device()
   system_command_t reset_command;
   reset_command.command = 99;
   reset_command.invCommand = ~reset_command.command;
-  IS_.SendData(DID_SYS_CMD, reinterpret_cast<uint8_t*>(&reset_command), sizeof(system_command_t), 0);
-  sleep(1);
+  send_data(DID_SYS_CMD, reinterpret_cast<uint8_t*>(&reset_command), sizeof(system_command_t), 0);
 }
 
 bool InertialSenseROS::update_firmware_srv_callback(inertial_sense::FirmwareUpdate::Request &req, inertial_sense::FirmwareUpdate::Response &res)
 {
+  if (pipeline_)
+    pipeline_->stop();
+  if (log_writer_)
+    log_writer_->detach();
   IS_.Close();
   vector<InertialSense::bootloader_result_t> results = IS_.BootloadFile("*", req.filename, 921600);
   if (!results[0].error.empty())
@@ -997,68 +2090,260 @@ bool InertialSenseROS::update_firmware_srv_callback(inertial_sense::FirmwareUpda
     res.message = results[0].error;
     return false;
   }
-  IS_.Open(port_.c_str(), baudrate_);
+  if (!IS_.Open(port_.c_str(), baudrate_) || !serialPortPlatformAdopt(IS_.GetSerialPort(device_), baudrate_))
+    ROS_ERROR("inertialsense: unable to re-open serial port \"%s\" after the firmware update", port_.c_str());
+  else if (log_writer_ && !log_writer_->attach(IS_.GetSerialPort(device_)))
+    ROS_ERROR("inertialsense: unable to resume the raw log after the firmware update");
+  // in pipeline mode the raw log moves on top of the reader thread
+  start_pipeline();
   return true;
 }
 
 
 ros::Time InertialSenseROS::ros_time_from_week_and_tow(const uint32_t week, const double timeOfWeek)
 {
-  ros::Time rostime(0, 0);
+  // converting a log there's no host clock, the uINS time is the stamp
+  if (offline_ && GPS_towOffset_ <= 0.001)
+    return ros::Time(timeOfWeek);
+
   //  If we have a GPS fix, then use it to set timestamp
   if (GPS_towOffset_ > 0.001)
   {
     uint64_t sec = UNIX_TO_GPS_OFFSET + floor(timeOfWeek) + week*7*24*3600;
     uint64_t nsec = (timeOfWeek - floor(timeOfWeek))*1e9;
-    rostime = ros::Time(sec, nsec);
+    ros::Time gps_time(sec, nsec);
+    if (offline_)
+      return gps_time;
+
+    // keep the boot clock estimate current, it's what stamps are handed over from
+    double boot_time = timeOfWeek - GPS_towOffset_ + ((double)week - (double)GPS_week_) * 7*24*3600;
+    double estimate = boot_clock_.update(boot_time, host_arrival_time());
+    if (!boot_clock_.bins_used() && tow_clock_.valid())
+      estimate = tow_clock_.to_host(timeOfWeek);
+    return gps_time + ros::Duration(gps_handover_.correction(gps_time.toSec(), estimate));
   }
-  else
-  {
-    // Otherwise, estimate the uINS boot time and offset the messages
-    if (!got_first_message_)
-    {
-      got_first_message_ = true;
-      INS_local_offset_ = ros::Time::now().toSec() - timeOfWeek;
-    }
-    else // low-pass filter offset to account for drift
-    {
-      double y_offset = ros::Time::now().toSec() - timeOfWeek;
-      INS_local_offset_ = 0.005 * y_offset + 0.995 * INS_local_offset_;
-    }
-    // Publish with ROS time
-    rostime = ros::Time(INS_local_offset_ + timeOfWeek);
-  }
-  return rostime;
+
+  // Otherwise, estimate the uINS clock from when its data arrives
+  return ros::Time(tow_clock_.update(timeOfWeek, host_arrival_time()));
 }
 
 ros::Time InertialSenseROS::ros_time_from_start_time(const double time)
 {
-  ros::Time rostime(0, 0);
-  
+  if (offline_ && GPS_towOffset_ <= 0.001)
+    return ros::Time(time);
+
   //  If we have a GPS fix, then use it to set timestamp
   if (GPS_towOffset_ > 0.001)
   {
     uint64_t sec = UNIX_TO_GPS_OFFSET + floor(time + GPS_towOffset_) + GPS_week_*7*24*3600;
     uint64_t nsec = (time + GPS_towOffset_ - floor(time + GPS_towOffset_))*1e9;
-    rostime = ros::Time(sec, nsec);
+    ros::Time gps_time(sec, nsec);
+    if (offline_)
+      return gps_time;
+    double estimate = boot_clock_.update(time, host_arrival_time());
+    return gps_time + ros::Duration(gps_handover_.correction(gps_time.toSec(), estimate));
   }
+
+  // Otherwise, estimate the uINS clock from when its data arrives
+  return ros::Time(boot_clock_.update(time, host_arrival_time()));
+}
+
+double InertialSenseROS::host_arrival_time()
+{
+  double now = ros::Time::now().toSec();
+  // with the pipeline we know how long ago the bytes came off the port, without our own queueing
+  if (pipeline_ && pipeline_->running() && pipeline_->last_arrival_ns())
+    now -= (did_stats_now_ns() - pipeline_->last_arrival_ns()) * 1e-9;
+  return now;
+}
+
+void InertialSenseROS::load_time_sync()
+{
+  std::string ros_home = getenv("ROS_HOME") ? getenv("ROS_HOME") : std::string(getenv("HOME") ? getenv("HOME") : ".") + "/.ros";
+  param<std::string>("time_sync_file", time_sync_file_,
+                                 ros_home + "/inertial_sense_time_sync_" + std::to_string(IS_.GetDeviceInfo(device_).serialNumber));
+  double slew_rate, max_slew;
+  param<double>("time_sync_slew_rate", slew_rate, 0.01);
+  param<double>("time_sync_max_slew", max_slew, 1.0);
+  gps_handover_ = TimeHandover(slew_rate, max_slew);
+
+  clock_sync_state_t state;
+  if (!time_sync_file_.empty() && clock_sync_load(time_sync_file_, state))
+  {
+    boot_clock_.seed(state.device_s, state.host_s, state.skew);
+    ROS_INFO("inertialsense: time sync starting from %s (skew %.2f ppm)", time_sync_file_.c_str(), state.skew * 1e6);
+  }
+}
+
+void InertialSenseROS::save_time_sync()
+{
+  if (time_sync_file_.empty() || boot_clock_.bins_used() == 0)
+    return;
+  clock_sync_state_t state;
+  state.skew = boot_clock_.skew();
+  state.device_s = boot_clock_.last_device_time();
+  state.host_s = boot_clock_.to_host(state.device_s);
+  if (!clock_sync_save(time_sync_file_, state))
+    ROS_WARN("inertialsense: unable to save time sync state to %s", time_sync_file_.c_str());
+}
+
+void InertialSenseROS::time_sync_diagnostics(diagnostic_msgs::DiagnosticArray& diag_array)
+{
+  diagnostic_msgs::DiagnosticStatus status;
+  status.name = "Time Sync";
+  status.level = diagnostic_msgs::DiagnosticStatus::OK;
+  if (GPS_towOffset_ > 0.001)
+    status.message = gps_handover_.current() != 0.0 ? "GPS (slewing from estimate)" : "GPS";
+  else if (boot_clock_.valid() || tow_clock_.valid())
+    status.message = "Estimated from arrival times";
   else
   {
-    // Otherwise, estimate the uINS boot time and offset the messages
-    if (!got_first_message_)
-    {
-      got_first_message_ = true;
-      INS_local_offset_ = ros::Time::now().toSec() - time;
-    }
-    else // low-pass filter offset to account for drift
+    status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+    status.message = "No time stamps yet";
+  }
+
+  diagnostic_msgs::KeyValue kv;
+  kv.key = "Skew (ppm)";
+  kv.value = std::to_string(boot_clock_.skew() * 1e6);
+  status.values.push_back(kv);
+  kv.key = "Latency bias above envelope (ms)";
+  kv.value = std::to_string(boot_clock_.residual_mean() * 1e3);
+  status.values.push_back(kv);
+  kv.key = "Latency jitter (ms)";
+  kv.value = std::to_string(boot_clock_.residual_stddev() * 1e3);
+  status.values.push_back(kv);
+  kv.key = "Envelope bins";
+  kv.value = std::to_string(boot_clock_.bins_used());
+  status.values.push_back(kv);
+  kv.key = "Resets";
+  kv.value = std::to_string(boot_clock_.resets() + tow_clock_.resets());
+  status.values.push_back(kv);
+  kv.key = "GPS handover correction (ms)";
+  kv.value = std::to_string(gps_handover_.current() * 1e3);
+  status.values.push_back(kv);
+  diag_array.status.push_back(status);
+
+  // bias and jitter are per diagnostics period
+  boot_clock_.reset_residuals();
+}
+
+void InertialSenseROS::connection_diagnostics(diagnostic_msgs::DiagnosticArray& diag_array)
+{
+  if (shared_connection_ || !device_connected_)
+    return;
+  diagnostic_msgs::DiagnosticStatus status;
+  status.name = "Connection";
+  switch (connection_state_)
+  {
+  case CONNECTION_UP:
+    status.level = diagnostic_msgs::DiagnosticStatus::OK;
+    status.message = "Connected";
+    break;
+  case CONNECTION_DOWN:
+    status.level = diagnostic_msgs::DiagnosticStatus::ERROR;
+    status.message = "Port closed, reconnecting";
+    break;
+  case CONNECTION_RECOVERING:
+    status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+    status.message = "Port reopened, waiting for data";
+    break;
+  }
+
+  diagnostic_msgs::KeyValue kv;
+  kv.key = "Port";
+  kv.value = port_;
+  status.values.push_back(kv);
+  kv.key = "Reconnects";
+  kv.value = std::to_string(reconnects_);
+  status.values.push_back(kv);
+  kv.key = "Last recovery (s)";
+  kv.value = std::to_string(last_recovery_s_);
+  status.values.push_back(kv);
+  if (connection_state_ != CONNECTION_UP)
+  {
+    kv.key = "Attempts";
+    kv.value = std::to_string(reconnect_attempts_);
+    status.values.push_back(kv);
+  }
+  diag_array.status.push_back(status);
+}
+
+void InertialSenseROS::obs_diagnostics(diagnostic_msgs::DiagnosticArray& diag_array)
+{
+  if (!GPS_obs_.enabled)
+    return;
+  static const char* const names[GNSS_RECEIVER_COUNT] = { "GPS1", "GPS2", "Base" };
+  diagnostic_msgs::DiagnosticStatus status;
+  status.name = "GNSS Observations";
+  status.level = diagnostic_msgs::DiagnosticStatus::OK;
+  status.message = "OK";
+  diagnostic_msgs::KeyValue kv;
+  for (int i = 0; i < GNSS_RECEIVER_COUNT; i++)
+  {
+    if (obs_bundles_[i].dropped)
     {
-      double y_offset = ros::Time::now().toSec() - time;
-      INS_local_offset_ = 0.005 * y_offset + 0.995 * INS_local_offset_;
+      status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+      status.message = "Epochs larger than a bundle, observations dropped";
     }
-    // Publish with ROS time
-    rostime = ros::Time(INS_local_offset_ + time);
+    kv.key = std::string(names[i]) + " Dropped";
+    kv.value = std::to_string(obs_bundles_[i].dropped);
+    status.values.push_back(kv);
+    kv.key = std::string(names[i]) + " Follow-up Bundles";
+    kv.value = std::to_string(obs_bundles_[i].followups);
+    status.values.push_back(kv);
   }
-  return rostime;
+  diag_array.status.push_back(status);
+}
+
+void InertialSenseROS::log_diagnostics(diagnostic_msgs::DiagnosticArray& diag_array)
+{
+  if (!log_writer_)
+    return;
+  LogWriter::stats_t stats = log_writer_->stats();
+  diagnostic_msgs::DiagnosticStatus status;
+  status.name = "Raw Log";
+  status.level = diagnostic_msgs::DiagnosticStatus::OK;
+  status.message = "Writing " + log_writer_->current_segment();
+  if (stats.write_errors)
+  {
+    status.level = diagnostic_msgs::DiagnosticStatus::ERROR;
+    status.message = "Write errors (disk full?)";
+  }
+  else if (stats.dropped_bytes)
+  {
+    status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+    status.message = "Queue overflowed, increase log_queue_mb";
+  }
+
+  diagnostic_msgs::KeyValue kv;
+  kv.key = "Queue Size (bytes)";
+  kv.value = std::to_string(stats.queue_capacity);
+  status.values.push_back(kv);
+  kv.key = "Queue Fill (bytes)";
+  kv.value = std::to_string(stats.queue_fill);
+  status.values.push_back(kv);
+  kv.key = "Queue High Water (bytes)";
+  kv.value = std::to_string(stats.queue_high_water);
+  status.values.push_back(kv);
+  kv.key = "Bytes Written";
+  kv.value = std::to_string(stats.bytes_written);
+  status.values.push_back(kv);
+  kv.key = "Dropped (bytes)";
+  kv.value = std::to_string(stats.dropped_bytes);
+  status.values.push_back(kv);
+  kv.key = "Dropped Chunks";
+  kv.value = std::to_string(stats.dropped_chunks);
+  status.values.push_back(kv);
+  kv.key = "Segments";
+  kv.value = std::to_string(stats.segments);
+  status.values.push_back(kv);
+  kv.key = "Longest Write (ms)";
+  kv.value = std::to_string(stats.max_write_ms);
+  status.values.push_back(kv);
+  kv.key = "Write Errors";
+  kv.value = std::to_string(stats.write_errors);
+  status.values.push_back(kv);
+  diag_array.status.push_back(status);
 }
 
 ros::Time InertialSenseROS::ros_time_from_tow(const double tow)
@@ -0,0 +1,251 @@
+#include "inertial_sense_hub.h"
+#include <errno.h>
+#include <string.h>
+#include <poll.h>
+#include <sstream>
+
+InertialSenseHub::InertialSenseHub(const ros::NodeHandle& nh, const ros::NodeHandle& nh_private) :
+  nh_(nh), nh_private_(nh_private), static_br_(new tf2_ros::StaticTransformBroadcaster())
+{
+  std::vector<std::string> ports, namespaces;
+  int baudrate;
+  bool low_latency_serial, log_enabled;
+  std::string log_type;
+  nh_private_.getParam("ports", ports);
+  nh_private_.getParam("namespaces", namespaces);
+  nh_private_.param<int>("baudrate", baudrate, 921600);
+  nh_private_.param<bool>("low_latency_serial", low_latency_serial, false);
+  nh_private_.param<int>("idle_timeout_ms", idle_timeout_ms_, 100);
+  nh_private_.param<bool>("enable_log", log_enabled, false);
+  nh_private_.param<std::string>("log_type", log_type, "dat");
+  if (ports.empty())
+  {
+    ROS_FATAL("inertialsense: no serial ports given in ~ports");
+    exit(0);
+  }
+  for (size_t i = namespaces.size(); i < ports.size(); i++)
+    namespaces.push_back("uins" + std::to_string(i));
+
+  // the SDK opens a comma separated list of ports as one connection, one device per port
+  std::ostringstream port_list;
+  for (size_t i = 0; i < ports.size(); i++)
+    port_list << (i ? "," : "") << ports[i];
+  serialPortPlatformSetOptions(low_latency_serial ? SERIAL_PORT_OPTION_LOW_LATENCY : 0);
+  ROS_INFO("Connecting to %d uINS on \"%s\", at %d baud", (int)ports.size(), port_list.str().c_str(), baudrate);
+  if (!IS_.Open(port_list.str().c_str(), baudrate))
+  {
+    ROS_FATAL("inertialsense: Unable to open serial ports \"%s\", at %d baud", port_list.str().c_str(), baudrate);
+    exit(0);
+  }
+  for (int i = 0; i < IS_.GetDeviceCount(); i++)
+  {
+    if (!serialPortPlatformAdopt(IS_.GetSerialPort(i), baudrate))
+    {
+      ROS_FATAL("inertialsense: Unable to re-open serial port \"%s\", at %d baud", IS_.GetSerialPort(i)->port, baudrate);
+      exit(0);
+    }
+  }
+
+  int device_count = IS_.GetDeviceCount();
+  devices_.resize(device_count);
+  handler_registered_.assign(DID_COUNT, false);
+  requested_.assign((size_t)device_count * DID_COUNT, false);
+
+  // one log directory for the whole connection, with a file per device: the raw log is written
+  // by each device from its own port, the SDK's logger by us for all of them
+  std::string log_directory;
+  if (log_enabled)
+    nh_private_.param<std::string>("log_directory", log_directory, cISLogger::CreateCurrentTimestamp());
+
+  // the SDK drops ports it couldn't open, so match devices back to their namespace by port name
+  for (size_t i = 0; i < ports.size(); i++)
+  {
+    int device = -1;
+    for (int d = 0; d < device_count; d++)
+    {
+      if (ports[i] == IS_.GetSerialPort(d)->port)
+        device = d;
+    }
+    if (device < 0)
+    {
+      ROS_ERROR("inertialsense: no uINS on \"%s\", skipping namespace %s", ports[i].c_str(), namespaces[i].c_str());
+      continue;
+    }
+
+    ros::NodeHandle device_nh(nh_, namespaces[i]);
+    ros::NodeHandle device_private(nh_private_, namespaces[i]);
+    if (!device_private.hasParam("frame_id"))
+      device_private.setParam("frame_id", namespaces[i] + "/body");
+    if (!device_private.hasParam("tf_parent_frame"))
+      device_private.setParam("tf_parent_frame", namespaces[i] + "/ins");
+    if (!device_private.hasParam("tf_child_frame"))
+      device_private.setParam("tf_child_frame", namespaces[i] + "/base_link");
+    // the log records what the uINS send, so don't stop streams nobody subscribes to
+    if (log_enabled && !device_private.hasParam("lazy_streams"))
+      device_private.setParam("lazy_streams", false);
+    if (log_enabled && log_type == "raw")
+    {
+      device_private.setParam("enable_log", true);
+      device_private.setParam("log_type", log_type);
+      device_private.setParam("log_directory", log_directory);
+    }
+    devices_[device].reset(new InertialSenseROS(device_nh, device_private, IS_, device,
+      [this](uint32_t did, int period_multiple, int device) { request_broadcast(did, period_multiple, device); },
+      static_br_));
+  }
+
+  // navigation rate changes: reset every device that needs it, then wait for them all to come back
+  for (size_t d = 0; d < devices_.size(); d++)
+  {
+    if (devices_[d] && devices_[d]->reset_pending())
+      devices_[d]->begin_reset();
+  }
+  for (size_t d = 0; d < devices_.size(); d++)
+  {
+    if (devices_[d] && devices_[d]->reset_pending())
+      devices_[d]->finish_reset();
+  }
+
+  if (log_enabled && log_type != "raw")
+  {
+    ROS_INFO_STREAM("Creating log in " << log_directory << " folder");
+    IS_.SetLoggerEnabled(true, log_directory, cISLogger::LOGTYPE_DAT, RMC_PRESET_PPD_ROBOT);
+  }
+}
+
+InertialSenseHub::~InertialSenseHub()
+{
+  // the devices' reader threads use serial ports owned by IS_, so they have to go first
+  devices_.clear();
+}
+
+void InertialSenseHub::request_broadcast(uint32_t did, int period_multiple, int device)
+{
+  int device_count = (int)devices_.size();
+  if (did >= DID_COUNT || device < 0 || device >= device_count)
+    return;
+  // period_multiple <= 0 stops it on this device only, the handler stays registered for the others
+  bool stop = period_multiple <= 0;
+  requested_[(size_t)device * DID_COUNT + did] = !stop;
+
+  if (handler_registered_[did])
+  {
+    if (stop)
+      comManagerDisableData(device, did);
+    else
+      comManagerGetData(device, did, 0, 0, period_multiple);
+    return;
+  }
+
+  // The SDK keeps one handler per DID for the whole connection, so route by device index.
+  // Registering it also requests the DID from every device, so stop it again on the ones
+  // that haven't asked for it (yet).  A negative period registers it without requesting anything,
+  // for data sets that only come as answers.
+  IS_.BroadcastBinaryData(did, stop ? -1 : period_multiple, [this](InertialSense* i, p_data_t* data, int pHandle)
+  {
+    (void)i;
+    if (pHandle >= 0 && (size_t)pHandle < devices_.size() && devices_[pHandle])
+      devices_[pHandle]->dispatch(data);
+  });
+  handler_registered_[did] = true;
+  for (int d = 0; d < device_count; d++)
+  {
+    if (!requested_[(size_t)d * DID_COUNT + did])
+      comManagerDisableData(d, did);
+  }
+}
+
+void InertialSenseHub::spin()
+{
+  // RTK corrections from a TCP server are read inside IS_.Update(), not off the serial ports
+  const int server_poll_ms = 10;
+
+  // [0] wakes us for shutdown(), then per device its callback queue and its port (or reader thread)
+  std::vector<struct pollfd> fds(1 + 2 * devices_.size());
+  for (size_t i = 0; i < fds.size(); i++)
+    fds[i].events = POLLIN;
+  fds[0].fd = wake_.fd();
+
+  while (ros::ok() && !shutdown_requested_)
+  {
+    bool server_connection_open = false;
+    // the SDK reads small requests ahead from a port, poll() can't see what it has buffered
+    bool buffered = false;
+    for (size_t i = 0; i < devices_.size(); i++)
+    {
+      InertialSenseROS* device = devices_[i].get();
+      struct pollfd* device_fds = &fds[1 + 2 * i];
+      if (!device)
+      {
+        device_fds[0].fd = device_fds[1].fd = -1;
+        continue;
+      }
+      device_fds[0].fd = device->callback_queue_.fd();
+      if (device->pipeline_ && device->pipeline_->running())
+        device_fds[1].fd = device->pipeline_->fd();
+      else
+      {
+        device_fds[1].fd = serialPortGetFileDescriptor(IS_.GetSerialPort((int)i));
+        buffered |= serialPortGetReadAheadCount(IS_.GetSerialPort((int)i)) > 0;
+      }
+      server_connection_open |= device->server_connection_open_;
+    }
+    for (size_t i = 0; i < fds.size(); i++)
+      fds[i].revents = 0;
+
+    int timeout_ms = server_connection_open ? std::min(idle_timeout_ms_, server_poll_ms) : idle_timeout_ms_;
+    for (size_t i = 0; i < devices_.size(); i++)
+    {
+      int command_ms = devices_[i] ? devices_[i]->commands_.next_timeout_ms() : -1;
+      if (command_ms >= 0)
+        timeout_ms = std::min(timeout_ms, command_ms);
+    }
+    if (buffered)
+      timeout_ms = 0;
+    int n = poll(fds.data(), fds.size(), timeout_ms);
+    if (n < 0 && errno != EINTR)
+    {
+      ROS_ERROR("inertialsense: poll failed (%s)", strerror(errno));
+      break;
+    }
+
+    // A single Update() steps the com manager over every port, so however many devices have
+    // data waiting, they are all decoded in one pass
+    bool data_ready = (n == 0) || buffered;
+    for (size_t i = 0; i < devices_.size(); i++)
+      data_ready |= (fds[2 + 2 * i].revents & (POLLIN | POLLERR | POLLHUP)) != 0;
+    if (data_ready)
+      IS_.Update();
+
+    // the hub doesn't reconnect; a port that hung up stays readable, so close it rather than spin on it
+    for (size_t i = 0; i < devices_.size(); i++)
+    {
+      InertialSenseROS* device = devices_[i].get();
+      bool pipelined = device && device->pipeline_ && device->pipeline_->running();
+      if (!device || fds[2 + 2 * i].fd < 0 ||
+          !((fds[2 + 2 * i].revents & (POLLERR | POLLHUP | POLLNVAL)) || (pipelined && device->pipeline_->port_error())))
+        continue;
+      ROS_ERROR("inertialsense: serial port error on \"%s\", closing it", device->port_.c_str());
+      if (pipelined)
+        device->pipeline_->stop();
+      serialPortClose(IS_.GetSerialPort((int)i));
+    }
+
+    for (size_t i = 0; i < devices_.size(); i++)
+    {
+      if (devices_[i])
+      {
+        devices_[i]->callback_queue_.callAvailableNow();
+        devices_[i]->service_commands();
+      }
+    }
+    if (fds[0].revents)
+      wake_.callAvailableNow();
+  }
+}
+
+void InertialSenseHub::shutdown()
+{
+  shutdown_requested_ = true;
+  wake_.notify();
+}
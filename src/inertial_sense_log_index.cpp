@@ -0,0 +1,110 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <string>
+#include <vector>
+
+#include "log_index.h"
+
+// Builds the indexes of raw logs recorded without them (or cut short), and lists what they hold,
+// or copies a window of them into a new raw log that inertial_sense_replay plays like any other.
+static void usage()
+{
+  fprintf(stderr,
+          "usage: inertial_sense_log_index [--rebuild] LOG_DIR [LOG_DIR ...]\n"
+          "       inertial_sense_log_index --extract START END OUT_DIR [--did N ...] LOG_DIR [LOG_DIR ...]\n"
+          "  START, END: GPS time of week (s)\n");
+}
+
+static bool extract(IndexedLog& log, double start, double end, const std::vector<uint32_t>& dids,
+                    const std::string& path)
+{
+  FILE* out = fopen(path.c_str(), "wb");
+  if (out == NULL)
+  {
+    fprintf(stderr, "unable to create %s\n", path.c_str());
+    return false;
+  }
+  LogIndexer indexer;
+  uint64_t count = 0;
+  double tow;
+  log.seek(start, end, dids);
+  while (log.next(tow) != NULL)
+  {
+    size_t len;
+    const uint8_t* packet = log.packet(len);
+    fwrite(packet, 1, len, out);
+    indexer.add(packet, len);
+    count++;
+  }
+  bool ok = fclose(out) == 0 && indexer.save(log_index_path(path));
+  printf("  %s: %lu data sets, %.1f kB, parsed %.1f of %.1f MB\n", path.c_str(), (unsigned long)count,
+         indexer.size() / 1e3, log.bytes_scanned() / 1e6, log.size() / 1e6);
+  return ok;
+}
+
+int main(int argc, char** argv)
+{
+  bool rebuild = false, extracting = false;
+  double start = 0.0, end = 0.0;
+  std::string out_dir;
+  std::vector<uint32_t> dids;
+  std::vector<std::string> directories;
+  for (int i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "--rebuild"))
+      rebuild = true;
+    else if (!strcmp(argv[i], "--extract") && i + 3 < argc)
+    {
+      extracting = true;
+      start = atof(argv[++i]);
+      end = atof(argv[++i]);
+      out_dir = argv[++i];
+    }
+    else if (!strcmp(argv[i], "--did") && i + 1 < argc)
+      dids.push_back((uint32_t)atoi(argv[++i]));
+    else if (argv[i][0] == '-')
+    {
+      usage();
+      return 1;
+    }
+    else
+      directories.push_back(argv[i]);
+  }
+  if (directories.empty())
+  {
+    usage();
+    return 1;
+  }
+  if (extracting)
+    mkdir(out_dir.c_str(), 0755);
+
+  bool ok = true;
+  for (size_t d = 0; d < directories.size(); d++)
+  {
+    std::map<std::string, std::vector<std::string> > logs = IndexedLog::find_segments(directories[d]);
+    if (logs.empty())
+      fprintf(stderr, "%s: no raw logs\n", directories[d].c_str());
+    for (auto it = logs.begin(); it != logs.end(); ++it)
+    {
+      IndexedLog log;
+      for (size_t s = 0; s < it->second.size(); s++)
+      {
+        if (rebuild)
+          unlink(log_index_path(it->second[s]).c_str());
+        ok &= log.add_segment(it->second[s]);
+        if (!log.error().empty())
+          fprintf(stderr, "%s\n", log.error().c_str());
+      }
+      printf("%s/%s: %lu segment(s), %.1f MB, %lu index entries, GPS time of week %.3f to %.3f\n",
+             directories[d].c_str(), it->first.c_str(), (unsigned long)log.segment_count(), log.size() / 1e6,
+             (unsigned long)log.index_entries(), log.start_tow(), log.end_tow());
+      if (extracting)
+        ok &= extract(log, start, end, dids, out_dir + "/" + it->first + "_0000.raw");
+    }
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,480 @@
+#include <dirent.h>
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include <condition_variable>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <rosbag/bag.h>
+#include <topic_tools/shape_shifter.h>
+
+#include "inertial_sense.h"
+#include "log_index.h"
+
+// Converts uINS logs into rosbag files through the same conversion code as the node, without a
+// ROS master.  Raw logs are cut into time chunks through their indexes and the chunks converted
+// in parallel, each by its own InertialSenseROS; the chunks are then written to the bag in order.
+
+typedef InertialSenseROS::offline_topic_t topic_t;
+
+static const double LATE = 1.0;  // data sets are logged up to a second out of time order, as in LogReplay
+
+typedef struct
+{
+  uint32_t topic;   // into unit_t::topics
+  ros::Time stamp;
+  uint64_t offset;  // into unit_t::data
+  uint32_t size;
+} record_t;
+
+// a piece of work: a time chunk of a raw log, or a whole .dat device log
+typedef struct
+{
+  size_t bag;
+  bool raw;
+  std::vector<std::string> segments;  // raw
+  bool first;                         // raw: read from the start, including data sets not timed yet
+  double start;                       // raw: data sets timed in [start, end) are converted
+  double end;
+  std::string directory;              // .dat
+  unsigned int device;
+
+  // result
+  std::vector<topic_t> topics;
+  std::vector<record_t> records;
+  std::vector<uint8_t> data;
+  uint64_t data_sets;
+  double cpu_s;
+  bool done;
+} unit_t;
+
+typedef struct
+{
+  std::string path;
+  size_t last_unit;
+  uint64_t messages;
+} bag_t;
+
+// the SDK's InertialSense touches globals when it's constructed and destroyed
+static std::mutex sdk_mutex;
+
+static double thread_cpu_s()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double wall_s()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void usage()
+{
+  fprintf(stderr,
+          "usage: inertial_sense_log_to_bag OUT_DIR LOG_DIR [LOG_DIR ...] [_threads:=0] [_chunk:=60] [_warmup:=2]\n"
+          "                                 [_compression:=none|bz2|lz4] [_verbose:=false] [_<node parameter>:=value ...]\n"
+          "  writes OUT_DIR/<log>.bag for every device log; node parameters are set as for inertial_sense_node\n");
+}
+
+// a _name:=value argument, typed as roslaunch would
+static XmlRpc::XmlRpcValue parse_value(const std::string& text)
+{
+  if (text == "true" || text == "True")
+    return XmlRpc::XmlRpcValue(true);
+  if (text == "false" || text == "False")
+    return XmlRpc::XmlRpcValue(false);
+  char* end;
+  long i = strtol(text.c_str(), &end, 0);
+  if (!text.empty() && *end == '\0')
+    return XmlRpc::XmlRpcValue((int)i);
+  double d = strtod(text.c_str(), &end);
+  if (!text.empty() && *end == '\0')
+    return XmlRpc::XmlRpcValue(d);
+  if (text.size() >= 2 && text[0] == '[' && text[text.size() - 1] == ']')
+  {
+    XmlRpc::XmlRpcValue list;
+    list.setSize(0);
+    std::string items = text.substr(1, text.size() - 2);
+    if (items.find_first_not_of(' ') == std::string::npos)
+      return list;
+    for (size_t pos = 0, comma = 0; comma != std::string::npos; pos = comma + 1)
+    {
+      comma = items.find(',', pos);
+      std::string item = items.substr(pos, comma == std::string::npos ? std::string::npos : comma - pos);
+      size_t first = item.find_first_not_of(' '), last = item.find_last_not_of(' ');
+      list[list.size()] = parse_value(first == std::string::npos ? "" : item.substr(first, last - first + 1));
+    }
+    return list;
+  }
+  return XmlRpc::XmlRpcValue(text);
+}
+
+template <typename T>
+static T tool_param(XmlRpc::XmlRpcValue& params, const std::string& name, const T& default_value)
+{
+  T value;
+  if (params.hasMember(name) && InertialSenseROS::from_xmlrpc(params[name], value))
+    return value;
+  return default_value;
+}
+
+static uint64_t dat_size(const std::string& directory)
+{
+  uint64_t size = 0;
+  DIR* dir = opendir(directory.c_str());
+  if (dir == NULL)
+    return 0;
+  for (struct dirent* entry = readdir(dir); entry != NULL; entry = readdir(dir))
+  {
+    std::string name = entry->d_name;
+    struct stat st;
+    if (name.size() > 4 && name.compare(name.size() - 4, 4, ".dat") == 0 &&
+        stat((directory + "/" + name).c_str(), &st) == 0)
+      size += st.st_size;
+  }
+  closedir(dir);
+  return size;
+}
+
+static std::string base_name(const std::string& path)
+{
+  std::string trimmed = path.substr(0, path.find_last_not_of('/') + 1);
+  size_t slash = trimmed.rfind('/');
+  return slash == std::string::npos ? trimmed : trimmed.substr(slash + 1);
+}
+
+static void convert_raw(unit_t& unit, InertialSenseROS& node, bool& keep, double warmup)
+{
+  IndexedLog log;
+  for (size_t s = 0; s < unit.segments.size(); s++)
+    log.add_segment(unit.segments[s], false);
+  // a chunk starts `warmup` early, so the state carried between data sets (GPS time, decimation,
+  // IMU averaging) is there by its first one; what that produces belongs to the previous chunk
+  if (unit.first)
+    log.rewind();
+  else
+    log.seek(unit.start - warmup, unit.end + LATE);
+  double tow;
+  for (const p_data_t* data = log.next(tow); data != NULL; data = log.next(tow))
+  {
+    if (tow > unit.end + LATE)
+      break;
+    keep = tow < unit.end && (unit.first || tow >= unit.start);
+    node.dispatch(data);
+    if (keep)
+      unit.data_sets++;
+  }
+}
+
+static void convert_dat(unit_t& unit, InertialSenseROS& node, bool& keep)
+{
+  cISLogger logger;
+  if (!logger.LoadFromDirectory(unit.directory, cISLogger::LOGTYPE_DAT))
+  {
+    ROS_ERROR("log to bag: unable to load logs from %s", unit.directory.c_str());
+    return;
+  }
+  keep = true;
+  for (const p_data_t* data = logger.ReadData(unit.device); data != NULL; data = logger.ReadData(unit.device))
+  {
+    node.dispatch(data);
+    unit.data_sets++;
+  }
+}
+
+static void convert(unit_t& unit, const XmlRpc::XmlRpcValue& params, double warmup)
+{
+  double cpu_start = thread_cpu_s();
+  bool keep = false;
+  std::map<const topic_t*, uint32_t> topic_ids;
+  InertialSenseROS::message_sink_t sink =
+    [&unit, &keep, &topic_ids](const topic_t& topic, const ros::Time& stamp, const uint8_t* data, uint32_t size)
+  {
+    if (!keep)
+      return;
+    std::map<const topic_t*, uint32_t>::iterator it = topic_ids.find(&topic);
+    if (it == topic_ids.end())
+    {
+      it = topic_ids.insert(std::make_pair(&topic, (uint32_t)unit.topics.size())).first;
+      unit.topics.push_back(topic);
+    }
+    record_t record = { it->second, stamp, unit.data.size(), size };
+    unit.records.push_back(record);
+    unit.data.insert(unit.data.end(), data, data + size);
+  };
+
+  std::unique_ptr<InertialSenseROS> node;
+  {
+    std::lock_guard<std::mutex> lock(sdk_mutex);
+    node.reset(new InertialSenseROS(ros::NodeHandle(), params, sink));
+  }
+  if (unit.raw)
+    convert_raw(unit, *node, keep, warmup);
+  else
+    convert_dat(unit, *node, keep);
+  {
+    std::lock_guard<std::mutex> lock(sdk_mutex);
+    node.reset();
+  }
+  unit.cpu_s = thread_cpu_s() - cpu_start;
+}
+
+int main(int argc, char** argv)
+{
+  // _name:=value arguments would go to the parameter server, of which there is none
+  XmlRpc::XmlRpcValue params;
+  std::vector<std::string> positional;
+  for (int i = 1; i < argc; i++)
+  {
+    std::string arg = argv[i];
+    size_t assign = arg.find(":=");
+    if (arg.size() > 1 && arg[0] == '_' && arg[1] != '_' && assign != std::string::npos)
+      params[arg.substr(1, assign - 1)] = parse_value(arg.substr(assign + 2));
+    else if (arg.compare(0, 2, "__") == 0 && assign != std::string::npos)
+      continue;  // __name, __log etc. from roslaunch
+    else if (arg[0] == '-' || assign != std::string::npos)
+    {
+      usage();
+      return 1;
+    }
+    else
+      positional.push_back(arg);
+  }
+  if (positional.size() < 2)
+  {
+    usage();
+    return 1;
+  }
+  std::string out_dir = positional[0];
+  std::vector<std::string> directories(positional.begin() + 1, positional.end());
+  if (mkdir(out_dir.c_str(), 0755) != 0 && errno != EEXIST)
+  {
+    fprintf(stderr, "%s: %s\n", out_dir.c_str(), strerror(errno));
+    return 1;
+  }
+  struct stat st;
+  if (stat(out_dir.c_str(), &st) != 0 || !S_ISDIR(st.st_mode))
+  {
+    fprintf(stderr, "%s: not a directory\n", out_dir.c_str());
+    return 1;
+  }
+
+  int threads = tool_param<int>(params, "threads", 0);
+  if (threads <= 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  double chunk = tool_param<double>(params, "chunk", 60.0);
+  double warmup = tool_param<double>(params, "warmup", 2.0);
+  std::string compression = tool_param<std::string>(params, "compression", "none");
+
+  // nothing is advertised and no parameters are read, so roscpp is pointed at a master that can't
+  // be there and told not to wait for it
+  ros::M_string remappings;
+  remappings["__master"] = "http://127.0.0.1:1";
+  ros::init(remappings, "inertial_sense_log_to_bag",
+            ros::init_options::AnonymousName | ros::init_options::NoRosout | ros::init_options::NoSigintHandler);
+  ros::master::setRetryTimeout(ros::WallDuration(0.001));
+  ros::console::initialize();
+  ros::console::set_logger_level("ros.roscpp", ros::console::levels::Fatal);
+  if (!tool_param<bool>(params, "verbose", false))
+    ros::console::set_logger_level(ROSCONSOLE_DEFAULT_NAME, ros::console::levels::Warn);
+  ros::console::notifyLoggerLevelsChanged();
+  ros::start();
+
+  std::vector<bag_t> bags;
+  std::vector<std::unique_ptr<unit_t> > units;
+  std::set<std::string> bag_paths;
+  uint64_t input_bytes = 0;
+  auto add_bag = [&bags, &bag_paths, &out_dir](const std::string& name)
+  {
+    bag_t bag = { out_dir + "/" + name + ".bag", 0, 0 };
+    for (int n = 1; !bag_paths.insert(bag.path).second; n++)
+      bag.path = out_dir + "/" + name + "_" + std::to_string(n) + ".bag";
+    bags.push_back(bag);
+  };
+  auto add_unit = [&units, &bags]() -> unit_t*
+  {
+    units.push_back(std::unique_ptr<unit_t>(new unit_t()));
+    unit_t& unit = *units.back();
+    unit.bag = bags.size() - 1;
+    unit.first = true;
+    unit.start = -std::numeric_limits<double>::infinity();
+    unit.end = std::numeric_limits<double>::infinity();
+    unit.device = 0;
+    unit.data_sets = 0;
+    unit.cpu_s = 0.0;
+    unit.done = false;
+    bags.back().last_unit = units.size() - 1;
+    return &unit;
+  };
+
+  for (size_t d = 0; d < directories.size(); d++)
+  {
+    std::map<std::string, std::vector<std::string> > raw = IndexedLog::find_segments(directories[d]);
+    for (auto it = raw.begin(); it != raw.end(); ++it)
+    {
+      // builds the indexes that are missing, so the chunks only read theirs
+      IndexedLog log;
+      bool indexed = true;
+      for (size_t s = 0; s < it->second.size(); s++)
+      {
+        log.add_segment(it->second[s]);
+        if (!log.error().empty())
+          fprintf(stderr, "%s\n", log.error().c_str());
+        struct stat st;
+        indexed &= stat(log_index_path(it->second[s]).c_str(), &st) == 0;
+      }
+      input_bytes += log.size();
+      add_bag(it->first);
+      double start = log.start_tow(), end = log.end_tow();
+      // without a saved index (read-only directory) every chunk would have to index the log again
+      int chunks = (indexed && start >= 0.0 && chunk > 0.0) ? std::max(1, (int)ceil((end - start) / chunk)) : 1;
+      for (int k = 0; k < chunks; k++)
+      {
+        unit_t* unit = add_unit();
+        unit->raw = true;
+        unit->segments = it->second;
+        unit->first = k == 0;
+        if (k > 0)
+          unit->start = start + k * chunk;
+        if (k < chunks - 1)
+          unit->end = start + (k + 1) * chunk;
+      }
+      printf("%s/%s: %.1f MB, %d chunk(s) -> %s\n", directories[d].c_str(), it->first.c_str(), log.size() / 1e6,
+             chunks, bags.back().path.c_str());
+    }
+    if (!raw.empty())
+      continue;
+
+    cISLogger logger;
+    if (!logger.LoadFromDirectory(directories[d], cISLogger::LOGTYPE_DAT) || logger.GetDeviceCount() == 0)
+    {
+      fprintf(stderr, "%s: no logs\n", directories[d].c_str());
+      continue;
+    }
+    input_bytes += dat_size(directories[d]);
+    for (unsigned int dev = 0; dev < logger.GetDeviceCount(); dev++)
+    {
+      add_bag(base_name(directories[d]) + "_" + std::to_string(dev));
+      unit_t* unit = add_unit();
+      unit->raw = false;
+      unit->directory = directories[d];
+      unit->device = dev;
+      printf("%s: device %u -> %s\n", directories[d].c_str(), dev, bags.back().path.c_str());
+    }
+  }
+  if (units.empty())
+    return 1;
+
+  // workers take units in order, at most `in_flight` ahead of the one being written
+  const size_t in_flight = threads + 2;
+  std::mutex mutex;
+  std::condition_variable cv;
+  size_t next_unit = 0, written = 0;
+  double start_s = wall_s();
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; t++)
+  {
+    workers.push_back(std::thread([&]()
+    {
+      while (true)
+      {
+        size_t i;
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          cv.wait(lock, [&]() { return next_unit >= units.size() || next_unit < written + in_flight; });
+          if (next_unit >= units.size())
+            return;
+          i = next_unit++;
+        }
+        convert(*units[i], params, warmup);
+        std::lock_guard<std::mutex> lock(mutex);
+        units[i]->done = true;
+        cv.notify_all();
+      }
+    }));
+  }
+
+  bool ok = true;
+  rosbag::Bag bag;
+  topic_tools::ShapeShifter shape_shifter;
+  uint64_t data_sets = 0, messages = 0;
+  double cpu_s = 0.0, write_s = 0.0;
+  for (size_t i = 0; i < units.size(); i++)
+  {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      cv.wait(lock, [&]() { return units[i]->done; });
+    }
+    unit_t& unit = *units[i];
+    bag_t& out = bags[unit.bag];
+    double write_start = wall_s();
+    try
+    {
+      if (i == 0 || units[i - 1]->bag != unit.bag)
+      {
+        bag.open(out.path, rosbag::bagmode::Write);
+        if (compression == "bz2")
+          bag.setCompression(rosbag::compression::BZ2);
+        else if (compression == "lz4")
+          bag.setCompression(rosbag::compression::LZ4);
+      }
+      for (size_t r = 0; r < unit.records.size(); r++)
+      {
+        const record_t& record = unit.records[r];
+        const topic_t& topic = unit.topics[record.topic];
+        shape_shifter.morph(topic.md5sum, topic.datatype, topic.definition, "");
+        ros::serialization::IStream stream(unit.data.data() + record.offset, record.size);
+        shape_shifter.read(stream);
+        bag.write(topic.topic, std::max(record.stamp, ros::TIME_MIN), shape_shifter);
+      }
+      if (i == out.last_unit)
+        bag.close();
+    }
+    catch (const rosbag::BagException& e)
+    {
+      fprintf(stderr, "%s: %s\n", out.path.c_str(), e.what());
+      ok = false;
+      bag.close();
+    }
+    write_s += wall_s() - write_start;
+    out.messages += unit.records.size();
+    messages += unit.records.size();
+    data_sets += unit.data_sets;
+    cpu_s += unit.cpu_s;
+    if (i == out.last_unit)
+      printf("  %s: %lu messages\n", out.path.c_str(), (unsigned long)out.messages);
+
+    std::vector<record_t>().swap(unit.records);
+    std::vector<uint8_t>().swap(unit.data);
+    std::lock_guard<std::mutex> lock(mutex);
+    written++;
+    cv.notify_all();
+  }
+  for (size_t t = 0; t < workers.size(); t++)
+    workers[t].join();
+
+  // per core: log bytes over the CPU time spent converting them (warmup re-reads included)
+  double elapsed = wall_s() - start_s;
+  printf("converted %.1f MB of logs (%lu data sets, %lu messages, %lu chunk(s)) in %.2f s on %d thread(s): %.1f MB/s, "
+         "%.1f MB/s per core (%.2f s CPU converting, %.2f s writing bags)\n",
+         input_bytes / 1e6, (unsigned long)data_sets, (unsigned long)messages, (unsigned long)units.size(), elapsed,
+         threads, elapsed > 0.0 ? input_bytes / 1e6 / elapsed : 0.0, cpu_s > 0.0 ? input_bytes / 1e6 / cpu_s : 0.0,
+         cpu_s, write_s);
+  return ok ? 0 : 1;
+}
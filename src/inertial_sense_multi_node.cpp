@@ -0,0 +1,10 @@
+#include "inertial_sense_hub.h"
+
+// Usage: rosrun inertial_sense inertial_sense_multi_node _ports:="[/dev/ttyUSB0, /dev/ttyUSB1]" [_namespaces:="[left, right]"]
+int main(int argc, char**argv)
+{
+  ros::init(argc, argv, "inertial_sense_node");
+  InertialSenseHub hub;
+  hub.spin();
+  return 0;
+}
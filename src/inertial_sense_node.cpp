@@ -4,10 +4,6 @@ int main(int argc, char**argv)
 {
   ros::init(argc, argv, "inertial_sense_node");
   InertialSenseROS thing;
-  while (ros::ok())
-  {
-    ros::spinOnce();
-    thing.update();
-  }
+  thing.spin();
   return 0;
 }
\ No newline at end of file
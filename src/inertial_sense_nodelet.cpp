@@ -0,0 +1,58 @@
+#include "inertial_sense.h"
+
+#include <mutex>
+#include <thread>
+
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+
+namespace inertial_sense
+{
+
+/**
+ * @brief Nodelet wrapper around InertialSenseROS
+ * Messages are published through shared pointers, so subscribers loaded in the same nodelet
+ * manager receive them without serialization.  The driver runs its own event loop on a
+ * dedicated thread (it does not use the manager's worker threads), exactly like the standalone node.
+ */
+class InertialSenseNodelet : public nodelet::Nodelet
+{
+public:
+  ~InertialSenseNodelet()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      unloading_ = true;
+      if (driver_)
+        driver_->shutdown();
+    }
+    if (thread_.joinable())
+      thread_.join();
+  }
+
+private:
+  virtual void onInit()
+  {
+    // connecting and configuring the uINS blocks for a while, so don't hold up the manager
+    thread_ = std::thread([this]()
+    {
+      InertialSenseROS* driver = new InertialSenseROS(getNodeHandle(), getPrivateNodeHandle());
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        driver_.reset(driver);
+        if (unloading_)
+          driver->shutdown();
+      }
+      driver->spin();
+    });
+  }
+
+  std::mutex mutex_;
+  bool unloading_ = false;
+  std::unique_ptr<InertialSenseROS> driver_;
+  std::thread thread_;
+};
+
+} // namespace inertial_sense
+
+PLUGINLIB_EXPORT_CLASS(inertial_sense::InertialSenseNodelet, nodelet::Nodelet)
@@ -0,0 +1,38 @@
+#include <algorithm>
+
+#include "inertial_sense.h"
+#include "log_replay.h"
+
+// Usage: rosrun inertial_sense inertial_sense_replay LOG_DIR [LOG_DIR ...] [_rate:=1.0] [_start:=TOW] [_end:=TOW]
+int main(int argc, char**argv)
+{
+  ros::init(argc, argv, "inertial_sense_node");
+  ros::NodeHandle nh_private("~");
+
+  std::vector<std::string> directories(argv + 1, argv + argc);
+  if (directories.empty())
+    nh_private.getParam("logs", directories);
+  if (directories.empty())
+  {
+    ROS_FATAL("usage: inertial_sense_replay LOG_DIR [LOG_DIR ...] [_rate:=1.0] [_start:=TOW] [_end:=TOW]");
+    return 1;
+  }
+
+  double rate, start, end;
+  nh_private.param<double>("rate", rate, 1.0);
+  // window in GPS time of week (s), either end open if not given
+  nh_private.param<double>("start", start, -1.0);
+  nh_private.param<double>("end", end, -1.0);
+
+  InertialSenseROS thing(ros::NodeHandle(), nh_private, false);
+  LogReplay replay(thing);
+  if (start >= 0.0 || end >= 0.0)
+    replay.set_window(std::max(start, 0.0), end >= 0.0 ? end : 1e9);
+  if (!replay.load(directories))
+  {
+    ROS_FATAL("no logs could be loaded");
+    return 1;
+  }
+  replay.run(rate);
+  return 0;
+}
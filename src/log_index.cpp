@@ -0,0 +1,570 @@
+#include "log_index.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+
+#define LOG_INDEX_MAGIC   "ISIX"
+#define LOG_INDEX_VERSION 1
+
+typedef struct
+{
+  char magic[4];
+  uint32_t version;
+  uint32_t entry_size;
+  uint32_t entry_count;
+  uint64_t log_size;     // segment size the index was built for, anything else makes it stale
+  double interval;
+  double start_tow;      // indexed time range, so a reader only loads the entries of segments it needs
+  double end_tow;
+  double clock_tow;      // time at the end of the segment, where indexing the next one picks up
+  double clock_tow_offset;
+} log_index_header_t;
+
+static void tow_range(const std::vector<log_index_entry_t>& entries, double& start, double& end)
+{
+  start = end = -1.0;
+  for (size_t i = 0; i < entries.size(); i++)
+  {
+    if (start < 0.0 || entries[i].tow < start)
+      start = entries[i].tow;
+    end = std::max(end, entries[i].tow);
+  }
+}
+
+static bool by_did_then_offset(const log_index_entry_t& a, const log_index_entry_t& b)
+{
+  return a.did != b.did ? a.did < b.did : a.offset < b.offset;
+}
+
+// the data set of a packet is_comm_parse_byte() just completed
+static bool packet_data(const is_comm_instance_t& comm, p_data_t& data)
+{
+  if (comm.pkt.hdr.pid != PID_DATA || comm.pkt.body.size < sizeof(p_data_hdr_t))
+    return false;
+  memcpy(&data.hdr, comm.pkt.body.ptr, sizeof(p_data_hdr_t));
+  if (comm.pkt.body.size < sizeof(p_data_hdr_t) + data.hdr.size)
+    return false;
+  data.buf = comm.pkt.body.ptr + sizeof(p_data_hdr_t);
+  return true;
+}
+
+std::string log_index_path(const std::string& log_path)
+{
+  size_t n = log_path.size();
+  if (n > 4 && log_path.compare(n - 4, 4, ".raw") == 0)
+    return log_path.substr(0, n - 4) + ".idx";
+  return log_path + ".idx";
+}
+
+LogIndexer::LogIndexer(double interval) :
+  interval_(interval)
+{
+  reset();
+}
+
+void LogIndexer::reset()
+{
+  clock_ = DidTimeTracker();
+  next_segment();
+}
+
+void LogIndexer::next_segment()
+{
+  // a packet split across two segments isn't indexed, IndexedLog finds it at the end of the first
+  is_comm_init(&comm_, comm_buffer_, sizeof(comm_buffer_));
+  offset_ = 0;
+  packet_start_ = 0;
+  last_entry_.assign(DID_COUNT, -1);
+  last_packet_.assign(DID_COUNT, log_index_entry_t());
+  entries_.clear();
+}
+
+void LogIndexer::add(const uint8_t* data, size_t len)
+{
+  for (size_t i = 0; i < len; i++, offset_++)
+  {
+    // the start byte is escaped everywhere else in a packet
+    if (data[i] == PSC_START_BYTE)
+      packet_start_ = offset_;
+    if (is_comm_parse_byte(&comm_, data[i]) != _PTYPE_INERTIAL_SENSE_DATA)
+      continue;
+
+    p_data_t packet;
+    if (!packet_data(comm_, packet) || packet.hdr.id >= DID_COUNT)
+      continue;
+    double tow = clock_.update(&packet);
+    if (tow < 0.0)
+      continue;
+
+    log_index_entry_t entry;
+    entry.tow = tow;
+    entry.tow_offset = clock_.tow_offset();
+    entry.offset = packet_start_;
+    entry.did = packet.hdr.id;
+    entry.count = 1;
+    last_packet_[entry.did] = entry;
+
+    int64_t& last = last_entry_[entry.did];
+    if (last >= 0 && tow >= entries_[last].tow && tow < entries_[last].tow + interval_)
+    {
+      entries_[last].count++;
+      continue;
+    }
+    last = (int64_t)entries_.size();
+    entries_.push_back(entry);
+  }
+}
+
+std::vector<log_index_entry_t> LogIndexer::entries() const
+{
+  std::vector<log_index_entry_t> entries(entries_);
+  // close each DID with its latest packet, so the index knows where (and when) it ends
+  for (size_t did = 0; did < last_entry_.size(); did++)
+  {
+    if (last_entry_[did] < 0 || last_packet_[did].offset == entries_[last_entry_[did]].offset)
+      continue;
+    entries[last_entry_[did]].count--;
+    entries.push_back(last_packet_[did]);
+  }
+  std::stable_sort(entries.begin(), entries.end(), by_did_then_offset);
+  return entries;
+}
+
+bool LogIndexer::save(const std::string& path) const
+{
+  std::vector<log_index_entry_t> entries = this->entries();
+  log_index_header_t header;
+  memcpy(header.magic, LOG_INDEX_MAGIC, sizeof(header.magic));
+  header.version = LOG_INDEX_VERSION;
+  header.entry_size = sizeof(log_index_entry_t);
+  header.entry_count = (uint32_t)entries.size();
+  header.log_size = offset_;
+  header.interval = interval_;
+  tow_range(entries, header.start_tow, header.end_tow);
+  header.clock_tow = clock_.last_tow();
+  header.clock_tow_offset = clock_.tow_offset();
+
+  // readers see the old index or the new one, never half of one
+  std::string tmp = path + ".tmp";
+  FILE* file = fopen(tmp.c_str(), "wb");
+  if (file == NULL)
+    return false;
+  bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+            (entries.empty() || fwrite(entries.data(), sizeof(log_index_entry_t), entries.size(), file) == entries.size());
+  ok = (fclose(file) == 0) && ok;
+  if (!ok || rename(tmp.c_str(), path.c_str()) != 0)
+  {
+    unlink(tmp.c_str());
+    return false;
+  }
+  return true;
+}
+
+IndexedLog::IndexedLog() :
+  window_(false), start_(0.0), end_(0.0), segment_(0), planned_(false), range_(0), pos_(0), packet_start_(0),
+  packet_end_(0), scanned_(0), in_packet_(false), carry_(false), head_(0), packet_carried_(false)
+{
+  is_comm_init(&comm_, comm_buffer_, sizeof(comm_buffer_));
+  rewind();
+}
+
+IndexedLog::~IndexedLog()
+{
+  for (size_t i = 0; i < segments_.size(); i++)
+    munmap(const_cast<uint8_t*>(segments_[i].data), segments_[i].size);
+}
+
+std::map<std::string, std::vector<std::string> > IndexedLog::find_segments(const std::string& directory)
+{
+  std::map<std::string, std::vector<std::string> > logs;
+  DIR* dir = opendir(directory.c_str());
+  if (dir == NULL)
+    return logs;
+  for (struct dirent* ent = readdir(dir); ent != NULL; ent = readdir(dir))
+  {
+    std::string name = ent->d_name;
+    size_t underscore = name.rfind('_');
+    if (name.size() <= 4 || name.compare(name.size() - 4, 4, ".raw") != 0 || underscore == std::string::npos)
+      continue;
+    logs[name.substr(0, underscore)].push_back(directory + "/" + name);
+  }
+  closedir(dir);
+
+  // segment numbers are zero padded to 4 digits, and only grow longer after that
+  for (auto it = logs.begin(); it != logs.end(); ++it)
+    std::sort(it->second.begin(), it->second.end(), [](const std::string& a, const std::string& b)
+              { return a.size() != b.size() ? a.size() < b.size() : a < b; });
+  return logs;
+}
+
+bool IndexedLog::add_segment(const std::string& path, bool save_index)
+{
+  error_.clear();
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0)
+  {
+    error_ = "unable to open " + path + " (" + strerror(errno) + ")";
+    if (fd >= 0)
+      close(fd);
+    return false;
+  }
+  if (st.st_size == 0)
+  {
+    close(fd);
+    return true;
+  }
+
+  segment_t segment;
+  segment.path = path;
+  segment.size = (uint64_t)st.st_size;
+  void* map = mmap(NULL, segment.size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+  {
+    error_ = "unable to map " + path + " (" + strerror(errno) + ")";
+    return false;
+  }
+  segment.data = static_cast<const uint8_t*>(map);
+
+  // only the header until a window needs the entries
+  segment.loaded = false;
+  if (!load_index(segment, false))
+    build_index(segment, segments_.empty() ? NULL : &segments_.back(), save_index);
+
+  segments_.push_back(segment);
+  return true;
+}
+
+bool IndexedLog::load_index(segment_t& segment, bool entries)
+{
+  FILE* file = fopen(log_index_path(segment.path).c_str(), "rb");
+  if (file == NULL)
+    return false;
+  log_index_header_t header;
+  bool ok = fread(&header, sizeof(header), 1, file) == 1 && memcmp(header.magic, LOG_INDEX_MAGIC, 4) == 0 &&
+            header.version == LOG_INDEX_VERSION && header.entry_size == sizeof(log_index_entry_t) &&
+            header.log_size == segment.size;
+  if (ok)
+  {
+    segment.interval = header.interval;
+    segment.entry_count = header.entry_count;
+    segment.start_tow = header.start_tow;
+    segment.end_tow = header.end_tow;
+    segment.clock_tow = header.clock_tow;
+    segment.clock_tow_offset = header.clock_tow_offset;
+  }
+  if (ok && entries)
+  {
+    segment.entries.resize(header.entry_count);
+    ok = header.entry_count == 0 ||
+         fread(segment.entries.data(), sizeof(log_index_entry_t), header.entry_count, file) == header.entry_count;
+    if (ok)
+      map_entries(segment);
+  }
+  fclose(file);
+  return ok;
+}
+
+void IndexedLog::build_index(segment_t& segment, const segment_t* previous, bool save)
+{
+  LogIndexer indexer;
+  if (previous != NULL)
+    indexer.seed(previous->clock_tow_offset, previous->clock_tow);
+  indexer.add(segment.data, segment.size);
+  segment.entries = indexer.entries();
+  segment.interval = indexer.interval();
+  segment.entry_count = (uint32_t)segment.entries.size();
+  tow_range(segment.entries, segment.start_tow, segment.end_tow);
+  segment.clock_tow = indexer.clock().last_tow();
+  segment.clock_tow_offset = indexer.clock().tow_offset();
+  map_entries(segment);
+  if (save && !indexer.save(log_index_path(segment.path)))
+    error_ = "unable to save the index of " + segment.path;
+}
+
+void IndexedLog::map_entries(segment_t& segment)
+{
+  segment.dids.clear();
+  for (size_t i = 0; i < segment.entries.size(); )
+  {
+    size_t first = i;
+    while (i < segment.entries.size() && segment.entries[i].did == segment.entries[first].did)
+      i++;
+    segment.dids[segment.entries[first].did] = std::make_pair(first, i);
+  }
+  segment.loaded = true;
+}
+
+uint64_t IndexedLog::size() const
+{
+  uint64_t size = 0;
+  for (size_t i = 0; i < segments_.size(); i++)
+    size += segments_[i].size;
+  return size;
+}
+
+uint64_t IndexedLog::index_entries() const
+{
+  uint64_t count = 0;
+  for (size_t i = 0; i < segments_.size(); i++)
+    count += segments_[i].entry_count;
+  return count;
+}
+
+double IndexedLog::start_tow() const
+{
+  double tow = -1.0;
+  for (size_t i = 0; i < segments_.size(); i++)
+    if (segments_[i].start_tow >= 0.0 && (tow < 0.0 || segments_[i].start_tow < tow))
+      tow = segments_[i].start_tow;
+  return tow;
+}
+
+double IndexedLog::end_tow() const
+{
+  double tow = -1.0;
+  for (size_t i = 0; i < segments_.size(); i++)
+    tow = std::max(tow, segments_[i].end_tow);
+  return tow;
+}
+
+void IndexedLog::rewind()
+{
+  window_ = false;
+  filter_.clear();
+  clock_ = DidTimeTracker();
+  scanned_ = 0;
+  segment_ = 0;
+  planned_ = false;
+  carry_ = false;
+  head_ = 0;
+  packet_carried_ = false;
+}
+
+void IndexedLog::seek(double start, double end, const std::vector<uint32_t>& dids)
+{
+  window_ = true;
+  start_ = start;
+  end_ = end;
+  filter_ = dids;
+  std::sort(filter_.begin(), filter_.end());
+  scanned_ = 0;
+  segment_ = 0;
+  planned_ = false;
+  carry_ = false;
+  head_ = 0;
+  packet_carried_ = false;
+}
+
+bool IndexedLog::wanted(uint32_t did) const
+{
+  return filter_.empty() || std::binary_search(filter_.begin(), filter_.end(), did);
+}
+
+// offset of the packet the segment ends in the middle of (it goes on in the next segment), or size
+static uint64_t cut_packet(const uint8_t* data, uint64_t size)
+{
+  // the start and end bytes are escaped everywhere else in a packet
+  for (uint64_t i = size; i > 0 && size - i < 4096; i--)
+  {
+    if (data[i - 1] == PSC_END_BYTE)
+      break;
+    if (data[i - 1] == PSC_START_BYTE)
+      return i - 1;
+  }
+  return size;
+}
+
+void IndexedLog::plan(size_t index)
+{
+  segment_t& segment = segments_[index];
+  ranges_.clear();
+  range_ = 0;
+  if (!window_)
+  {
+    range_t all = { head_, segment.size, -1.0, 0.0 };
+    ranges_.push_back(all);
+    start_range();
+    return;
+  }
+
+  // the packet cut off at the end isn't in either segment's index; its time is between theirs
+  bool inside = segment.start_tow >= 0.0 && segment.start_tow <= end_ && segment.end_tow >= start_;
+  bool tail = index + 1 < segments_.size() && segment.start_tow >= 0.0 && segment.end_tow <= end_ &&
+              (segments_[index + 1].start_tow < 0.0 || segments_[index + 1].start_tow >= start_);
+  if (!inside && !tail)
+    return;
+  if (!segment.loaded && !load_index(segment, true))
+    build_index(segment, index > 0 ? &segments_[index - 1] : NULL, false);
+  uint64_t cut = tail ? cut_packet(segment.data, segment.size) : segment.size;
+  if (cut < segment.size)
+  {
+    range_t range = { cut, segment.size, segment.clock_tow, segment.clock_tow_offset };
+    ranges_.push_back(range);
+  }
+
+  // the stretch of the segment behind every entry of a wanted DID that can hold data in the window
+  for (auto it = segment.dids.begin(); inside && it != segment.dids.end(); ++it)
+  {
+    if (!wanted(it->first))
+      continue;
+    size_t first = it->second.first, last = it->second.second;
+    for (size_t i = first; i < last; i++)
+    {
+      const log_index_entry_t& entry = segment.entries[i];
+      // packets up to the next entry are at most interval later, unless time went backwards there
+      double latest = entry.tow;
+      if (entry.count > 1)
+        latest = std::max(i + 1 < last ? segment.entries[i + 1].tow : entry.tow, entry.tow + segment.interval);
+      if (entry.tow > end_ || latest < start_)
+        continue;
+
+      range_t range;
+      range.begin = entry.offset;
+      if (entry.count == 1)
+        range.end = entry.offset + 1;
+      else
+        range.end = i + 1 < last ? segment.entries[i + 1].offset : segment.size;
+      range.tow = entry.tow;
+      range.tow_offset = entry.tow_offset;
+      ranges_.push_back(range);
+    }
+  }
+
+  // in log order, overlapping and touching ranges joined
+  std::sort(ranges_.begin(), ranges_.end(), [](const range_t& a, const range_t& b) { return a.begin < b.begin; });
+  size_t n = 0;
+  for (size_t i = 0; i < ranges_.size(); i++)
+  {
+    if (n > 0 && ranges_[i].begin <= ranges_[n - 1].end)
+      ranges_[n - 1].end = std::max(ranges_[n - 1].end, ranges_[i].end);
+    else
+      ranges_[n++] = ranges_[i];
+  }
+  ranges_.resize(n);
+  if (!ranges_.empty())
+    start_range();
+}
+
+void IndexedLog::start_range()
+{
+  const range_t& range = ranges_[range_];
+  pos_ = range.begin;
+  in_packet_ = false;
+  is_comm_init(&comm_, comm_buffer_, sizeof(comm_buffer_));
+  // read from the middle, data sets get the time they'd have had reading from the start
+  if (window_)
+    clock_.seed(range.tow_offset, range.tow);
+}
+
+const p_data_t* IndexedLog::carry_over(const segment_t& segment, double& tow)
+{
+  // the rest of the packet the previous segment ended in, up to where the first whole packet starts
+  const p_data_t* data = NULL;
+  pos_ = 0;
+  while (pos_ < segment.size && segment.data[pos_] != PSC_START_BYTE)
+  {
+    uint8_t c = segment.data[pos_++];
+    scanned_++;
+    carried_.push_back(c);
+    protocol_type_t type = is_comm_parse_byte(&comm_, c);
+    if (type == _PTYPE_NONE)
+      continue;
+    if (type == _PTYPE_INERTIAL_SENSE_DATA && packet_data(comm_, data_))
+    {
+      tow = clock_.update(&data_);
+      if (!window_ || (wanted(data_.hdr.id) && tow >= start_ && tow <= end_))
+        data = &data_;
+    }
+    break;
+  }
+  carry_ = false;
+  head_ = pos_;
+  return data;
+}
+
+const p_data_t* IndexedLog::next(double& tow)
+{
+  while (segment_ < segments_.size())
+  {
+    segment_t& segment = segments_[segment_];
+    if (!planned_)
+    {
+      const p_data_t* data = carry_ ? carry_over(segment, tow) : NULL;
+      if (data != NULL)
+      {
+        packet_carried_ = true;
+        return data;
+      }
+      plan(segment_);
+      planned_ = true;
+    }
+    while (range_ < ranges_.size())
+    {
+      const range_t& range = ranges_[range_];
+      while (pos_ < segment.size)
+      {
+        uint8_t c = segment.data[pos_];
+        if (c == PSC_START_BYTE)
+        {
+          if (pos_ >= range.end)
+            break;
+          packet_start_ = pos_;
+          in_packet_ = true;
+        }
+        pos_++;
+        scanned_++;
+        protocol_type_t type = is_comm_parse_byte(&comm_, c);
+        if (type != _PTYPE_NONE)
+          in_packet_ = false;
+        if (type != _PTYPE_INERTIAL_SENSE_DATA || !packet_data(comm_, data_))
+          continue;
+
+        tow = clock_.update(&data_);
+        if (window_ && (!wanted(data_.hdr.id) || tow < start_ || tow > end_))
+          continue;
+        packet_end_ = pos_;
+        packet_carried_ = false;
+        return &data_;
+      }
+      if (++range_ < ranges_.size())
+        start_range();
+    }
+
+    // a packet cut off by the end of the segment goes on at the start of the next one
+    if (in_packet_ && pos_ >= segment.size && !ranges_.empty() && segment_ + 1 < segments_.size())
+    {
+      carry_ = true;
+      carried_.assign(segment.data + packet_start_, segment.data + segment.size);
+    }
+    segment_++;
+    planned_ = false;
+    head_ = 0;
+  }
+  return NULL;
+}
+
+const uint8_t* IndexedLog::packet(size_t& len) const
+{
+  if (segment_ >= segments_.size())
+  {
+    len = 0;
+    return NULL;
+  }
+  if (packet_carried_)
+  {
+    len = carried_.size();
+    return carried_.data();
+  }
+  len = (size_t)(packet_end_ - packet_start_);
+  return segments_[segment_].data + packet_start_;
+}
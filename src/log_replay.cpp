@@ -0,0 +1,160 @@
+#include "log_replay.h"
+
+#include <string.h>
+
+LogReplay::LogReplay(InertialSenseROS& node) :
+  node_(node), window_(false), window_start_(0.0), window_end_(0.0)
+{}
+
+void LogReplay::set_window(double start, double end)
+{
+  window_ = true;
+  window_start_ = start;
+  window_end_ = end;
+}
+
+bool LogReplay::load(const std::vector<std::string>& directories)
+{
+  for (size_t i = 0; i < directories.size(); i++)
+  {
+    std::map<std::string, std::vector<std::string> > raw = IndexedLog::find_segments(directories[i]);
+    if (!raw.empty())
+    {
+      ROS_INFO("log replay: %s contains raw logs of %d device(s)", directories[i].c_str(), (int)raw.size());
+      for (auto it = raw.begin(); it != raw.end(); ++it)
+      {
+        std::shared_ptr<IndexedLog> log(new IndexedLog());
+        for (size_t s = 0; s < it->second.size(); s++)
+        {
+          log->add_segment(it->second[s]);
+          if (!log->error().empty())
+            ROS_WARN("log replay: %s", log->error().c_str());
+        }
+        if (window_)
+          log->seek(window_start_, window_end_);
+        else
+          log->rewind();
+        ROS_INFO("log replay: %s: %lu segment(s), %.1f MB, GPS time of week %.3f to %.3f", it->first.c_str(),
+                 (unsigned long)log->segment_count(), log->size() / 1e6, log->start_tow(), log->end_tow());
+
+        streams_.push_back(stream_t());
+        stream_t& stream = streams_.back();
+        stream.raw = log;
+        stream.device = 0;
+        stream.valid = false;
+        if (!advance(stream))
+          streams_.pop_back();
+      }
+      continue;
+    }
+
+    std::shared_ptr<cISLogger> logger(new cISLogger());
+    if (!logger->LoadFromDirectory(directories[i], cISLogger::LOGTYPE_DAT))
+    {
+      ROS_ERROR("log replay: unable to load logs from %s", directories[i].c_str());
+      continue;
+    }
+    ROS_INFO("log replay: %s contains %d device(s)", directories[i].c_str(), (int)logger->GetDeviceCount());
+
+    for (unsigned int dev = 0; dev < logger->GetDeviceCount(); dev++)
+    {
+      streams_.push_back(stream_t());
+      stream_t& stream = streams_.back();
+      stream.logger = logger;
+      stream.device = dev;
+      stream.valid = false;
+      if (!advance(stream))
+        streams_.pop_back();
+    }
+  }
+  return !streams_.empty();
+}
+
+bool LogReplay::advance(stream_t& stream)
+{
+  while (true)
+  {
+    const p_data_t* data;
+    double tow = -1.0;
+    if (stream.raw)
+      data = stream.raw->next(tow);
+    else if ((data = stream.logger->ReadData(stream.device)) != NULL)
+      tow = stream.clock.update(data);
+    if (data == NULL)
+    {
+      stream.valid = false;
+      return false;
+    }
+
+    // raw logs only return the window; data sets arrive up to a second out of time order
+    if (window_ && !stream.raw)
+    {
+      if (tow > window_end_ + 1.0)
+      {
+        stream.valid = false;
+        return false;
+      }
+      if (tow < window_start_ || tow > window_end_)
+        continue;
+    }
+
+    stream.buffer.assign(data->buf, data->buf + data->hdr.size);
+    stream.pending.hdr = data->hdr;
+    stream.pending.buf = stream.buffer.data();
+    stream.tow = tow;
+    stream.valid = true;
+    return true;
+  }
+}
+
+uint64_t LogReplay::run(double rate)
+{
+  uint64_t count = 0;
+  ros::WallTime start = ros::WallTime::now();
+
+  // wall time at which log time anchor_tow is played, re-anchored if log time jumps backwards
+  bool anchored = false;
+  double anchor_tow = 0.0;
+  ros::WallTime anchor_wall;
+
+  while (ros::ok() && !node_.shutdown_requested_)
+  {
+    // earliest pending data set, earlier streams win ties
+    stream_t* next = NULL;
+    for (size_t i = 0; i < streams_.size(); i++)
+    {
+      if (streams_[i].valid && (next == NULL || streams_[i].tow < next->tow))
+        next = &streams_[i];
+    }
+    if (next == NULL)
+      break;
+
+    if (rate > 0.0 && next->tow >= 0.0)
+    {
+      if (!anchored || next->tow < anchor_tow)
+      {
+        anchored = true;
+        anchor_tow = next->tow;
+        anchor_wall = ros::WallTime::now();
+      }
+      ros::WallTime due = anchor_wall + ros::WallDuration((next->tow - anchor_tow) / rate);
+      // keep services and timers responsive while we wait for the data set to become due
+      for (ros::WallTime now = ros::WallTime::now(); now < due && ros::ok(); now = ros::WallTime::now())
+        node_.callback_queue_.callAvailable(ros::WallDuration(std::min((due - now).toSec(), 0.1)));
+    }
+    else if ((count & 0xFF) == 0)
+    {
+      node_.callback_queue_.callAvailableNow();
+    }
+
+    node_.dispatch(&next->pending);
+    count++;
+    advance(*next);
+  }
+  node_.callback_queue_.callAvailableNow();
+
+  double elapsed = (ros::WallTime::now() - start).toSec();
+  ROS_INFO("log replay: dispatched %lu data sets in %.3f s (%.0f data sets/s)",
+           (unsigned long)count, elapsed, elapsed > 0.0 ? count / elapsed : 0.0);
+  return count;
+}
@@ -0,0 +1,416 @@
+#include "log_writer.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+
+#include <ros/console.h>
+
+// pfnRead has no user pointer, so map tapped ports back to their writer here
+#define MAX_LOG_WRITERS 8
+static std::mutex s_registry_mutex;
+static std::atomic<serial_port_t*> s_ports[MAX_LOG_WRITERS];
+static LogWriter* s_writers[MAX_LOG_WRITERS];
+
+static uint64_t monotonic_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// mkdir -p
+static bool make_directories(const std::string& path)
+{
+  for (size_t i = 1; i <= path.size(); i++)
+  {
+    if (i < path.size() && path[i] != '/')
+      continue;
+    std::string dir = path.substr(0, i);
+    if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST)
+      return false;
+  }
+  return true;
+}
+
+LogWriter::config_t LogWriter::default_config()
+{
+  config_t config;
+  config.directory = ".";
+  config.prefix = "LOG";
+  config.segment_size = 64ull << 20;
+  config.segment_duration = 0.0;
+  config.block_size = 64 << 10;
+  config.queue_size = 8 << 20;  // ~90 s of a saturated 921600 baud link
+  config.sync_period = 1.0;
+  config.direct_io = false;
+  config.index_interval = 0.1;
+  return config;
+}
+
+LogWriter::LogWriter(const config_t& config) :
+  config_(config), ring_(config.queue_size), event_fd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)), signalled_(false),
+  running_(false), block_(NULL), block_fill_(0), fd_(-1), segment_index_(0), segment_offset_(0),
+  segment_start_ns_(0), last_sync_ns_(0), port_(NULL), port_read_(NULL),
+  high_water_(0), bytes_in_(0), bytes_written_(0), dropped_bytes_(0), dropped_chunks_(0),
+  segments_(0), write_errors_(0), max_write_ns_(0)
+{
+  config_.block_size = std::max<size_t>((config_.block_size + 4095) & ~(size_t)4095, 4096);
+  config_.segment_size = std::max<uint64_t>((config_.segment_size + config_.block_size - 1) / config_.block_size, 1) *
+                         config_.block_size;
+  wake_fill_ = std::min(config_.block_size, ring_.capacity() / 2);
+  if (config_.index_interval > 0.0)
+    indexer_.reset(new LogIndexer(config_.index_interval));
+}
+
+LogWriter::~LogWriter()
+{
+  stop();
+  free(block_);
+  if (event_fd_ >= 0)
+    close(event_fd_);
+}
+
+bool LogWriter::start()
+{
+  if (running_)
+    return true;
+  if (!make_directories(config_.directory))
+  {
+    ROS_ERROR("LogWriter: unable to create %s (%s)", config_.directory.c_str(), strerror(errno));
+    return false;
+  }
+  if (block_ == NULL && posix_memalign(reinterpret_cast<void**>(&block_), 4096, config_.block_size) != 0)
+  {
+    block_ = NULL;
+    return false;
+  }
+  if (!open_segment())
+    return false;
+
+  running_ = true;
+  thread_ = std::thread(&LogWriter::writer_thread, this);
+  return true;
+}
+
+void LogWriter::stop()
+{
+  detach();
+  if (!running_)
+    return;
+  running_ = false;
+  uint64_t one = 1;
+  ssize_t w = ::write(event_fd_, &one, sizeof(one));
+  (void)w;
+  if (thread_.joinable())
+    thread_.join();
+}
+
+void LogWriter::write(const uint8_t* data, size_t len)
+{
+  bytes_in_ += len;
+  // all or nothing, so what's logged is always whole reads
+  if (ring_.writable() < len)
+  {
+    dropped_bytes_ += len;
+    dropped_chunks_++;
+    return;
+  }
+  ring_.write(data, len);
+
+  uint64_t fill = ring_.size();
+  if (fill > high_water_)
+    high_water_ = fill;
+  // wake the writer once per block's worth (or half the queue), not per chunk
+  if (fill >= wake_fill_ && !signalled_.exchange(true))
+  {
+    uint64_t one = 1;
+    ssize_t w = ::write(event_fd_, &one, sizeof(one));
+    (void)w;
+  }
+}
+
+LogWriter::stats_t LogWriter::stats() const
+{
+  stats_t s;
+  s.queue_capacity = ring_.capacity();
+  s.queue_fill = ring_.size();
+  s.queue_high_water = high_water_;
+  s.bytes_in = bytes_in_;
+  s.bytes_written = bytes_written_;
+  s.dropped_bytes = dropped_bytes_;
+  s.dropped_chunks = dropped_chunks_;
+  s.segments = segments_;
+  s.write_errors = write_errors_;
+  s.max_write_ms = max_write_ns_ * 1e-6;
+  return s;
+}
+
+std::string LogWriter::current_segment() const
+{
+  std::lock_guard<std::mutex> lock(path_mutex_);
+  return segment_path_;
+}
+
+void LogWriter::writer_thread()
+{
+  const uint64_t sync_ns = (uint64_t)(config_.sync_period * 1e9);
+  const uint64_t segment_ns = (uint64_t)(config_.segment_duration * 1e9);
+  int timeout_ms = 100;
+  if (config_.sync_period > 0.0)
+    timeout_ms = std::min(timeout_ms, std::max(1, (int)(config_.sync_period * 1e3)));
+  struct pollfd pfd;
+  pfd.fd = event_fd_;
+  pfd.events = POLLIN;
+
+  while (true)
+  {
+    bool stopping = !running_;
+
+    // move everything queued into blocks, writing each as it fills
+    size_t len;
+    const uint8_t* region;
+    while ((region = ring_.read_region(len)), len > 0)
+    {
+      size_t n = std::min(len, config_.block_size - block_fill_);
+      memcpy(block_ + block_fill_, region, n);
+      if (indexer_)
+        indexer_->add(region, n);
+      ring_.consume(n);
+      block_fill_ += n;
+      if (block_fill_ < config_.block_size)
+        continue;
+      if (write_block())
+      {
+        bytes_written_ += config_.block_size;
+        segment_offset_ += config_.block_size;
+      }
+      else
+        drop_block();
+      block_fill_ = 0;
+      if (segment_offset_ >= config_.segment_size)
+      {
+        close_segment();
+        open_segment();
+      }
+    }
+
+    uint64_t now = monotonic_ns();
+    if (segment_ns > 0 && now - segment_start_ns_ >= segment_ns && (segment_offset_ > 0 || block_fill_ > 0))
+    {
+      close_segment();
+      open_segment();
+    }
+    else if (sync_ns > 0 && now - last_sync_ns_ >= sync_ns && fd_ >= 0)
+    {
+      // the partial block goes out padded and is written again, in place, once it fills
+      if (block_fill_ > 0)
+        write_block();
+      uint64_t start = monotonic_ns();
+      fdatasync(fd_);
+      uint64_t elapsed = monotonic_ns() - start;
+      if (elapsed > max_write_ns_)
+        max_write_ns_ = elapsed;
+      last_sync_ns_ = now;
+    }
+
+    if (stopping)
+      break;
+
+    // sleep until the producer has queued a block, or the next rotation / sync check
+    uint64_t count;
+    ssize_t r = read(event_fd_, &count, sizeof(count));
+    (void)r;
+    signalled_ = false;
+    if (ring_.size() >= wake_fill_ || !running_)
+      continue;
+    pfd.revents = 0;
+    poll(&pfd, 1, timeout_ms);
+  }
+
+  close_segment();
+}
+
+bool LogWriter::open_segment()
+{
+  // the segment starts here even if its file can't be created yet, write_block() tries again
+  segment_offset_ = 0;
+  if (indexer_)
+    indexer_->next_segment();
+  segment_start_ns_ = last_sync_ns_ = monotonic_ns();
+  return open_file();
+}
+
+bool LogWriter::open_file()
+{
+  char name[32];
+  snprintf(name, sizeof(name), "_%04u.raw", segment_index_);
+  std::string path = config_.directory + "/" + config_.prefix + name;
+
+  int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+  fd_ = -1;
+#ifdef O_DIRECT
+  if (config_.direct_io)
+    fd_ = open(path.c_str(), flags | O_DIRECT, 0644);
+#endif
+  if (fd_ < 0)
+    fd_ = open(path.c_str(), flags, 0644);  // also when the filesystem doesn't do O_DIRECT (tmpfs)
+  if (fd_ < 0)
+  {
+    ROS_ERROR_THROTTLE(10.0, "LogWriter: unable to create %s (%s)", path.c_str(), strerror(errno));
+    write_errors_++;
+    return false;
+  }
+  segment_index_++;
+
+#ifdef __linux__
+  // reserve the whole segment up front so writes never wait on block allocation; not every
+  // filesystem can, and posix_fallocate's fallback would write it all out, so errors are ignored
+  fallocate(fd_, 0, 0, (off_t)config_.segment_size);
+#endif
+
+  {
+    std::lock_guard<std::mutex> lock(path_mutex_);
+    segment_path_ = path;
+  }
+  segments_++;
+  return true;
+}
+
+void LogWriter::drop_block()
+{
+  dropped_bytes_ += block_fill_;
+  dropped_chunks_++;
+  // with no file the segment still starts at 0, so what the indexer saw of the block goes too;
+  // after a failed write the block stays a hole of zeros, which keeps later offsets right
+  if (fd_ < 0)
+  {
+    if (indexer_)
+      indexer_->next_segment();
+  }
+  else
+    segment_offset_ += config_.block_size;
+}
+
+void LogWriter::close_segment()
+{
+  if (fd_ < 0 && (block_fill_ == 0 || !open_file()))
+  {
+    // the segment's file was never created, and still can't be
+    if (block_fill_ > 0)
+      drop_block();
+    block_fill_ = 0;
+    return;
+  }
+  uint64_t length = segment_offset_ + block_fill_;
+  if (block_fill_ > 0)
+  {
+    if (write_block())
+      bytes_written_ += block_fill_;
+    else
+    {
+      dropped_bytes_ += block_fill_;
+      dropped_chunks_++;
+    }
+  }
+  block_fill_ = 0;
+
+  // give back the preallocated space and the block padding
+  if (ftruncate(fd_, (off_t)length) != 0)
+    write_errors_++;
+  fdatasync(fd_);
+  close(fd_);
+  fd_ = -1;
+  std::lock_guard<std::mutex> lock(path_mutex_);
+  if (length == 0)
+    unlink(segment_path_.c_str());
+  else if (indexer_ && !indexer_->save(log_index_path(segment_path_)))
+    write_errors_++;
+}
+
+bool LogWriter::write_block()
+{
+  // the segment's file couldn't be created when it started, try again with the block still pending
+  if (fd_ < 0 && !open_file())
+    return false;
+  if (block_fill_ < config_.block_size)
+    memset(block_ + block_fill_, 0, config_.block_size - block_fill_);
+
+  uint64_t start = monotonic_ns();
+  ssize_t n = pwrite(fd_, block_, config_.block_size, (off_t)segment_offset_);
+  uint64_t elapsed = monotonic_ns() - start;
+  if (elapsed > max_write_ns_)
+    max_write_ns_ = elapsed;
+  if (n != (ssize_t)config_.block_size)
+  {
+    write_errors_++;
+    return false;
+  }
+  return true;
+}
+
+bool LogWriter::attach(serial_port_t* port)
+{
+  if (port == NULL)
+    return false;
+  std::lock_guard<std::mutex> lock(s_registry_mutex);
+  int slot = -1;
+  for (int i = 0; i < MAX_LOG_WRITERS; i++)
+  {
+    if (s_writers[i] == this || (slot < 0 && s_ports[i].load() == NULL))
+      slot = i;
+  }
+  if (slot < 0)
+    return false;
+  if (port->pfnRead == read_hook)
+    return s_ports[slot].load() == port && s_writers[slot] == this;
+
+  // anything that replaced pfnRead since (a pipeline) is what we read through now
+  port_ = port;
+  port_read_ = port->pfnRead;
+  s_writers[slot] = this;
+  s_ports[slot].store(port);
+  port->pfnRead = read_hook;
+  return true;
+}
+
+void LogWriter::detach()
+{
+  std::lock_guard<std::mutex> lock(s_registry_mutex);
+  if (port_ != NULL && port_->pfnRead == read_hook)
+    port_->pfnRead = port_read_;
+  for (int i = 0; i < MAX_LOG_WRITERS; i++)
+  {
+    if (s_writers[i] == this)
+    {
+      s_ports[i].store(NULL);
+      s_writers[i] = NULL;
+    }
+  }
+  port_ = NULL;
+}
+
+int LogWriter::read_hook(serial_port_t* port, unsigned char* buf, int len, int timeoutMilliseconds)
+{
+  for (int i = 0; i < MAX_LOG_WRITERS; i++)
+  {
+    if (s_ports[i].load() == port)
+    {
+      LogWriter* writer = s_writers[i];
+      int n = writer->port_read_(port, buf, len, timeoutMilliseconds);
+      if (n > 0)
+        writer->write(buf, n);
+      return n;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,225 @@
+#include "serial_pipeline.h"
+#include "serialPortExt.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include <mutex>
+
+#include <ros/console.h>
+
+// pfnRead has no user pointer, so map redirected ports back to their pipeline here
+#define MAX_PIPELINES 8
+static std::mutex s_registry_mutex;
+static std::atomic<serial_port_t*> s_ports[MAX_PIPELINES];
+static SerialPipeline* s_pipelines[MAX_PIPELINES];
+
+SerialPipeline::SerialPipeline(size_t ring_size) :
+  ring_(ring_size), stamps_(1024), ring_in_(0), bytes_out_(0), last_arrival_ns_(0), port_(NULL), port_read_(NULL),
+  event_fd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)), running_(false), port_error_(false),
+  high_water_(0), bytes_in_(0), overflow_bytes_(0), overflow_events_(0)
+{}
+
+SerialPipeline::~SerialPipeline()
+{
+  stop();
+  if (event_fd_ >= 0)
+    close(event_fd_);
+}
+
+bool SerialPipeline::start(serial_port_t* serialPort, int priority)
+{
+  if (running_ || !serialPortIsOpen(serialPort) || serialPort->pfnRead == read_hook)
+    return false;
+
+  {
+    std::lock_guard<std::mutex> lock(s_registry_mutex);
+    int slot = -1;
+    for (int i = 0; i < MAX_PIPELINES && slot < 0; i++)
+      if (s_ports[i].load() == NULL)
+        slot = i;
+    if (slot < 0)
+      return false;
+    s_pipelines[slot] = this;
+    s_ports[slot].store(serialPort);
+  }
+
+  port_ = serialPort;
+  port_read_ = serialPort->pfnRead;
+  port_error_ = false;
+  running_ = true;
+  thread_ = std::thread(&SerialPipeline::reader_thread, this);
+
+  if (priority > 0)
+  {
+    struct sched_param param;
+    param.sched_priority = priority;
+    int err = pthread_setschedparam(thread_.native_handle(), SCHED_FIFO, &param);
+    if (err != 0)
+      ROS_WARN("inertialsense: unable to set SCHED_FIFO priority %d for the serial reader (%s), using default scheduling", priority, strerror(err));
+  }
+
+  // from here on the decoder reads from the ring
+  port_->pfnRead = read_hook;
+  return true;
+}
+
+void SerialPipeline::stop()
+{
+  if (!running_)
+    return;
+
+  running_ = false;
+  if (thread_.joinable())
+    thread_.join();
+
+  port_->pfnRead = port_read_;
+
+  std::lock_guard<std::mutex> lock(s_registry_mutex);
+  for (int i = 0; i < MAX_PIPELINES; i++)
+  {
+    if (s_pipelines[i] == this)
+    {
+      s_ports[i].store(NULL);
+      s_pipelines[i] = NULL;
+    }
+  }
+}
+
+SerialPipeline::stats_t SerialPipeline::stats() const
+{
+  stats_t s;
+  s.capacity = ring_.capacity();
+  s.fill = ring_.size();
+  s.high_water = high_water_;
+  s.bytes_in = bytes_in_;
+  s.overflow_bytes = overflow_bytes_;
+  s.overflow_events = overflow_events_;
+  return s;
+}
+
+void SerialPipeline::reader_thread()
+{
+  uint8_t discard[4096];
+  struct pollfd pfd;
+  pfd.events = POLLIN;
+
+  while (running_)
+  {
+    pfd.fd = serialPortGetFileDescriptor(port_);
+    pfd.revents = 0;
+    // bytes the SDK read ahead before we took the port over are not in the kernel buffer
+    bool buffered = serialPortGetReadAheadCount(port_) > 0;
+    if (poll(&pfd, 1, buffered ? 0 : 100) <= 0 && !buffered)
+      continue;
+
+    size_t len;
+    uint8_t* region = ring_.write_region(len);
+    int n;
+    if (len == 0)
+    {
+      // decoder has fallen behind - keep the kernel buffer drained and count what we lose
+      n = port_read_(port_, discard, sizeof(discard), 0);
+      if (n > 0)
+      {
+        overflow_bytes_ += n;
+        overflow_events_++;
+        bytes_in_ += n;
+      }
+      continue;
+    }
+
+    // one syscall takes everything the driver has buffered (up to the contiguous free space)
+    uint64_t arrival_ns;
+    n = serialPortReadBulk(port_, region, (int)len, 0, &arrival_ns);
+    if (n <= 0)
+    {
+      if (pfd.revents & (POLLERR | POLLHUP))
+      {
+        // device went away: tell the decoder, and don't spin on the error until someone stops us
+        if (!port_error_.exchange(true))
+        {
+          uint64_t one = 1;
+          ssize_t w = write(event_fd_, &one, sizeof(one));
+          (void)w;
+        }
+        usleep(10000);
+      }
+      continue;
+    }
+    bytes_in_ += n;
+    ring_in_ += n;
+    chunk_stamp_t stamp = { ring_in_, arrival_ns };
+    stamps_.push(stamp); // if the decoder is so far behind this is full, these bytes take the next chunk's stamp
+    ring_.commit_write(n);
+
+    uint64_t fill = ring_.size();
+    if (fill > high_water_)
+      high_water_ = fill;
+
+    uint64_t one = 1;
+    ssize_t w = write(event_fd_, &one, sizeof(one));
+    (void)w;
+  }
+}
+
+int SerialPipeline::read_hook(serial_port_t* serialPort, unsigned char* buf, int len, int timeoutMilliseconds)
+{
+  for (int i = 0; i < MAX_PIPELINES; i++)
+  {
+    if (s_ports[i].load() == serialPort)
+      return s_pipelines[i]->ring_read(buf, len, timeoutMilliseconds);
+  }
+  return 0;
+}
+
+int SerialPipeline::ring_read(unsigned char* buf, int len, int timeoutMilliseconds)
+{
+  size_t n = ring_.read(buf, len);
+  if (n == 0 && timeoutMilliseconds > 0)
+  {
+    struct pollfd pfd;
+    pfd.fd = event_fd_;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    if (poll(&pfd, 1, timeoutMilliseconds) > 0)
+      n = ring_.read(buf, len);
+  }
+
+  // remember when the newest byte we just handed out arrived, retiring fully consumed chunks
+  uint64_t first = bytes_out_;
+  bytes_out_ += n;
+  chunk_stamp_t* stamp;
+  while (n > 0 && (stamp = stamps_.front()) != NULL)
+  {
+    // only chunks holding some of these bytes, the next one's haven't been handed out
+    if (stamp->end > first)
+      last_arrival_ns_ = stamp->arrival_ns;
+    if (stamp->end > bytes_out_)
+      break;
+    bool last = stamp->end == bytes_out_;
+    stamps_.pop();
+    if (last)
+      break;
+  }
+  if (ring_.size() == 0)
+  {
+    // clear the wake-up signal once the decoder has caught up
+    uint64_t count;
+    ssize_t r = read(event_fd_, &count, sizeof(count));
+    (void)r;
+    // the reader may have committed between our read and the reset - re-arm so nothing is missed
+    if (ring_.size() != 0)
+    {
+      uint64_t one = 1;
+      ssize_t w = write(event_fd_, &one, sizeof(one));
+      (void)w;
+    }
+  }
+  return (int)n;
+}